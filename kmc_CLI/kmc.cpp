@@ -1,5 +1,9 @@
 #define _CRT_SECURE_NO_WARNINGS
 #include "../kmc_core/kmc_runner.h"
+#include "sketch_compare.h"
+#include "sketch_stream.h"
+#include "sketch_merge.h"
+#include "sketch_downsample.h"
 #include <cstring>
 #include <iostream>
 #include <fstream>
@@ -26,6 +30,10 @@ void usage()
 	cout << "K-Mer Counter (KMC) ver. " << KMC::CfgConsts::kmc_ver << " (" << KMC::CfgConsts::kmc_date << ")\n"
 		<< "Usage:\n kmc [options] <input_file_name> <output_file_name> <working_directory>\n"
 		<< " kmc [options] <@input_file_names> <output_file_name> <working_directory>\n"
+		<< " kmc compare [options] <output_file_name> <sketch_1> [<sketch_2> ...] - compare FracMinHash sketches (run without sketches for details)\n"
+		<< " kmc stream [options] <input> <output_sketch> - sketch reads as they arrive (run without parameters for details)\n"
+		<< " kmc merge [options] <output_sketch> <sketch_1> [<sketch_2> ...] - merge partial sketches (run without sketches for details)\n"
+		<< " kmc downsample [options] <input_sketch> <output_sketch> - sketch at larger scaled (run without parameters for details)\n"
 		<< "Parameters:\n"
 		<< "  input_file_name - single file in specified (-f switch) format (gziped or not)\n"
 		<< "  @input_file_names - file name with list of input files in specified (-f switch) format (gziped or not)\n"
@@ -48,7 +56,9 @@ void usage()
 		<< "  -sp<value> - number of splitting threads\n"
 		<< "  -sr<value> - number of threads for 2nd stage\n"
 		<< "  -j<file_name> - file name with execution summary in JSON format\n"
+		<< "  -trace<file_name> - file name with timeline of worker threads in Chrome trace event format\n"
 		<< "  -w - without output\n"
+		<< "  -hash - store FracMinHash hashes of k-mers in <output_file_name>.kmc_hash (KMC output only)\n"
 		<< "  -o<kmc/kff> - output in KMC of KFF format; default: KMC\n"
 		<< "  -hp - hide percentage progress (default: false)\n"
 		<< "  -e - only estimate histogram of k-mers occurrences instead of exact k-mer counting\n"
@@ -117,7 +127,13 @@ bool parse_parameters(int argc, char* argv[], Params& params)
 			stage1Params.SetSeed(atoi(&argv[i][2]));
 		if(strncmp(argv[i], "-scaled", 7) == 0)
 			stage1Params.SetScaled(atoi(&argv[i][7]));
-		if (strncmp(argv[i], "-t", 2) == 0)
+		if (strncmp(argv[i], "-trace", 6) == 0)
+		{
+			stage1Params.SetTraceFile(&argv[i][6]);
+			if (stage1Params.GetTraceFile() == "")
+				cerr << "Warning: file name for trace of execution missed (-trace switch)\n";
+		}
+		else if (strncmp(argv[i], "-t", 2) == 0)
 		{
 			auto nThreads = atoi(&argv[i][2]);
 			stage1Params.SetNThreads(nThreads); //TODO: what with stage2 in this case?
@@ -193,6 +209,8 @@ bool parse_parameters(int argc, char* argv[], Params& params)
 		}
 		else if (strncmp(argv[i], "-hc", 3) == 0 && strlen(argv[i]) == 3)
 			stage1Params.SetHomopolymerCompressed(true);
+		else if (strcmp(argv[i], "-hash") == 0)
+			stage2Params.SetStoreHashes(true);
 		else if (strncmp(argv[i], "-r", 2) == 0)
 		{
 			stage1Params.SetRamOnlyMode(true);
@@ -324,6 +342,94 @@ void save_estimated_histogram(const std::string& fileName, const std::vector<uin
 		out << i << "\t" << estimatedHistogram[i] << "\n";
 }
 
+//per-phase sums of worker counters; busiest phase is the one whose threads were busy for the largest part of their lifetime
+//(it is not necessarily the bottleneck, e.g. a phase may be busy because its threads are slow or because they are few)
+void save_thread_stats_in_json(ofstream& stats, const std::string& stage_name, const std::vector<KMC::ThreadStats>& threadStats, bool last)
+{
+	struct PhaseStats
+	{
+		std::string phase;
+		uint32_t threads{};
+		uint64_t bytes{}, records{}, wallNs{}, busyNs{}, idleNs{}, blockedNs{};
+		std::vector<std::pair<std::string, uint64_t>> stepsNs;
+		double busy_fraction() const { return wallNs ? (double)busyNs / wallNs : 0.0; }
+	};
+	std::vector<PhaseStats> phases;
+	for (const auto& t : threadStats)
+	{
+		auto it = std::find_if(phases.begin(), phases.end(), [&t](const PhaseStats& p) {return p.phase == t.phase; });
+		if (it == phases.end())
+		{
+			phases.emplace_back();
+			it = phases.end() - 1;
+			it->phase = t.phase;
+			it->stepsNs = t.stepsNs;
+		}
+		else
+			for (uint32_t i = 0; i < t.stepsNs.size() && i < it->stepsNs.size(); ++i)
+				it->stepsNs[i].second += t.stepsNs[i].second;
+		++it->threads;
+		it->bytes += t.bytes;
+		it->records += t.records;
+		it->wallNs += t.wallNs;
+		it->busyNs += t.busyNs;
+		it->idleNs += t.idleNs;
+		it->blockedNs += t.blockedNs;
+	}
+	auto busiest = std::max_element(phases.begin(), phases.end(), [](const PhaseStats& a, const PhaseStats& b) {return a.busy_fraction() < b.busy_fraction(); });
+
+	stats << "\t\t\"" << stage_name << "\": {\n"
+		<< "\t\t\t\"Busiest_phase\": \"" << (busiest == phases.end() ? "" : busiest->phase) << "\",\n"
+		<< "\t\t\t\"Phases\": {";
+	for (uint32_t i = 0; i < phases.size(); ++i)
+	{
+		const auto& p = phases[i];
+		stats << (i ? "," : "") << "\n\t\t\t\t\"" << p.phase << "\": { "
+			<< "\"threads\": " << p.threads
+			<< ", \"bytes\": " << p.bytes
+			<< ", \"records\": " << p.records
+			<< ", \"busy_s\": " << p.busyNs / 1e9
+			<< ", \"idle_s\": " << p.idleNs / 1e9
+			<< ", \"blocked_s\": " << p.blockedNs / 1e9
+			<< ", \"busy_fraction\": " << p.busy_fraction();
+		for (const auto& step : p.stepsNs)
+			stats << ", \"" << step.first << "_s\": " << step.second / 1e9;
+		stats << " }";
+	}
+	stats << "\n\t\t\t},\n"
+		<< "\t\t\t\"Threads\": [";
+	for (uint32_t i = 0; i < threadStats.size(); ++i)
+	{
+		const auto& t = threadStats[i];
+		stats << (i ? "," : "") << "\n\t\t\t\t{ "
+			<< "\"phase\": \"" << t.phase << "\""
+			<< ", \"thread\": " << t.threadNo
+			<< ", \"bytes\": " << t.bytes
+			<< ", \"records\": " << t.records
+			<< ", \"wall_s\": " << t.wallNs / 1e9
+			<< ", \"busy_s\": " << t.busyNs / 1e9
+			<< ", \"idle_s\": " << t.idleNs / 1e9
+			<< ", \"blocked_s\": " << t.blockedNs / 1e9
+			<< ", \"idle_waits\": " << t.nIdleWaits
+			<< ", \"blocked_waits\": " << t.nBlockedWaits
+			<< " }";
+	}
+	stats << "\n\t\t\t]\n"
+		<< "\t\t}" << (last ? "\n" : ",\n");
+}
+
+//tail of sorting: bins cannot be split between sorters, so the threads that are idle here are the gain possible from splitting them
+void save_sorters_tail_in_json(ofstream& stats, const KMC::Stage2Results& stage2Results)
+{
+	double tail_thread_ns = (double)stage2Results.sortersTailNs * stage2Results.nSortingThreads;
+	stats << "\t\t\"2nd_stage_sorting_tail\": { "
+		<< "\"threads\": " << stage2Results.nSortingThreads
+		<< ", \"tail_s\": " << stage2Results.sortersTailNs / 1e9
+		<< ", \"idle_thread_s\": " << stage2Results.sortersTailIdleThreadNs / 1e9
+		<< ", \"idle_fraction\": " << (tail_thread_ns ? stage2Results.sortersTailIdleThreadNs / tail_thread_ns : 0.0)
+		<< " }\n";
+}
+
 void save_stats_in_json_file(const Params& params, const KMC::Stage1Results& stage1Results,	const KMC::Stage2Results& stage2Results)
 {
 	if (params.cliParams.jsonSummaryFileName == "")
@@ -378,6 +484,11 @@ void save_stats_in_json_file(const Params& params, const KMC::Stage1Results& sta
 		stats << "\t\t\"#Total_sequences\": " << stage1Results.nSeqences << ",\n";
 	stats << "\t\t\"#Total_super-k-mers\": " << stage1Results.nTotalSuperKmers << "\n";
 
+	stats << "\t},\n";
+	stats << "\t\"Perf\": {\n";
+	save_thread_stats_in_json(stats, "1st_stage", stage1Results.threadStats, false);
+	save_thread_stats_in_json(stats, "2nd_stage", stage2Results.threadStats, false);
+	save_sorters_tail_in_json(stats, stage2Results);
 	stats << "\t}\n";
 	stats << "}\n";
 	stats.close();
@@ -426,6 +537,15 @@ void print_summary(
 // Main function
 int main(int argc, char** argv)
 {
+	if (argc > 1 && strcmp(argv[1], "compare") == 0)
+		return sketch_compare_main(argc - 1, argv + 1);
+	if (argc > 1 && strcmp(argv[1], "stream") == 0)
+		return sketch_stream_main(argc - 1, argv + 1);
+	if (argc > 1 && strcmp(argv[1], "merge") == 0)
+		return sketch_merge_main(argc - 1, argv + 1);
+	if (argc > 1 && strcmp(argv[1], "downsample") == 0)
+		return sketch_downsample_main(argc - 1, argv + 1);
+
 	if (argc == 1 || help_or_version(argc, argv))
 	{
 		usage();
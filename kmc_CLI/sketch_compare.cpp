@@ -0,0 +1,222 @@
+#define _CRT_SECURE_NO_WARNINGS
+#include "sketch_compare.h"
+#include "../kmc_api/sketch_file.h"
+#include <cstring>
+#include <cmath>
+#include <iostream>
+#include <fstream>
+#include <memory>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+using namespace std;
+
+enum class CompareMetric { jaccard, containment, max_containment, ani };
+
+struct CompareParams
+{
+	CompareMetric metric = CompareMetric::jaccard;
+	uint32 n_threads = 0;
+	string output_file_name;
+	vector<string> sketch_file_names;
+};
+
+//----------------------------------------------------------------------------------
+static void compare_usage()
+{
+	cout << "Usage:\n kmc compare [options] <output_file_name> <sketch_1> [<sketch_2> ...]\n"
+		<< " kmc compare [options] <output_file_name> <@sketch_file_names>\n"
+		<< "Parameters:\n"
+		<< "  output_file_name - similarity matrix in CSV format (as `sourmash compare --csv`)\n"
+		<< "  sketch - sketch in binary format or sourmash JSON (only the first signature is used)\n"
+		<< "  @sketch_file_names - file name with list of sketches\n"
+		<< "Options:\n"
+		<< "  -metric<jaccard/containment/max_containment/ani> - similarity measure; default: jaccard\n"
+		<< "     containment - row sketch contained in column sketch\n"
+		<< "     ani - average of containment ANI estimations in both directions\n"
+		<< "  -t<value> - number of threads (default: no. of CPU cores)\n"
+		<< "All sketches must have the same k, seed and molecule, they are downsampled to the smallest max_hash.\n";
+}
+
+//----------------------------------------------------------------------------------
+static bool parse_compare_parameters(int argc, char** argv, CompareParams& params)
+{
+	int i;
+	for (i = 1; i < argc; ++i)
+	{
+		if (argv[i][0] != '-')
+			break;
+		if (strncmp(argv[i], "-metric", 7) == 0)
+		{
+			string metric = &argv[i][7];
+			if (metric == "jaccard")
+				params.metric = CompareMetric::jaccard;
+			else if (metric == "containment")
+				params.metric = CompareMetric::containment;
+			else if (metric == "max_containment")
+				params.metric = CompareMetric::max_containment;
+			else if (metric == "ani")
+				params.metric = CompareMetric::ani;
+			else
+			{
+				cerr << "Error: unknown metric: " << metric << "\n";
+				return false;
+			}
+		}
+		else if (strncmp(argv[i], "-t", 2) == 0)
+			params.n_threads = atoi(&argv[i][2]);
+		else
+		{
+			cerr << "Error: unknown option: " << argv[i] << "\n";
+			return false;
+		}
+	}
+
+	if (argc - i < 2)
+		return false;
+
+	params.output_file_name = argv[i++];
+	for (; i < argc; ++i)
+	{
+		if (argv[i][0] != '@')
+		{
+			params.sketch_file_names.push_back(argv[i]);
+			continue;
+		}
+		ifstream in(argv[i] + 1);
+		if (!in.good())
+		{
+			cerr << "Error: No " << argv[i] + 1 << " file\n";
+			return false;
+		}
+		string s;
+		while (getline(in, s))
+			if (s != "")
+				params.sketch_file_names.push_back(s);
+	}
+
+	if (params.n_threads == 0)
+		params.n_threads = max(1u, thread::hardware_concurrency());
+
+	return !params.sketch_file_names.empty();
+}
+
+//----------------------------------------------------------------------------------
+int sketch_compare_main(int argc, char** argv)
+{
+	CompareParams params;
+	if (!parse_compare_parameters(argc, argv, params))
+	{
+		compare_usage();
+		return 1;
+	}
+
+	uint32 n_sketches = (uint32)params.sketch_file_names.size();
+	vector<unique_ptr<CSketchFile>> sketches(n_sketches);
+	uint64 max_hash = 0;
+	for (uint32 i = 0; i < n_sketches; ++i)
+	{
+		sketches[i] = make_unique<CSketchFile>();
+		if (!sketches[i]->Open(params.sketch_file_names[i]))
+		{
+			cerr << "Error: cannot open sketch: " << params.sketch_file_names[i] << "\n";
+			return 1;
+		}
+		const CSketchInfo& info = sketches[i]->Info();
+		const CSketchInfo& first = sketches[0]->Info();
+		if (info.ksize != first.ksize || info.seed != first.seed || info.molecule != first.molecule || info.hash_function != first.hash_function)
+		{
+			cerr << "Error: sketch " << params.sketch_file_names[i] << " is not compatible with " << params.sketch_file_names[0] << " (k, seed, molecule or hash function differs)\n";
+			return 1;
+		}
+		if (info.max_hash == 0)
+		{
+			cerr << "Error: sketch " << params.sketch_file_names[i] << " is not a FracMinHash sketch (max_hash is 0)\n";
+			return 1;
+		}
+		if (i == 0 || info.max_hash < max_hash)
+			max_hash = info.max_hash;
+	}
+
+	// Downsampling of a sorted sketch is just a prefix of hashes
+	vector<uint64> sizes(n_sketches);
+	for (uint32 i = 0; i < n_sketches; ++i)
+		sizes[i] = sketches[i]->CountBelow(max_hash);
+
+	// Sizes of intersections for all pairs, rows are distributed among threads dynamically, since they differ in cost
+	vector<uint64> intersections((uint64)n_sketches * n_sketches);
+	atomic<uint32> next_row(0);
+	vector<thread> threads;
+	for (uint32 t = 0; t < min(params.n_threads, n_sketches); ++t)
+		threads.emplace_back([&] {
+			uint32 i;
+			while ((i = next_row++) < n_sketches)
+			{
+				intersections[(uint64)i * n_sketches + i] = sizes[i];
+				for (uint32 j = i + 1; j < n_sketches; ++j)
+				{
+					uint64 common = sorted_intersection_size(sketches[i]->Hashes(), sizes[i], sketches[j]->Hashes(), sizes[j]);
+					intersections[(uint64)i * n_sketches + j] = common;
+					intersections[(uint64)j * n_sketches + i] = common;
+				}
+			}
+		});
+	for (auto& t : threads)
+		t.join();
+
+	ofstream out(params.output_file_name);
+	if (!out)
+	{
+		cerr << "Error: cannot create file: " << params.output_file_name << "\n";
+		return 1;
+	}
+
+	// ksize of protein (dayhoff, hp) sketches is 3 times the length of amino acid k-mers, as in sourmash
+	double k = sketches[0]->Info().ksize;
+	if (sketches[0]->Info().molecule != "dna")
+		k /= 3;
+	auto containment = [&](uint32 i, uint32 j) {
+		return sizes[i] ? (double)intersections[(uint64)i * n_sketches + j] / sizes[i] : 0.0;
+	};
+
+	for (uint32 i = 0; i < n_sketches; ++i)
+	{
+		const string& name = sketches[i]->Info().filename;
+		out << (i ? "," : "") << (name.empty() ? params.sketch_file_names[i] : name);
+	}
+	out << "\n";
+
+	for (uint32 i = 0; i < n_sketches; ++i)
+	{
+		for (uint32 j = 0; j < n_sketches; ++j)
+		{
+			double val;
+			uint64 common = intersections[(uint64)i * n_sketches + j];
+			switch (params.metric)
+			{
+			case CompareMetric::jaccard:
+				val = (sizes[i] + sizes[j] - common) ? (double)common / (sizes[i] + sizes[j] - common) : 0.0;
+				break;
+			case CompareMetric::containment:
+				val = containment(i, j);
+				break;
+			case CompareMetric::max_containment:
+				val = max(containment(i, j), containment(j, i));
+				break;
+			case CompareMetric::ani:
+				val = (pow(containment(i, j), 1.0 / k) + pow(containment(j, i), 1.0 / k)) / 2;
+				break;
+			default:
+				val = 0.0;
+			}
+			out << (j ? "," : "") << val;
+		}
+		out << "\n";
+	}
+
+	return 0;
+}
+
+// ***** EOF
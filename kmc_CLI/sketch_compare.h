@@ -0,0 +1,10 @@
+#ifndef _SKETCH_COMPARE_H
+#define _SKETCH_COMPARE_H
+
+//----------------------------------------------------------------------------------
+// `kmc compare` - pairwise similarity of FracMinHash sketches, argv[0] is "compare"
+int sketch_compare_main(int argc, char** argv);
+
+#endif
+
+// ***** EOF
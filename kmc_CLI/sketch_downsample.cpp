@@ -0,0 +1,142 @@
+#define _CRT_SECURE_NO_WARNINGS
+#include "sketch_downsample.h"
+#include "../kmc_api/sketch_file.h"
+#include "../kmc_api/murmur_hash.h"
+#include <cctype>
+#include <cstring>
+#include <cstdio>
+#include <iostream>
+#include <string>
+using namespace std;
+
+struct DownsampleParams
+{
+	uint64 max_hash = 0;
+	int binary_output = -1;		// -1: the same format as input
+	string input_file_name;
+	string output_file_name;
+};
+
+//----------------------------------------------------------------------------------
+static void downsample_usage()
+{
+	cout << "Usage:\n kmc downsample [options] <input_sketch> <output_sketch>\n"
+		<< "Parameters:\n"
+		<< "  input_sketch - sketch in binary format or sourmash JSON (only the first signature is used)\n"
+		<< "  output_sketch - hashes (and abundances) of input below the new max_hash, may be the same as input_sketch\n"
+		<< "Options:\n"
+		<< "  -scaled<value> - new scaled value, must not be smaller than scaled of input\n"
+		<< "  -max_hash<value> - new max_hash (instead of -scaled)\n"
+		<< "  -o<json/bin> - format of the output sketch; default: format of input_sketch\n";
+}
+
+//----------------------------------------------------------------------------------
+static bool parse_downsample_parameters(int argc, char** argv, DownsampleParams& params)
+{
+	int i;
+	for (i = 1; i < argc; ++i)
+	{
+		if (argv[i][0] != '-')
+			break;
+		if (strncmp(argv[i], "-scaled", 7) == 0)
+		{
+			char* end;
+			unsigned long scaled = strtoul(&argv[i][7], &end, 10);
+			if (!isdigit((unsigned char)argv[i][7]) || *end || scaled == 0 || scaled > 0xFFFFFFFFul)
+			{
+				cerr << "Error: wrong scaled value: " << &argv[i][7] << " (must be a positive integer)\n";
+				return false;
+			}
+			params.max_hash = murmur::fmh_max_hash((uint32)scaled);
+		}
+		else if (strncmp(argv[i], "-max_hash", 9) == 0)
+		{
+			char* end;
+			params.max_hash = strtoull(&argv[i][9], &end, 10);
+			if (!isdigit((unsigned char)argv[i][9]) || *end || params.max_hash == 0)
+			{
+				cerr << "Error: wrong max_hash value: " << &argv[i][9] << " (must be a positive integer)\n";
+				return false;
+			}
+		}
+		else if (strcmp(argv[i], "-ojson") == 0)
+			params.binary_output = 0;
+		else if (strcmp(argv[i], "-obin") == 0)
+			params.binary_output = 1;
+		else
+		{
+			cerr << "Error: unknown option: " << argv[i] << "\n";
+			return false;
+		}
+	}
+
+	if (argc - i != 2)
+		return false;
+	if (params.max_hash == 0)
+	{
+		cerr << "Error: -scaled<value> or -max_hash<value> is required\n";
+		return false;
+	}
+	params.input_file_name = argv[i];
+	params.output_file_name = argv[i + 1];
+	return true;
+}
+
+//----------------------------------------------------------------------------------
+int sketch_downsample_main(int argc, char** argv)
+{
+	DownsampleParams params;
+	if (!parse_downsample_parameters(argc, argv, params))
+	{
+		downsample_usage();
+		return 1;
+	}
+
+	CSketchFile sketch;
+	if (!sketch.Open(params.input_file_name))
+	{
+		cerr << "Error: cannot open sketch: " << params.input_file_name << "\n";
+		return 1;
+	}
+	CSketchInfo info = sketch.Info();
+	if (info.max_hash == 0)
+	{
+		cerr << "Error: sketch " << params.input_file_name << " is not a FracMinHash sketch (max_hash is 0)\n";
+		return 1;
+	}
+	if (params.max_hash > info.max_hash)
+	{
+		cerr << "Error: new max_hash (" << params.max_hash << ") is larger than max_hash of the sketch (" << info.max_hash << "), hashes above it are unknown\n";
+		return 1;
+	}
+
+	// Hashes are sorted, so the downsampled sketch is a prefix of the input
+	uint64 n_hashes = sketch.CountBelow(params.max_hash);
+	info.max_hash = params.max_hash;
+	info.n_hashes = n_hashes;
+
+	// The input may be mapped (or be the output), so the result is written to a temporary file first
+	string tmp_name = params.output_file_name + ".tmp";
+	bool saved;
+	if (params.binary_output < 0)
+		params.binary_output = sketch.IsBinary();
+	if (params.binary_output)
+		saved = CSketchFile::Save(tmp_name, info, sketch.Hashes(), sketch.Abundances());
+	else
+		saved = CSketchFile::SaveJson(tmp_name, info, sketch.Hashes(), sketch.Abundances());
+	sketch.Close();
+#ifdef _WIN32
+	if (saved)
+		remove(params.output_file_name.c_str());
+#endif
+	if (!saved || rename(tmp_name.c_str(), params.output_file_name.c_str()) != 0)
+	{
+		remove(tmp_name.c_str());
+		cerr << "Error: cannot save sketch: " << params.output_file_name << "\n";
+		return 1;
+	}
+
+	return 0;
+}
+
+// ***** EOF
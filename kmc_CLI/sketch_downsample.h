@@ -0,0 +1,10 @@
+#ifndef _SKETCH_DOWNSAMPLE_H
+#define _SKETCH_DOWNSAMPLE_H
+
+//----------------------------------------------------------------------------------
+// `kmc downsample` - sketch at larger scaled (smaller max_hash) from an existing sketch, argv[0] is "downsample"
+int sketch_downsample_main(int argc, char** argv);
+
+#endif
+
+// ***** EOF
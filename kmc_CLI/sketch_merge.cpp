@@ -0,0 +1,198 @@
+#define _CRT_SECURE_NO_WARNINGS
+#include "sketch_merge.h"
+#include "../kmc_api/sketch_file.h"
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <memory>
+#include <vector>
+#include <string>
+#include <queue>
+#include <functional>
+using namespace std;
+
+struct MergeParams
+{
+	uint64 cutoff_min = 0;
+	uint64 cutoff_max = 0;
+	bool binary_output = false;
+	bool filename_set = false;
+	string filename;
+	string output_file_name;
+	vector<string> sketch_file_names;
+};
+
+//----------------------------------------------------------------------------------
+static void merge_usage()
+{
+	cout << "Usage:\n kmc merge [options] <output_sketch> <sketch_1> [<sketch_2> ...]\n"
+		<< " kmc merge [options] <output_sketch> <@sketch_file_names>\n"
+		<< "Parameters:\n"
+		<< "  output_sketch - union of hashes of all sketches, abundances are summed\n"
+		<< "  sketch - partial sketch in binary format or sourmash JSON (only the first signature is used)\n"
+		<< "  @sketch_file_names - file name with list of sketches\n"
+		<< "Options:\n"
+		<< "  -ci<value> - exclude hashes with summed abundance less than <value>\n"
+		<< "  -cx<value> - exclude hashes with summed abundance more than <value>\n"
+		<< "  -filename<name> - file name stored in the sketch; default: common file name of inputs or empty\n"
+		<< "  -o<json/bin> - format of the output sketch; default: json\n"
+		<< "All sketches must have the same k, seed, max_hash (scaled), molecule and hash function. The result is the same\n"
+		<< "as a sketch of all shards at once if partial sketches have abundances and were computed without cutoffs (-ci1).\n"
+		<< "Binary sketches are mapped into memory, so the merge needs little memory besides them.\n";
+}
+
+//----------------------------------------------------------------------------------
+static bool parse_merge_parameters(int argc, char** argv, MergeParams& params)
+{
+	int i;
+	for (i = 1; i < argc; ++i)
+	{
+		if (argv[i][0] != '-')
+			break;
+		if (strncmp(argv[i], "-ci", 3) == 0)
+			params.cutoff_min = atoll(&argv[i][3]);
+		else if (strncmp(argv[i], "-cx", 3) == 0)
+			params.cutoff_max = atoll(&argv[i][3]);
+		else if (strncmp(argv[i], "-filename", 9) == 0)
+		{
+			params.filename = &argv[i][9];
+			params.filename_set = true;
+		}
+		else if (strcmp(argv[i], "-ojson") == 0)
+			params.binary_output = false;
+		else if (strcmp(argv[i], "-obin") == 0)
+			params.binary_output = true;
+		else
+		{
+			cerr << "Error: unknown option: " << argv[i] << "\n";
+			return false;
+		}
+	}
+
+	if (argc - i < 2)
+		return false;
+
+	params.output_file_name = argv[i++];
+	for (; i < argc; ++i)
+	{
+		if (argv[i][0] != '@')
+		{
+			params.sketch_file_names.push_back(argv[i]);
+			continue;
+		}
+		ifstream in(argv[i] + 1);
+		if (!in.good())
+		{
+			cerr << "Error: No " << argv[i] + 1 << " file\n";
+			return false;
+		}
+		string s;
+		while (getline(in, s))
+			if (s != "")
+				params.sketch_file_names.push_back(s);
+	}
+
+	return !params.sketch_file_names.empty();
+}
+
+//----------------------------------------------------------------------------------
+int sketch_merge_main(int argc, char** argv)
+{
+	MergeParams params;
+	if (!parse_merge_parameters(argc, argv, params))
+	{
+		merge_usage();
+		return 1;
+	}
+
+	uint32 n_sketches = (uint32)params.sketch_file_names.size();
+	vector<unique_ptr<CSketchFile>> sketches(n_sketches);
+	bool with_abundances = true;
+	bool same_filename = true;
+	for (uint32 i = 0; i < n_sketches; ++i)
+	{
+		sketches[i] = make_unique<CSketchFile>();
+		if (!sketches[i]->Open(params.sketch_file_names[i]))
+		{
+			cerr << "Error: cannot open sketch: " << params.sketch_file_names[i] << "\n";
+			return 1;
+		}
+		const CSketchInfo& info = sketches[i]->Info();
+		const CSketchInfo& first = sketches[0]->Info();
+		if (info.max_hash == 0)
+		{
+			cerr << "Error: sketch " << params.sketch_file_names[i] << " is not a FracMinHash sketch (max_hash is 0)\n";
+			return 1;
+		}
+		if (info.ksize != first.ksize || info.seed != first.seed || info.max_hash != first.max_hash ||
+			info.molecule != first.molecule || info.hash_function != first.hash_function)
+		{
+			cerr << "Error: sketch " << params.sketch_file_names[i] << " cannot be merged with " << params.sketch_file_names[0] << " (k, seed, max_hash, molecule or hash function differs)\n";
+			return 1;
+		}
+		with_abundances = with_abundances && info.with_abundances;
+		same_filename = same_filename && info.filename == first.filename;
+	}
+
+	if (!with_abundances && (params.cutoff_min > 1 || params.cutoff_max))
+	{
+		cerr << "Error: cutoffs require abundances in all sketches\n";
+		return 1;
+	}
+
+	CSketchInfo info = sketches[0]->Info();
+	info.with_abundances = with_abundances;
+	if (params.filename_set)
+		info.filename = params.filename;
+	else if (!same_filename)
+		info.filename = "";
+
+	CSketchWriter writer;
+	if (!writer.Open(params.output_file_name, info, params.binary_output))
+	{
+		cerr << "Error: cannot create file: " << params.output_file_name << "\n";
+		return 1;
+	}
+
+	// K-way merge of sorted hash arrays, the heap holds the current hash of each sketch
+	using elem_t = pair<uint64, uint32>;
+	priority_queue<elem_t, vector<elem_t>, greater<elem_t>> heap;
+	vector<uint64> pos(n_sketches, 0);
+	for (uint32 i = 0; i < n_sketches; ++i)
+		if (sketches[i]->Size())
+			heap.emplace(sketches[i]->Hashes()[0], i);
+
+	uint64 n_input = 0;
+	while (!heap.empty())
+	{
+		uint64 hash = heap.top().first;
+		uint64 abundance = 0;
+		while (!heap.empty() && heap.top().first == hash)
+		{
+			uint32 i = heap.top().second;
+			heap.pop();
+			if (with_abundances)
+				abundance += sketches[i]->Abundances()[pos[i]];
+			++n_input;
+			if (++pos[i] < sketches[i]->Size())
+				heap.emplace(sketches[i]->Hashes()[pos[i]], i);
+		}
+		if (params.cutoff_min && abundance < params.cutoff_min && with_abundances)
+			continue;
+		if (params.cutoff_max && abundance > params.cutoff_max)
+			continue;
+		writer.Add(hash, abundance);
+	}
+
+	uint64 n_output = writer.Size();
+	if (!writer.Close())
+	{
+		cerr << "Error: cannot save sketch: " << params.output_file_name << "\n";
+		return 1;
+	}
+	cout << n_sketches << " sketches, " << n_input << " hashes merged into " << n_output << " hashes\n";
+
+	return 0;
+}
+
+// ***** EOF
@@ -0,0 +1,10 @@
+#ifndef _SKETCH_MERGE_H
+#define _SKETCH_MERGE_H
+
+//----------------------------------------------------------------------------------
+// `kmc merge` - exact merge of partial FracMinHash sketches (e.g. of shards of input), argv[0] is "merge"
+int sketch_merge_main(int argc, char** argv);
+
+#endif
+
+// ***** EOF
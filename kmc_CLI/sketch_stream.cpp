@@ -0,0 +1,958 @@
+#define _CRT_SECURE_NO_WARNINGS
+#include "sketch_stream.h"
+#include "../kmc_api/sketch_file.h"
+#include "../kmc_api/murmur_hash.h"
+#include "../3rd_party/cloudflare/zlib.h"
+#include <cstring>
+#include <cctype>
+#include <csignal>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <queue>
+#include <memory>
+#include <cerrno>
+#include <sys/stat.h>
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <dirent.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+using namespace std;
+
+struct StreamParams
+{
+	uint32 kmer_len = 21;
+	uint32 scaled = 1000;
+	uint32 seed = 42;
+	bool with_abundances = false;
+	uint64 cutoff_min = 1;
+	bool binary_output = false;
+	uint32 interval = 60;
+	string molecule = "dna";
+	bool protein_input = false;
+	uint32 n_threads = 0;
+	string input_name;
+	string output_file_name;
+};
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void request_stop(int)
+{
+	stop_requested = 1;
+}
+
+//----------------------------------------------------------------------------------
+static void stream_usage()
+{
+	cout << "Usage:\n kmc stream [options] <input> <output_sketch>\n"
+		<< "Parameters:\n"
+		<< "  input - FASTQ/FASTA file or named pipe (gziped or not), - for standard input,\n"
+		<< "          or directory that is watched for new files (*.fastq, *.fq, *.fasta, *.fa, *.fna, optionally .gz)\n"
+		<< "  output_sketch - sketch of all reads seen so far, replaced atomically at each snapshot\n"
+		<< "Options:\n"
+		<< "  -k<len> - k-mer length (in amino acids for protein molecules); default: 21\n"
+		<< "  -scaled<value> - scaled value of FracMinHash; default: 1000\n"
+		<< "  -S<value> - seed of hash function; default: 42\n"
+		<< "  -a - store abundances\n"
+		<< "  -ci<value> - exclude hashes seen less than <value> times; default: 1\n"
+		<< "  -molecule<dna/protein/dayhoff/hp> - type of k-mers, DNA reads are translated in six frames for protein types; default: dna\n"
+		<< "  -aa - input sequences are proteins (requires protein, dayhoff or hp molecule)\n"
+		<< "  -interval<sec> - minimal time between snapshots; default: 60\n"
+		<< "  -o<json/bin> - format of the sketch; default: json\n"
+		<< "  -t<value> - number of threads hashing the reads; default: no. of CPU cores\n"
+		<< "A directory is watched until SIGINT or SIGTERM, other inputs are read to the end or to the signal. Files in\n"
+		<< "a directory are read as they grow. Reads already received are added to the last snapshot, saved before exit.\n";
+}
+
+//----------------------------------------------------------------------------------
+static bool parse_stream_parameters(int argc, char** argv, StreamParams& params)
+{
+	int i;
+	for (i = 1; i < argc; ++i)
+	{
+		if (argv[i][0] != '-' || argv[i][1] == '\0')
+			break;
+		if (strncmp(argv[i], "-k", 2) == 0)
+			params.kmer_len = atoi(&argv[i][2]);
+		else if (strncmp(argv[i], "-scaled", 7) == 0)
+			params.scaled = atoi(&argv[i][7]);
+		else if (strncmp(argv[i], "-S", 2) == 0)
+			params.seed = atoi(&argv[i][2]);
+		else if (strcmp(argv[i], "-a") == 0)
+			params.with_abundances = true;
+		else if (strncmp(argv[i], "-ci", 3) == 0)
+			params.cutoff_min = atoll(&argv[i][3]);
+		else if (strncmp(argv[i], "-molecule", 9) == 0)
+			params.molecule = &argv[i][9];
+		else if (strcmp(argv[i], "-aa") == 0)
+			params.protein_input = true;
+		else if (strncmp(argv[i], "-interval", 9) == 0)
+			params.interval = atoi(&argv[i][9]);
+		else if (strncmp(argv[i], "-t", 2) == 0)
+			params.n_threads = atoi(&argv[i][2]);
+		else if (strcmp(argv[i], "-ojson") == 0)
+			params.binary_output = false;
+		else if (strcmp(argv[i], "-obin") == 0)
+			params.binary_output = true;
+		else
+		{
+			cerr << "Error: unknown option: " << argv[i] << "\n";
+			return false;
+		}
+	}
+
+	if (argc - i != 2)
+		return false;
+	if (params.kmer_len == 0)
+	{
+		cerr << "Error: wrong k-mer length\n";
+		return false;
+	}
+	if (params.molecule != "dna" && params.molecule != "protein" && params.molecule != "dayhoff" && params.molecule != "hp")
+	{
+		cerr << "Error: unknown molecule: " << params.molecule << "\n";
+		return false;
+	}
+	if (params.protein_input && params.molecule == "dna")
+	{
+		cerr << "Error: -aa requires protein, dayhoff or hp molecule\n";
+		return false;
+	}
+	if (params.scaled == 0)
+		params.scaled = 1;
+	if (params.n_threads == 0)
+		params.n_threads = max(1u, thread::hardware_concurrency());
+	params.input_name = argv[i];
+	params.output_file_name = argv[i + 1];
+	return true;
+}
+
+//************************************************************************************************************
+// CSequenceReader - sequences of FASTQ (4 lines per record) or FASTA (multiline) data, the format is recognized
+// for each record by its first character. The data come in chunks (gziped or not, recognized by the first two
+// bytes) as they are available in a file descriptor, so a reader of a live pipe is never blocked longer than
+// the timeout and a record is returned only once it is complete.
+//************************************************************************************************************
+class CSequenceReader
+{
+	enum class Format { unknown, plain, gzip };
+	Format format = Format::unknown;
+	string undecided;			// first byte, if the format is not known yet
+	z_stream zs;
+	bool zs_initialized = false;
+	vector<char> chunk;
+	vector<char> inflated;
+
+	string text;				// decoded data, text[pos..] is not parsed yet
+	size_t pos = 0;
+	bool in_fasta = false;		// header of FASTA record was parsed, its sequence is in fasta_seq
+	string fasta_seq;
+
+	void append_text(const char* data, size_t size)
+	{
+		if (pos == text.size() || pos > (1u << 20))
+		{
+			text.erase(0, pos);
+			pos = 0;
+		}
+		text.append(data, size);
+	}
+
+	bool decode(const char* data, size_t size)
+	{
+		if (format == Format::unknown)
+		{
+			undecided.append(data, size);
+			if (undecided.size() < 2)
+				return true;
+			format = (uchar)undecided[0] == 0x1f && (uchar)undecided[1] == 0x8b ? Format::gzip : Format::plain;
+			string first;
+			first.swap(undecided);
+			return decode(first.data(), first.size());
+		}
+		if (format == Format::plain)
+		{
+			append_text(data, size);
+			return true;
+		}
+
+		if (!zs_initialized)
+		{
+			memset(&zs, 0, sizeof(zs));
+			if (inflateInit2(&zs, 15 + 16) != Z_OK)
+				return false;
+			zs_initialized = true;
+		}
+		zs.next_in = (Bytef*)data;
+		zs.avail_in = (uInt)size;
+		while (true)
+		{
+			zs.next_out = (Bytef*)inflated.data();
+			zs.avail_out = (uInt)inflated.size();
+			int ret = inflate(&zs, Z_NO_FLUSH);
+			size_t produced = inflated.size() - zs.avail_out;
+			append_text(inflated.data(), produced);
+			if (ret == Z_STREAM_END)
+				inflateReset(&zs);		// next member of concatenated gzip file
+			else if (ret == Z_BUF_ERROR && produced == 0)
+				break;
+			else if (ret != Z_OK)
+				return false;
+			if (zs.avail_in == 0 && zs.avail_out != 0)
+				break;
+		}
+		return true;
+	}
+
+	// Line at text[from..], end excludes end of line characters; an incomplete last line is a line only if final
+	bool line_at(size_t from, size_t& end, size_t& next, bool final) const
+	{
+		size_t eol = text.find('\n', from);
+		if (eol == string::npos)
+		{
+			if (!final || from == text.size())
+				return false;
+			eol = next = text.size();
+		}
+		else
+			next = eol + 1;
+		end = eol;
+		while (end > from && text[end - 1] == '\r')
+			--end;
+		return true;
+	}
+
+public:
+	enum class ReadStatus { data, wait, eof, error };
+
+	CSequenceReader() : chunk(1 << 16), inflated(1 << 18) {}
+
+	~CSequenceReader()
+	{
+		if (zs_initialized)
+			inflateEnd(&zs);
+	}
+
+	CSequenceReader(const CSequenceReader&) = delete;
+	CSequenceReader& operator=(const CSequenceReader&) = delete;
+
+	// Read the data available in fd, waiting for them at most timeout_ms (also interrupted by a signal)
+	ReadStatus Read(int fd, int timeout_ms)
+	{
+#ifdef _WIN32
+		int n = _read(fd, chunk.data(), (unsigned)chunk.size());
+#else
+		pollfd pfd = { fd, POLLIN, 0 };
+		int ready = poll(&pfd, 1, timeout_ms);
+		if (ready == 0 || (ready < 0 && errno == EINTR))
+			return ReadStatus::wait;
+		if (ready < 0)
+			return ReadStatus::error;
+		ssize_t n = read(fd, chunk.data(), chunk.size());
+#endif
+		if (n < 0)
+			return errno == EINTR ? ReadStatus::wait : ReadStatus::error;
+		if (n == 0)
+			return ReadStatus::eof;
+		return decode(chunk.data(), n) ? ReadStatus::data : ReadStatus::error;
+	}
+
+	// On stop the line being written is not complete, only the data up to the last end of line are used
+	void DropIncompleteLine()
+	{
+		size_t eol = text.rfind('\n');
+		text.resize(eol == string::npos || eol < pos ? pos : eol + 1);
+		undecided.clear();
+	}
+
+	// Next complete sequence of the data read so far. If final (end of input or stop), the last record is
+	// complete by definition, otherwise the end of FASTA record is known only when the next one starts.
+	bool NextSequence(string& seq, bool final)
+	{
+		if (final && !undecided.empty())
+		{
+			format = Format::plain;
+			append_text(undecided.data(), undecided.size());
+			undecided.clear();
+		}
+
+		size_t end, next;
+		while (!in_fasta)
+		{
+			if (!line_at(pos, end, next, final))
+				return false;
+			if (text[pos] == '>')
+			{
+				in_fasta = true;
+				fasta_seq.clear();
+				pos = next;
+				break;
+			}
+			if (text[pos] == '@')
+			{
+				size_t seq_from = next, seq_end, p = next;
+				if (!line_at(p, seq_end, p, final))
+					return false;
+				for (int i = 0; i < 2; ++i)		// + and quality
+					if (!line_at(p, end, p, final) && !final)
+						return false;
+				seq.assign(text, seq_from, seq_end - seq_from);
+				pos = p;
+				return true;
+			}
+			pos = next;
+		}
+
+		while (pos < text.size() && text[pos] != '>')
+		{
+			if (!line_at(pos, end, next, final))
+				return false;
+			fasta_seq.append(text, pos, end - pos);
+			pos = next;
+		}
+		if (pos == text.size() && !final)
+			return false;
+		in_fasta = false;
+		seq.swap(fasta_seq);
+		return true;
+	}
+};
+
+//************************************************************************************************************
+// CSequenceHasher - admissible hashes of canonical k-mers with their counters. Protein k-mers are hashed as
+// in sourmash: strings of amino acids (or of dayhoff/hp symbols) are not canonized, DNA is translated in three
+// frames of both strands and codons with symbols other than ACGT are translated into X.
+//************************************************************************************************************
+class CSequenceHasher
+{
+	const StreamParams& params;
+	uint64 max_hash;
+	unordered_map<uint64, uint64> counters;
+	string rc;
+	char upper[256];
+	char compl_symb[256];
+	char aa_symb[256];			// amino acid -> symbol of the reduced alphabet (identity for protein)
+	string aa;
+
+	uint64 n_kmers = 0;
+
+	void add_run(const char* fwd, uint32 len)
+	{
+		uint32 k = params.kmer_len;
+		rc.resize(len);
+		for (uint32 i = 0; i < len; ++i)
+			rc[len - 1 - i] = compl_symb[(uchar)fwd[i]];
+
+		uint64 hv[2];
+		for (uint32 i = 0; i + k <= len; ++i)
+		{
+			const char* r = rc.data() + (len - i - k);
+			const char* kmer = memcmp(fwd + i, r, k) <= 0 ? fwd + i : r;
+			murmur::MurmurHash3_x64_128(kmer, k, params.seed, hv);
+			if (hv[0] < max_hash)
+				++counters[hv[0]];
+		}
+		n_kmers += len - k + 1;
+	}
+
+	void add_protein_kmers(const char* seq, uint32 len)
+	{
+		uint32 k = params.kmer_len;
+		if (len < k)
+			return;
+		uint64 hv[2];
+		for (uint32 i = 0; i + k <= len; ++i)
+		{
+			murmur::MurmurHash3_x64_128(seq + i, k, params.seed, hv);
+			if (hv[0] < max_hash)
+				++counters[hv[0]];
+		}
+		n_kmers += len - k + 1;
+	}
+
+	// Complete codons of seq[frame..] in the alphabet of the sketch
+	void translate(const char* seq, uint32 len, uint32 frame)
+	{
+		// Standard genetic code, codons ordered as AAA, AAC, AAG, AAT, ACA, ...
+		static const char* codon_table = "KNKNTTTTRSRSIIMIQHQHPPPPRRRRLLLLEDEDAAAAGGGGVVVV*Y*YSSSS*CWCLFLF";
+		aa.clear();
+		for (uint32 i = frame; i + 3 <= len; i += 3)
+		{
+			int code = 0;
+			for (uint32 j = i; j < i + 3 && code >= 0; ++j)
+				switch (seq[j])
+				{
+				case 'A': code = code * 4; break;
+				case 'C': code = code * 4 + 1; break;
+				case 'G': code = code * 4 + 2; break;
+				case 'T': code = code * 4 + 3; break;
+				default: code = -1;
+				}
+			aa.push_back(code < 0 ? 'X' : aa_symb[(uchar)codon_table[code]]);
+		}
+	}
+
+public:
+	explicit CSequenceHasher(const StreamParams& params) : params(params)
+	{
+		max_hash = murmur::fmh_max_hash(params.scaled);
+		for (int i = 0; i < 256; ++i)
+			upper[i] = compl_symb[i] = 'N';
+		const char* symbols = "ACGT";
+		for (int i = 0; i < 4; ++i)
+		{
+			upper[(uchar)symbols[i]] = upper[(uchar)tolower(symbols[i])] = symbols[i];
+			compl_symb[(uchar)symbols[i]] = symbols[3 - i];
+		}
+
+		for (int i = 0; i < 256; ++i)
+			aa_symb[i] = params.molecule == "protein" ? (char)i : 'X';
+		aa_symb[(uchar)'*'] = '*';
+		if (params.molecule == "dayhoff")
+		{
+			const char* groups[] = { "AGPST", "DENQ", "HKR", "ILMV", "FWY", "C" };
+			for (int g = 0; g < 6; ++g)
+				for (const char* p = groups[g]; *p; ++p)
+					aa_symb[(uchar)*p] = (char)('a' + g);
+		}
+		else if (params.molecule == "hp")
+		{
+			for (const char* p = "AFGILMPVWY"; *p; ++p)
+				aa_symb[(uchar)*p] = 'h';
+			for (const char* p = "CDEHKNQRST"; *p; ++p)
+				aa_symb[(uchar)*p] = 'p';
+		}
+	}
+
+	void AddProtein(const string& seq)
+	{
+		aa.resize(seq.size());
+		for (size_t i = 0; i < seq.size(); ++i)
+			aa[i] = aa_symb[(uchar)toupper((uchar)seq[i])];
+		add_protein_kmers(aa.data(), (uint32)aa.size());
+	}
+
+	// Protein k-mers of six frame translation
+	void AddTranslated(string& seq)
+	{
+		uint32 len = (uint32)seq.size();
+		for (auto& c : seq)
+			c = upper[(uchar)c];
+		rc.resize(len);
+		for (uint32 i = 0; i < len; ++i)
+			rc[len - 1 - i] = compl_symb[(uchar)seq[i]];
+		for (uint32 frame = 0; frame < 3; ++frame)
+		{
+			translate(seq.data(), len, frame);
+			add_protein_kmers(aa.data(), (uint32)aa.size());
+			translate(rc.data(), len, frame);
+			add_protein_kmers(aa.data(), (uint32)aa.size());
+		}
+	}
+
+	// K-mers containing symbols other than ACGT are skipped
+	void AddSequence(string& seq)
+	{
+		if (params.protein_input)
+		{
+			AddProtein(seq);
+			return;
+		}
+		if (params.molecule != "dna")
+		{
+			AddTranslated(seq);
+			return;
+		}
+		for (auto& c : seq)
+			c = upper[(uchar)c];
+		uint32 len = (uint32)seq.size();
+		uint32 start = 0;
+		for (uint32 i = 0; i <= len; ++i)
+			if (i == len || seq[i] == 'N')
+			{
+				if (i - start >= params.kmer_len)
+					add_run(seq.data() + start, i - start);
+				start = i + 1;
+			}
+	}
+
+	// Counters of hashes, the owner clears them once merged
+	unordered_map<uint64, uint64>& Counters()
+	{
+		return counters;
+	}
+
+	uint64 NKmers() const
+	{
+		return n_kmers;
+	}
+};
+
+//************************************************************************************************************
+// CStreamSketcher - hashes and counters of all sequences seen so far. With more threads the sequences are
+// hashed in batches by workers, each with its own CSequenceHasher, whose counters are merged at a snapshot.
+//************************************************************************************************************
+class CStreamSketcher
+{
+	const StreamParams& params;
+	uint64 max_hash;
+	unordered_map<uint64, uint64> counters;
+	vector<unique_ptr<CSequenceHasher>> hashers;
+
+	vector<thread> workers;
+	mutex mtx;
+	condition_variable cv_tasks;
+	condition_variable cv_done;
+	queue<vector<string>> tasks;
+	uint32 n_busy = 0;
+	bool finished = false;
+	vector<string> batch;
+	uint64 batch_size = 0;
+
+	uint64 n_sequences = 0;
+	uint64 n_sequences_at_snapshot = 0;
+	bool snapshot_saved = false;
+
+	void worker(CSequenceHasher& hasher)
+	{
+		while (true)
+		{
+			vector<string> task;
+			{
+				unique_lock<mutex> lck(mtx);
+				cv_tasks.wait(lck, [this] { return !tasks.empty() || finished; });
+				if (tasks.empty())
+					return;
+				task = std::move(tasks.front());
+				tasks.pop();
+				++n_busy;
+			}
+			cv_done.notify_all();		// space in the queue
+			for (auto& seq : task)
+				hasher.AddSequence(seq);
+			{
+				lock_guard<mutex> lck(mtx);
+				--n_busy;
+			}
+			cv_done.notify_all();
+		}
+	}
+
+	// At most 2 batches per worker wait in the queue, so the reader does not run ahead of the workers
+	void submit_batch()
+	{
+		if (batch.empty())
+			return;
+		{
+			unique_lock<mutex> lck(mtx);
+			cv_done.wait(lck, [this] { return tasks.size() < 2 * workers.size(); });
+			tasks.push(std::move(batch));
+		}
+		cv_tasks.notify_one();
+		batch.clear();
+		batch_size = 0;
+	}
+
+	void wait_for_workers()
+	{
+		submit_batch();
+		unique_lock<mutex> lck(mtx);
+		cv_done.wait(lck, [this] { return tasks.empty() && !n_busy; });
+	}
+
+public:
+	explicit CStreamSketcher(const StreamParams& params) : params(params)
+	{
+		max_hash = murmur::fmh_max_hash(params.scaled);
+		for (uint32 i = 0; i < params.n_threads; ++i)
+			hashers.push_back(make_unique<CSequenceHasher>(params));
+		if (params.n_threads > 1)
+			for (auto& hasher : hashers)
+				workers.emplace_back(&CStreamSketcher::worker, this, std::ref(*hasher));
+	}
+
+	~CStreamSketcher()
+	{
+		{
+			lock_guard<mutex> lck(mtx);
+			finished = true;
+		}
+		cv_tasks.notify_all();
+		for (auto& w : workers)
+			w.join();
+	}
+
+	CStreamSketcher(const CStreamSketcher&) = delete;
+	CStreamSketcher& operator=(const CStreamSketcher&) = delete;
+
+	void AddSequence(string& seq)
+	{
+		++n_sequences;
+		if (workers.empty())
+		{
+			hashers[0]->AddSequence(seq);
+			return;
+		}
+		batch_size += seq.size();
+		batch.emplace_back();
+		batch.back().swap(seq);
+		if (batch_size >= (1u << 20))
+			submit_batch();
+	}
+
+	bool HasNewSequences() const
+	{
+		return n_sequences != n_sequences_at_snapshot;
+	}
+
+	bool SnapshotSaved() const
+	{
+		return snapshot_saved;
+	}
+
+	// The sketch is written to a temporary file which then replaces the output, so readers never see a partial sketch
+	bool SaveSnapshot()
+	{
+		wait_for_workers();
+		for (auto& hasher : hashers)
+		{
+			for (auto& e : hasher->Counters())
+				counters[e.first] += e.second;
+			hasher->Counters().clear();
+		}
+		uint64 n_kmers = 0;
+		for (auto& hasher : hashers)
+			n_kmers += hasher->NKmers();
+
+		vector<pair<uint64, uint64>> selected;
+		selected.reserve(counters.size());
+		for (auto& e : counters)
+			if (e.second >= params.cutoff_min)
+				selected.push_back(e);
+		sort(selected.begin(), selected.end());
+
+		CSketchInfo info;
+		info.ksize = params.molecule == "dna" ? params.kmer_len : 3 * params.kmer_len;	// sourmash stores 3k for protein k-mers
+		info.molecule = params.molecule;
+		info.seed = params.seed;
+		info.max_hash = max_hash;
+		info.filename = params.input_name;
+		info.with_abundances = params.with_abundances;
+		info.n_hashes = selected.size();
+
+		vector<uint64> hashes(selected.size());
+		vector<uint64> abundances(info.with_abundances ? selected.size() : 0);
+		for (uint64 i = 0; i < selected.size(); ++i)
+		{
+			hashes[i] = selected[i].first;
+			if (info.with_abundances)
+				abundances[i] = selected[i].second;
+		}
+
+		string tmp_name = params.output_file_name + ".tmp";
+		bool saved;
+		if (params.binary_output)
+			saved = CSketchFile::Save(tmp_name, info, hashes.data(), info.with_abundances ? abundances.data() : nullptr);
+		else
+			saved = CSketchFile::SaveJson(tmp_name, info, hashes.data(), info.with_abundances ? abundances.data() : nullptr);
+#ifdef _WIN32
+		if (saved)
+			remove(params.output_file_name.c_str());
+#endif
+		if (!saved || rename(tmp_name.c_str(), params.output_file_name.c_str()) != 0)
+		{
+			cerr << "Error: cannot save sketch: " << params.output_file_name << "\n";
+			return false;
+		}
+
+		n_sequences_at_snapshot = n_sequences;
+		snapshot_saved = true;
+		cout << "snapshot: " << n_sequences << " sequences, " << n_kmers << " k-mers, " << selected.size() << " hashes" << endl;
+		return true;
+	}
+};
+
+//----------------------------------------------------------------------------------
+class CSnapshotTimer
+{
+	chrono::steady_clock::time_point last = chrono::steady_clock::now();
+	uint32 interval;
+public:
+	explicit CSnapshotTimer(uint32 interval) : interval(interval) {}
+
+	bool Due() const
+	{
+		return chrono::steady_clock::now() - last >= chrono::seconds(interval);
+	}
+
+	void Reset()
+	{
+		last = chrono::steady_clock::now();
+	}
+};
+
+//----------------------------------------------------------------------------------
+// The timer is checked for each sequence and while waiting for data, so snapshots of a slow pipe are not late
+static bool snapshot_if_due(CStreamSketcher& sketcher, CSnapshotTimer& timer)
+{
+	if (!sketcher.HasNewSequences() || !timer.Due())
+		return true;
+	if (!sketcher.SaveSnapshot())
+		return false;
+	timer.Reset();
+	return true;
+}
+
+//----------------------------------------------------------------------------------
+static bool add_sequences(CSequenceReader& reader, bool final, CStreamSketcher& sketcher, CSnapshotTimer& timer)
+{
+	string seq;
+	while (reader.NextSequence(seq, final))
+	{
+		sketcher.AddSequence(seq);
+		if (!snapshot_if_due(sketcher, timer))
+			return false;
+	}
+	return true;
+}
+
+//----------------------------------------------------------------------------------
+// Read all sequences of a file or pipe (e.g. fed for hours), until its end or stop. On stop the reads that are
+// already buffered are added.
+static bool process_file(int fd, const string& name, CStreamSketcher& sketcher, CSnapshotTimer& timer)
+{
+	CSequenceReader reader;
+	bool at_end = false;
+	while (true)
+	{
+		bool final = at_end || stop_requested;
+		if (stop_requested && !at_end)
+			reader.DropIncompleteLine();
+		if (!add_sequences(reader, final, sketcher, timer))
+			return false;
+		if (final)
+			return true;
+		switch (reader.Read(fd, 100))
+		{
+		case CSequenceReader::ReadStatus::eof:
+			at_end = true;
+			break;
+		case CSequenceReader::ReadStatus::error:
+			cerr << "Error: cannot read " << name << "\n";
+			return false;
+		case CSequenceReader::ReadStatus::wait:
+			if (!snapshot_if_due(sketcher, timer))
+				return false;
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+//----------------------------------------------------------------------------------
+static bool is_directory(const string& name)
+{
+	struct stat st;
+	return stat(name.c_str(), &st) == 0 && (st.st_mode & S_IFMT) == S_IFDIR;
+}
+
+//----------------------------------------------------------------------------------
+static int64 file_size(const string& name)
+{
+	struct stat st;
+	if (stat(name.c_str(), &st) != 0 || (st.st_mode & S_IFMT) != S_IFREG)
+		return -1;
+	return st.st_size;
+}
+
+//----------------------------------------------------------------------------------
+static bool is_sequence_file(const string& name)
+{
+	if (name.empty() || name[0] == '.')
+		return false;
+	string base = name;
+	if (base.size() > 3 && base.compare(base.size() - 3, 3, ".gz") == 0)
+		base.resize(base.size() - 3);
+	for (const char* ext : { ".fastq", ".fq", ".fasta", ".fa", ".fna" })
+	{
+		size_t len = strlen(ext);
+		if (base.size() > len && base.compare(base.size() - len, len, ext) == 0)
+			return true;
+	}
+	return false;
+}
+
+//----------------------------------------------------------------------------------
+static vector<string> list_directory(const string& dir)
+{
+	vector<string> names;
+#ifdef _WIN32
+	_finddata_t fd;
+	intptr_t handle = _findfirst((dir + "\\*").c_str(), &fd);
+	if (handle != -1)
+	{
+		do
+			names.push_back(fd.name);
+		while (_findnext(handle, &fd) == 0);
+		_findclose(handle);
+	}
+#else
+	if (DIR* d = opendir(dir.c_str()))
+	{
+		while (dirent* e = readdir(d))
+			names.push_back(e->d_name);
+		closedir(d);
+	}
+#endif
+	sort(names.begin(), names.end());
+	return names;
+}
+
+//----------------------------------------------------------------------------------
+struct CWatchedFile
+{
+	CSequenceReader reader;
+	int64 offset = 0;
+};
+
+//----------------------------------------------------------------------------------
+// Add sequences of the data appended to the file since the previous call
+static bool read_appended(const string& path, CWatchedFile& file, CStreamSketcher& sketcher, CSnapshotTimer& timer)
+{
+#ifdef _WIN32
+	int fd = _open(path.c_str(), _O_RDONLY | _O_BINARY);
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+#endif
+	if (fd < 0 || lseek(fd, file.offset, SEEK_SET) != file.offset)
+	{
+		cerr << "Warning: cannot read " << path << ", will retry\n";
+		if (fd >= 0)
+			close(fd);
+		return true;
+	}
+	bool ok = true;
+	CSequenceReader::ReadStatus status;
+	while (ok && !stop_requested && (status = file.reader.Read(fd, 0)) != CSequenceReader::ReadStatus::eof)
+	{
+		if (status == CSequenceReader::ReadStatus::error)
+		{
+			cerr << "Error: cannot read " << path << "\n";
+			ok = false;
+		}
+		else
+			ok = add_sequences(file.reader, false, sketcher, timer);
+	}
+	file.offset = lseek(fd, 0, SEEK_CUR);
+	close(fd);
+	return ok;
+}
+
+//----------------------------------------------------------------------------------
+// Poll the directory every second and read what was appended to each file. The last FASTA record of a file
+// is complete only when the next one starts, or at stop, when all records still buffered are added.
+static bool watch_directory(const string& dir, CStreamSketcher& sketcher, CSnapshotTimer& timer)
+{
+	map<string, unique_ptr<CWatchedFile>> files;
+	while (!stop_requested)
+	{
+		for (auto& name : list_directory(dir))
+		{
+			if (stop_requested)
+				break;
+			if (!is_sequence_file(name))
+				continue;
+			string path = dir + "/" + name;
+			int64 size = file_size(path);
+			auto& file = files[name];
+			if (!file)
+				file = make_unique<CWatchedFile>();
+			if (size <= file->offset)
+				continue;
+			if (!read_appended(path, *file, sketcher, timer))
+				return false;
+		}
+
+		if (!snapshot_if_due(sketcher, timer))
+			return false;
+
+		for (int i = 0; i < 10 && !stop_requested; ++i)
+			this_thread::sleep_for(chrono::milliseconds(100));
+	}
+
+	for (auto& file : files)
+	{
+		file.second->reader.DropIncompleteLine();
+		if (!add_sequences(file.second->reader, true, sketcher, timer))
+			return false;
+	}
+	return true;
+}
+
+//----------------------------------------------------------------------------------
+int sketch_stream_main(int argc, char** argv)
+{
+	StreamParams params;
+	if (!parse_stream_parameters(argc, argv, params))
+	{
+		stream_usage();
+		return 1;
+	}
+
+#ifdef _WIN32
+	signal(SIGINT, request_stop);
+	signal(SIGTERM, request_stop);
+#else
+	// without SA_RESTART, so poll and read of a pipe return as soon as the signal arrives
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = request_stop;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, nullptr);
+	sigaction(SIGTERM, &sa, nullptr);
+#endif
+
+	CStreamSketcher sketcher(params);
+	CSnapshotTimer timer(params.interval);
+	bool ok;
+	if (params.input_name != "-" && is_directory(params.input_name))
+		ok = watch_directory(params.input_name, sketcher, timer);
+	else
+	{
+#ifdef _WIN32
+		int fd = params.input_name == "-" ? _fileno(stdin) : _open(params.input_name.c_str(), _O_RDONLY | _O_BINARY);
+#else
+		int fd = params.input_name == "-" ? fileno(stdin) : open(params.input_name.c_str(), O_RDONLY);
+#endif
+		if (fd < 0)
+		{
+			cerr << "Error: cannot open " << params.input_name << "\n";
+			return 1;
+		}
+		ok = process_file(fd, params.input_name, sketcher, timer);
+		if (params.input_name != "-")
+			close(fd);
+	}
+
+	// the last snapshot is saved also for an empty input, so the output always exists
+	if (!ok || ((sketcher.HasNewSequences() || !sketcher.SnapshotSaved()) && !sketcher.SaveSnapshot()))
+		return 1;
+	return 0;
+}
+
+// ***** EOF
@@ -0,0 +1,11 @@
+#ifndef _SKETCH_STREAM_H
+#define _SKETCH_STREAM_H
+
+//----------------------------------------------------------------------------------
+// `kmc stream` - FracMinHash sketch of reads as they arrive (file, pipe or directory),
+// snapshots are saved periodically, argv[0] is "stream"
+int sketch_stream_main(int argc, char** argv);
+
+#endif
+
+// ***** EOF
@@ -11,9 +11,19 @@
 #include "mmer.h"
 #include "kmc_file.h"
 #include <tuple>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <xmmintrin.h>
+#define KMC_PREFETCH(p) _mm_prefetch((const char*)(p), _MM_HINT_T0)
+#else
+#define KMC_PREFETCH(p) __builtin_prefetch(p)
+#include <sys/mman.h>
+#endif
 
 
 uint64 CKMCFile::part_size = 1 << 25;
+uint64 CKMCFile::hash_part_size = 1 << 22;
 
 
 // ----------------------------------------------------------------------------------
@@ -23,6 +33,90 @@ uint64 CKMCFile::part_size = 1 << 25;
 // RET	: true		- if successful
 // ----------------------------------------------------------------------------------
 bool CKMCFile::OpenForRA(const std::string &file_name)
+{
+	return OpenForRAImpl(file_name, false, false);
+}
+
+// ----------------------------------------------------------------------------------
+// Map files *.kmc_pre & *.kmc_suf into memory instead of reading them (only for KMC2
+// database on POSIX systems, otherwise files are read as in OpenForRA).
+// Mapped pages are shared by all processes which use the same database.
+// IN	: file_name - the name of kmer_counter's output
+// IN	: populate  - read the whole files at opening instead of on first access
+// RET	: true		- if successful
+// ----------------------------------------------------------------------------------
+bool CKMCFile::OpenForRAMapped(const std::string &file_name, bool populate)
+{
+	return OpenForRAImpl(file_name, true, populate);
+}
+
+// ----------------------------------------------------------------------------------
+// Map a whole file in read only mode. Auxiliary function.
+// RET	: address of mapping, nullptr if mapping is not possible
+// ----------------------------------------------------------------------------------
+void* CKMCFile::MapFile(FILE* file, uint64& mapped_size, bool populate)
+{
+#ifndef _WIN32
+	my_fseek(file, 0, SEEK_END);
+	mapped_size = my_ftell(file);
+	int flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+	if (populate)
+		flags |= MAP_POPULATE;
+#endif
+	void* ptr = mmap(nullptr, mapped_size, PROT_READ, flags, fileno(file), 0);
+	if (ptr == MAP_FAILED)
+		return nullptr;
+	// lookups touch single records, read ahead is useless unless the whole file is requested
+	madvise(ptr, mapped_size, populate ? MADV_WILLNEED : MADV_RANDOM);
+	return ptr;
+#else
+	(void)file;
+	(void)populate;
+	mapped_size = 0;
+	return nullptr;
+#endif
+}
+
+// ----------------------------------------------------------------------------------
+// Unmap a file mapped by MapFile. Auxiliary function.
+// ----------------------------------------------------------------------------------
+void CKMCFile::UnmapFile(void* ptr, uint64 mapped_size)
+{
+#ifndef _WIN32
+	munmap(ptr, mapped_size);
+#else
+	(void)ptr;
+	(void)mapped_size;
+#endif
+}
+
+// ----------------------------------------------------------------------------------
+// Release buffers of random access mode (mapped or allocated). Auxiliary function.
+// ----------------------------------------------------------------------------------
+void CKMCFile::ReleaseRABuffers()
+{
+	if (mapped_pre)
+		UnmapFile(mapped_pre, mapped_pre_size);
+	else
+		delete[] prefix_file_buf;
+	if (mapped_suf)
+		UnmapFile(mapped_suf, mapped_suf_size);
+	else
+		delete[] sufix_file_buf;
+	if (mapped_hash)
+		UnmapFile(mapped_hash, mapped_hash_size);
+	mapped_pre = mapped_suf = mapped_hash = nullptr;
+	mapped_pre_size = mapped_suf_size = mapped_hash_size = 0;
+	prefix_file_buf = NULL;
+	lut_data = nullptr;
+	sufix_file_buf = NULL;
+}
+
+// ----------------------------------------------------------------------------------
+// Implementation of OpenForRA and OpenForRAMapped
+// ----------------------------------------------------------------------------------
+bool CKMCFile::OpenForRAImpl(const std::string &file_name, bool mapped, bool populate)
 {
 	uint64 size;
 	size_t result;
@@ -33,20 +127,33 @@ bool CKMCFile::OpenForRA(const std::string &file_name)
 	if (!OpenASingleFile(file_name + ".kmc_pre", file_pre, size, (char *)"KMCP"))
 		return false;
 
+	use_mmap = mapped;
+	mmap_populate = populate;
 	ReadParamsFrom_prefix_file_buf(size, open_mode::opened_for_RA);
 
 	if (!OpenASingleFile(file_name + ".kmc_suf", file_suf, size, (char *)"KMCS"))
 		return false;
 
-	sufix_file_buf = new uchar[size];
-	result = fread(sufix_file_buf, 1, size, file_suf);
-	if (result != size)
-		return false;
+	// the mapping of *.kmc_pre is used as a marker that the database may be mapped (KMC2 format)
+	if (mapped_pre && (mapped_suf = (uchar*)MapFile(file_suf, mapped_suf_size, populate)) != nullptr)
+		sufix_file_buf = mapped_suf + 4;		// skip "KMCS"
+	else
+	{
+		sufix_file_buf = new uchar[size];
+		result = fread(sufix_file_buf, 1, size, file_suf);
+		if (result != size)
+			return false;
+	}
 
 	fclose(file_suf);
 	file_suf = NULL;
 
+	// the database is usable without hashes, callers compute them if HasHashes() is false
+	if (with_hashes && !OpenHashFile(file_name, opened_for_RA))
+		with_hashes = false;
+
 	is_opened = opened_for_RA;
+	db_file_name = file_name;
 	prefix_index = 0;
 	sufix_number = 0;
 	return true;
@@ -59,6 +166,23 @@ bool CKMCFile::OpenForRA(const std::string &file_name)
 // RET	: true		- if successful
 //----------------------------------------------------------------------------------
 bool CKMCFile::OpenForListing(const std::string &file_name)
+{
+	return OpenForListingImpl(file_name, nullptr);
+}
+
+//----------------------------------------------------------------------------------
+// Open a part of the database for listing
+// IN	: file_name - the name of kmer_counter's output
+//		  range		- the part of the database (from GetListingRanges)
+// RET	: true		- if successful
+//----------------------------------------------------------------------------------
+bool CKMCFile::OpenForListing(const std::string &file_name, const CKMCFileRange& range)
+{
+	return OpenForListingImpl(file_name, &range);
+}
+
+//----------------------------------------------------------------------------------
+bool CKMCFile::OpenForListingImpl(const std::string &file_name, const CKMCFileRange* range)
 {
 	uint64 size;
 
@@ -73,40 +197,126 @@ bool CKMCFile::OpenForListing(const std::string &file_name)
 
 	ReadParamsFrom_prefix_file_buf(size, open_mode::opened_for_listing);
 
-	end_of_file = total_kmers == 0;
+	if (range)
+	{
+		if (range->lut_start > range->lut_end || range->lut_end > lut_last_index || range->kmer_start > range->kmer_end || range->kmer_end > total_kmers)
+		{
+			std::cerr << "Error: range does not match the database\n";
+			return false;
+		}
+		listing_range = *range;
+	}
+	else
+	{
+		listing_range.lut_start = 0;
+		listing_range.lut_end = lut_last_index;
+		listing_range.kmer_start = 0;
+		listing_range.kmer_end = total_kmers;
+	}
 
 	if (!OpenASingleFile(file_name + ".kmc_suf", file_suf, size, (char *)"KMCS"))
 		return false;
 
 	sufix_file_buf = new uchar[part_size];
 
-	suffix_file_total_to_read = size;
-	suf_file_left_to_read = suffix_file_total_to_read;
-	auto to_read = MIN(suf_file_left_to_read, part_size);
-	auto readed = fread(sufix_file_buf, 1, to_read, file_suf);
-	if (readed != to_read)
-	{
-		std::cerr << "Error: some error while reading suffix file\n";
-		return false;
-	}
+	suffix_file_total_to_read = range ? (listing_range.kmer_end - listing_range.kmer_start) * sufix_rec_size : size;
 
-	suf_file_left_to_read -= readed;
+	// the database is usable without hashes, callers compute them if HasHashes() is false
+	if (with_hashes && !OpenHashFile(file_name, opened_for_listing))
+		with_hashes = false;
 
 	is_opened = opened_for_listing;
-	prefix_index = 0;
-	sufix_number = 0;
-	index_in_partial_buf = 0;
-	return true;
+	db_file_name = file_name;
+	return StartListing();
 }
+
+//----------------------------------------------------------------------------------
+// Split the database into ranges of similar numbers of k-mers. Boundaries are found
+// by binary search in LUT, which is read from *.kmc_pre on demand
+// IN	: n_ranges	- the maximal number of ranges
+// OUT	: ranges	- nonempty ranges covering the whole database
+// RET	: true		- if successful
+//----------------------------------------------------------------------------------
+bool CKMCFile::GetListingRanges(uint32 n_ranges, std::vector<CKMCFileRange>& ranges)
+{
+	ranges.clear();
+	if (!is_opened || n_ranges == 0)
+		return false;
+
+	FILE* pre = my_fopen((db_file_name + ".kmc_pre").c_str(), "rb");
+	if (!pre)
+		return false;
+
+	bool ok = true;
+	auto lut = [&](uint64 pos) {
+		if (pos >= lut_last_index) // the guard entry is not stored in KMC1 databases
+			return total_kmers;
+		uint64 val = 0;
+		my_fseek(pre, 4 + 8 * pos, SEEK_SET);
+		if (fread(&val, sizeof(uint64), 1, pre) != 1)
+			ok = false;
+		return val;
+	};
+
+	CKMCFileRange range;
+	for (uint32 i = 1; i <= n_ranges && ok; ++i)
+	{
+		range.lut_end = lut_last_index;
+		range.kmer_end = total_kmers;
+		if (i < n_ranges)
+		{
+			// the first LUT entry with at least i / n_ranges of k-mers before it
+			uint64 target = total_kmers * i / n_ranges;
+			uint64 lo = range.lut_start, hi = lut_last_index;
+			while (lo < hi)
+			{
+				uint64 mid = lo + (hi - lo) / 2;
+				if (lut(mid) < target)
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+			range.lut_end = lo;
+			range.kmer_end = lut(lo);
+		}
+		if (range.kmer_end > range.kmer_start)
+		{
+			ranges.push_back(range);
+			range.lut_start = range.lut_end;
+			range.kmer_start = range.kmer_end;
+		}
+	}
+	fclose(pre);
+
+	if (!ok)
+		ranges.clear();
+	return ok;
+}
+
 //----------------------------------------------------------------------------------
 CKMCFile::CKMCFile()
 {
 	file_pre = NULL;	
 	file_suf = NULL;
+	file_hash = NULL;
 
 	prefix_file_buf = NULL;
+	lut_data = nullptr;
 	sufix_file_buf = NULL;
 	signature_map = NULL;
+	hash_file_buf = NULL;
+
+	use_mmap = mmap_populate = false;
+	mapped_pre = mapped_suf = mapped_hash = nullptr;
+	mapped_pre_size = mapped_suf_size = mapped_hash_size = 0;
+	hash_index_ready = false;
+
+	with_hashes = false;
+	hash_seed = 0;
+	max_hash = 0;
+	hash_buf_start = hash_buf_size = 0;
+
+	lut_last_index = 0;
 
 	is_opened = closed;
 	end_of_file = false;
@@ -118,10 +328,11 @@ CKMCFile::~CKMCFile()
 		fclose(file_pre);
 	if (file_suf)
 		fclose(file_suf);
-	if (prefix_file_buf)
-		delete[] prefix_file_buf;
-	if (sufix_file_buf)
-		delete[] sufix_file_buf;
+	if (file_hash)
+		fclose(file_hash);
+	if (hash_file_buf)
+		delete[] hash_file_buf;
+	ReleaseRABuffers();
 	if (signature_map)
 		delete[] signature_map;
 }
@@ -216,6 +427,12 @@ bool CKMCFile::ReadParamsFrom_prefix_file_buf(uint64 &size, open_mode _open_mode
 		result = fread(&both_strands, 1, 1, file_pre);
 		both_strands = !both_strands;
 
+		uchar flags;
+		result = fread(&flags, 1, 1, file_pre);
+		with_hashes = (flags & 1) != 0;
+		result = fread(&hash_seed, 1, sizeof(uint32), file_pre);
+		result = fread(&max_hash, 1, sizeof(uint64), file_pre);
+
 		signature_map_size = ((1 << (2 * signature_len)) + 1);
 		uint64 lut_area_size_in_bytes = size - (signature_map_size * sizeof(uint32)+header_offset + 8);
 		single_LUT_size = 1 << (2 * lut_prefix_length);
@@ -230,27 +447,34 @@ bool CKMCFile::ReadParamsFrom_prefix_file_buf(uint64 &size, open_mode _open_mode
 
 		if(_open_mode == opened_for_RA)
 		{
-			rewind(file_pre);
-			my_fseek(file_pre, +4, SEEK_CUR);
 			prefix_file_buf_size = (lut_area_size_in_bytes + 8) / sizeof(uint64);		//reads without 4 bytes of a header_offset (and without markers)
-			prefix_file_buf = new uint64[prefix_file_buf_size];
-			result = fread(prefix_file_buf, 1, (size_t)(lut_area_size_in_bytes + 8), file_pre);
-			if (result == 0)
-				return false;
-
-			prefix_file_buf[last_data_index] = total_kmers + 1; //I think + 1 if wrong, but due to the implementation of binary search it does not matter, it was here in kmc 0.3 and I leave it this way just in case...
 
-			result = fread(signature_map, 1, signature_map_size * sizeof(uint32), file_pre);
-			if (result == 0)
-				return false;
+			// In a mapped file the LUT starts just after "KMCP", so it is not aligned to 8 bytes and entries are read with lut_entry.
+			// The last entry is the number of k-mers stored by the completer instead of total_kmers + 1, which is also correct for BinarySearch
+			if (use_mmap && (mapped_pre = (uchar*)MapFile(file_pre, mapped_pre_size, mmap_populate)) != nullptr)
+				lut_data = mapped_pre + 4;
+			else
+			{
+				rewind(file_pre);
+				my_fseek(file_pre, +4, SEEK_CUR);
+				prefix_file_buf = new uint64[prefix_file_buf_size];
+				lut_data = (const uchar*)prefix_file_buf;
+				result = fread(prefix_file_buf, 1, (size_t)(lut_area_size_in_bytes + 8), file_pre);
+				if (result == 0)
+					return false;
+
+				prefix_file_buf[last_data_index] = total_kmers + 1; //I think + 1 if wrong, but due to the implementation of binary search it does not matter, it was here in kmc 0.3 and I leave it this way just in case...
+
+				result = fread(signature_map, 1, signature_map_size * sizeof(uint32), file_pre);
+				if (result == 0)
+					return false;
+			}
 
 			fclose(file_pre);
 			file_pre = nullptr;
 		}
-		else
-		{
-			prefixFileBufferForListingMode = std::make_unique<CPrefixFileBufferForListingMode>(file_pre, last_data_index, lut_prefix_length, false, total_kmers);
-		}
+
+		lut_last_index = last_data_index;
 
 		sufix_size = (kmer_length - lut_prefix_length) / 4;
 	
@@ -299,6 +523,7 @@ bool CKMCFile::ReadParamsFrom_prefix_file_buf(uint64 &size, open_mode _open_mode
 		if (_open_mode == opened_for_RA)
 		{
 			prefix_file_buf = new uint64[prefix_file_buf_size];
+			lut_data = (const uchar*)prefix_file_buf;
 			fseek(file_pre, 4, SEEK_SET);
 			result = fread(prefix_file_buf, 1, (size_t)(prefix_file_buf_size * sizeof(uint64)), file_pre);
 			if (result == 0)
@@ -309,10 +534,8 @@ bool CKMCFile::ReadParamsFrom_prefix_file_buf(uint64 &size, open_mode _open_mode
 			fclose(file_pre);
 			file_pre = nullptr;
 		}
-		else
-		{
-			prefixFileBufferForListingMode = std::make_unique<CPrefixFileBufferForListingMode>(file_pre, last_data_index, lut_prefix_length, true, total_kmers);
-		}
+
+		lut_last_index = last_data_index;
 
 		sufix_size = (kmer_length - lut_prefix_length) / 4;
 
@@ -353,14 +576,14 @@ bool CKMCFile::CheckKmer(CKmerAPI &kmer, uint32 &count)
 		uint32 bin_start_pos = signature_map[signature];
 		bin_start_pos *= single_LUT_size;				
 		//look into the array with data
-		index_start = *(prefix_file_buf + bin_start_pos + pattern_prefix_value);
-		index_stop = *(prefix_file_buf + bin_start_pos + pattern_prefix_value + 1) - 1;
+		index_start = lut_entry(bin_start_pos + pattern_prefix_value);
+		index_stop = lut_entry(bin_start_pos + pattern_prefix_value + 1) - 1;
 	}
 	else if (kmc_version == 0)
 	{
 		//look into the array with data
-		index_start = prefix_file_buf[pattern_prefix_value];
-		index_stop = prefix_file_buf[pattern_prefix_value + 1] - 1;
+		index_start = lut_entry(pattern_prefix_value);
+		index_stop = lut_entry(pattern_prefix_value + 1) - 1;
 	}
 	uint64 tmp_count ;
 	bool res = BinarySearch(index_start, index_stop, kmer, tmp_count, pattern_offset);
@@ -397,18 +620,162 @@ bool CKMCFile::CheckKmer(CKmerAPI &kmer, uint64 &count)
 		uint32 bin_start_pos = signature_map[signature];
 		bin_start_pos *= single_LUT_size;
 		//look into the array with data
-		index_start = *(prefix_file_buf + bin_start_pos + pattern_prefix_value);
-		index_stop = *(prefix_file_buf + bin_start_pos + pattern_prefix_value + 1) - 1;
+		index_start = lut_entry(bin_start_pos + pattern_prefix_value);
+		index_stop = lut_entry(bin_start_pos + pattern_prefix_value + 1) - 1;
 	}
 	else if (kmc_version == 0)
 	{
 		//look into the array with data
-		index_start = prefix_file_buf[pattern_prefix_value];
-		index_stop = prefix_file_buf[pattern_prefix_value + 1] - 1;
+		index_start = lut_entry(pattern_prefix_value);
+		index_stop = lut_entry(pattern_prefix_value + 1) - 1;
 	}
 	return BinarySearch(index_start, index_stop, kmer, count, pattern_offset);
 }
 
+//------------------------------------------------------------------------------------------
+// Find the position in prefix_file_buf of the LUT entry of kmer (random access mode)
+// RET: false if kmer cannot be present in the database
+//------------------------------------------------------------------------------------------
+bool CKMCFile::GetLutPosForRA(const CKmerAPI& kmer, uint64& lut_pos)
+{
+	//recognize a prefix:
+	uint64 pattern_prefix_value = kmer.kmer_data[0];
+	uint32 pattern_offset = (sizeof(pattern_prefix_value)* 8) - (lut_prefix_length * 2) - (kmer.byte_alignment * 2);
+
+	pattern_prefix_value = pattern_prefix_value >> pattern_offset;  //complements with 0
+	if (pattern_prefix_value >= prefix_file_buf_size)
+		return false;
+
+	if (kmc_version == 0x200)
+		lut_pos = (uint64)signature_map[kmer.get_signature(signature_len)] * single_LUT_size + pattern_prefix_value;
+	else
+		lut_pos = pattern_prefix_value;
+	return true;
+}
+
+//------------------------------------------------------------------------------------------
+// Check many kmers at once. Kmers are processed in groups of check_kmers_lanes. LUT entries
+// of the next group are prefetched while the current group is searched. In each step of the
+// search the middle records of all lanes are prefetched first and compared afterwards, so the
+// cache misses of independent searches overlap.
+// IN : kmers    - kmers to check
+// OUT: counters - counters[i] is the counter of kmers[i], 0 if kmers[i] does not exist
+// RET: true     - if the database is opened for random access
+//------------------------------------------------------------------------------------------
+bool CKMCFile::CheckKmers(const std::vector<CKmerAPI>& kmers, std::vector<uint64>& counters)
+{
+	if (is_opened != opened_for_RA)
+		return false;
+
+	counters.assign(kmers.size(), 0);
+	if (end_of_file || kmers.empty())
+		return true;
+
+	struct search_t
+	{
+		int64 index_start, index_stop, mid_index;
+	};
+	search_t lanes[check_kmers_lanes];
+	uint64 lut_pos[2][check_kmers_lanes];
+	bool valid[2][check_kmers_lanes];
+
+	auto prefetch_lut = [&](uint64 group, uint32 buf) {
+		for (uint64 i = group; i < MIN(group + check_kmers_lanes, (uint64)kmers.size()); ++i)
+		{
+			valid[buf][i - group] = GetLutPosForRA(kmers[i], lut_pos[buf][i - group]);
+			if (valid[buf][i - group])
+				KMC_PREFETCH(lut_data + lut_pos[buf][i - group] * sizeof(uint64));
+		}
+	};
+
+	uint32 cur = 0;
+	prefetch_lut(0, cur);
+	for (uint64 group = 0; group < kmers.size(); group += check_kmers_lanes, cur ^= 1)
+	{
+		uint32 n_lanes = (uint32)MIN((uint64)check_kmers_lanes, kmers.size() - group);
+		uint32 n_active = 0;
+		for (uint32 j = 0; j < n_lanes; ++j)
+		{
+			search_t& s = lanes[j];
+			if (valid[cur][j])
+			{
+				s.index_start = lut_entry(lut_pos[cur][j]);
+				s.index_stop = lut_entry(lut_pos[cur][j] + 1) - 1;
+				if (s.index_start >= static_cast<int64>(total_kmers))
+					s.index_stop = s.index_start - 1;
+			}
+			else
+			{
+				s.index_start = 0;
+				s.index_stop = -1;
+			}
+			if (s.index_start <= s.index_stop)
+				++n_active;
+		}
+
+		if (group + check_kmers_lanes < kmers.size())
+			prefetch_lut(group + check_kmers_lanes, cur ^ 1);
+
+		while (n_active)
+		{
+			for (uint32 j = 0; j < n_lanes; ++j)
+				if (lanes[j].index_start <= lanes[j].index_stop)
+				{
+					lanes[j].mid_index = (lanes[j].index_start + lanes[j].index_stop) / 2;
+					KMC_PREFETCH(&sufix_file_buf[lanes[j].mid_index * sufix_rec_size]);
+				}
+
+			n_active = 0;
+			for (uint32 j = 0; j < n_lanes; ++j)
+			{
+				search_t& s = lanes[j];
+				if (s.index_start > s.index_stop)
+					continue;
+				int cmp = CompareSufix(&sufix_file_buf[s.mid_index * sufix_rec_size], kmers[group + j]);
+				if (cmp == 0)
+				{
+					uint64 counter = GetCounterForRA(s.mid_index);
+					//applay filtering only if counter_size != 0
+					if ((counter_size == 0) || ((counter >= min_count) && (counter <= max_count)))
+						counters[group + j] = counter;
+					s.index_start = s.index_stop + 1;
+					continue;
+				}
+				if (cmp < 0)
+					s.index_start = s.mid_index + 1;
+				else
+					s.index_stop = s.mid_index - 1;
+				if (s.index_start <= s.index_stop)
+					++n_active;
+			}
+		}
+	}
+	return true;
+}
+
+//------------------------------------------------------------------------------------------
+// Check if k-mer of given hash exists (only for databases with *.kmc_hash file)
+// IN : hash  - MurmurHash3 of k-mer (the first 64 bits)
+// OUT: count - kmer's counter if kmer exists
+// RET: true  - if kmer exists
+//------------------------------------------------------------------------------------------
+bool CKMCFile::CheckHash(uint64 hash, uint64 &count)
+{
+	if (is_opened != opened_for_RA || !with_hashes)
+		return false;
+	if (!hash_index_ready.load(std::memory_order_acquire) && !BuildHashIndex())
+		return false;
+
+	auto it = std::lower_bound(hash_index.begin(), hash_index.end(), std::make_pair(hash, (uint64)0));
+	if (it == hash_index.end() || it->first != hash)
+		return false;
+
+	count = GetCounterForRA(it->second);
+
+	//applay filtering only if counter_size != 0
+	return (counter_size == 0) || ((count >= min_count) && (count <= max_count));
+}
+
 //-----------------------------------------------------------------------------------------------
 // Check if end of file
 // RET: true - all kmers are listed
@@ -490,7 +857,7 @@ bool CKMCFile::ReadNextKmer(CKmerAPI &kmer, uint32 &count)
 		}
 		sufix_number++;
 	
-		if(sufix_number == total_kmers)
+		if(sufix_number == listing_range.kmer_end)
 			end_of_file = true;
 	}
 	while ((counter_size != 0) && ((count < min_count) || (count > max_count))); //do not applay filtering if counter_size == 0 as it does not make sense
@@ -569,7 +936,7 @@ bool CKMCFile::ReadNextKmer(CKmerAPI &kmer, uint64 &count)
 		}
 		sufix_number++;
 
-		if (sufix_number == total_kmers)
+		if (sufix_number == listing_range.kmer_end)
 			end_of_file = true;
 
 	} while ((counter_size != 0) && ((count < min_count) || (count > max_count))); //do not applay filtering if counter_size == 0 as it does not make sense
@@ -577,6 +944,53 @@ bool CKMCFile::ReadNextKmer(CKmerAPI &kmer, uint64 &count)
 	return true;
 }
 
+//-----------------------------------------------------------------------------------------------
+// Read next kmer with its hash (only for databases with *.kmc_hash file)
+// OUT: kmer - next kmer
+// OUT: count - kmer's counter
+// OUT: hash - kmer's hash
+// RET: true - if not EOF
+//-----------------------------------------------------------------------------------------------
+bool CKMCFile::ReadNextKmer(CKmerAPI &kmer, uint64 &count, uint64 &hash)
+{
+	if (!with_hashes)
+		return false;
+	if (!ReadNextKmer(kmer, count))
+		return false;
+	return GetHashForListing(sufix_number - 1, hash);
+}
+
+//-----------------------------------------------------------------------------------------------
+// Read many kmers at once
+// OUT: kmers - packed kmers, (kmer_length + 31) / 32 words per kmer, the same as CKmerAPI::to_long
+// OUT: counts - kmers' counters saturated to 32 bits (may be nullptr)
+// OUT: hashes - kmers' hashes (may be nullptr, must be nullptr if the database has no hashes)
+// IN : max_kmers - capacity of output arrays (in kmers)
+// RET: the number of kmers read
+//-----------------------------------------------------------------------------------------------
+uint64 CKMCFile::ReadNextKmers(uint64* kmers, uint32* counts, uint64* hashes, uint64 max_kmers)
+{
+	if (is_opened != opened_for_listing || (hashes && !with_hashes))
+		return 0;
+
+	CKmerAPI kmer(kmer_length);
+	std::vector<uint64> kmer_words;
+	uint32 n_words = (kmer_length + 31) / 32;
+	uint64 count;
+	uint64 n = 0;
+	while (n < max_kmers && ReadNextKmer(kmer, count))
+	{
+		kmer.to_long(kmer_words);
+		std::copy(kmer_words.begin(), kmer_words.end(), kmers + n * n_words);
+		if (counts)
+			counts[n] = (uint32)MIN(count, (uint64)0xFFFFFFFF);
+		if (hashes && !GetHashForListing(sufix_number - 1, hashes[n]))
+			break;
+		++n;
+	}
+	return n;
+}
+
 //-------------------------------------------------------------------------------
 // Reload a contents of an array "sufix_file_buf" for listing mode. Auxiliary function.
 //-------------------------------------------------------------------------------
@@ -593,6 +1007,132 @@ void CKMCFile::Reload_sufix_file_buf()
 	}
 	index_in_partial_buf = 0;
 }
+//-------------------------------------------------------------------------------
+// Open *.kmc_hash file. In listing mode the file is buffered, in random access
+// mode it is mapped (OpenForRAMapped) or left open, the index of k-mers sorted by hash
+// is built by the first CheckHash. Auxiliary function.
+// IN	: file_name - the name of kmer_counter's output
+// RET	: true		- if successful, false if the file is missing or damaged
+//-------------------------------------------------------------------------------
+bool CKMCFile::OpenHashFile(const std::string& file_name, open_mode _open_mode)
+{
+	uint64 size;
+	if (!OpenASingleFile(file_name + ".kmc_hash", file_hash, size, (char *)"KMCH") || size != total_kmers * sizeof(uint64))
+	{
+		std::cerr << "Warning: " << file_name << ".kmc_hash is missing or does not match the number of k-mers, stored hashes are not used\n";
+		if (file_hash)
+		{
+			fclose(file_hash);
+			file_hash = NULL;
+		}
+		return false;
+	}
+
+	if (_open_mode == opened_for_RA)
+	{
+		hash_index_ready = false;
+		if (mapped_pre && (mapped_hash = (uchar*)MapFile(file_hash, mapped_hash_size, false)) != nullptr)
+		{
+			fclose(file_hash);
+			file_hash = NULL;
+		}
+	}
+	else
+	{
+		hash_file_buf = new uint64[hash_part_size];
+		hash_buf_start = hash_buf_size = 0;
+	}
+	return true;
+}
+
+//-------------------------------------------------------------------------------
+// Build the index of k-mers sorted by hash from the mapped or opened *.kmc_hash
+// (random access mode). Called by the first CheckHash. Auxiliary function.
+// RET	: true		- if successful
+//-------------------------------------------------------------------------------
+bool CKMCFile::BuildHashIndex()
+{
+	std::lock_guard<std::mutex> lck(hash_index_mutex);
+	if (hash_index_ready.load(std::memory_order_relaxed))
+		return true;
+
+	hash_index.resize(total_kmers);
+	if (mapped_hash)
+	{
+		// hashes start just after "KMCH", so they are not aligned to 8 bytes
+		const uchar* hashes = mapped_hash + 4;
+		for (uint64 i = 0; i < total_kmers; ++i)
+		{
+			memcpy(&hash_index[i].first, hashes + i * sizeof(uint64), sizeof(uint64));
+			hash_index[i].second = i;
+		}
+		UnmapFile(mapped_hash, mapped_hash_size);
+		mapped_hash = nullptr;
+		mapped_hash_size = 0;
+	}
+	else
+	{
+		std::vector<uint64> hashes((size_t)MIN(hash_part_size, total_kmers));
+		my_fseek(file_hash, 4, SEEK_SET);
+		for (uint64 i = 0; i < total_kmers; )
+		{
+			auto to_read = MIN((uint64)hashes.size(), total_kmers - i);
+			if (fread(hashes.data(), sizeof(uint64), (size_t)to_read, file_hash) != to_read)
+			{
+				std::cerr << "Error: some error while reading hash file\n";
+				hash_index.clear();
+				return false;
+			}
+			for (uint64 j = 0; j < to_read; ++j, ++i)
+				hash_index[i] = std::make_pair(hashes[j], i);
+		}
+		fclose(file_hash);
+		file_hash = NULL;
+	}
+	std::sort(hash_index.begin(), hash_index.end());
+
+	hash_index_ready.store(true, std::memory_order_release);
+	return true;
+}
+
+//-------------------------------------------------------------------------------
+// Get the hash of the k-mer of given number (listing mode). Auxiliary function.
+// RET	: false		- if the hash file cannot be read
+//-------------------------------------------------------------------------------
+bool CKMCFile::GetHashForListing(uint64 kmer_number, uint64& hash)
+{
+	while (kmer_number >= hash_buf_start + hash_buf_size)
+	{
+		hash_buf_start += hash_buf_size;
+		hash_buf_size = MIN(hash_part_size, listing_range.kmer_end - hash_buf_start);
+		auto readed = fread(hash_file_buf, sizeof(uint64), (size_t)hash_buf_size, file_hash);
+		if (readed != hash_buf_size)
+		{
+			std::cerr << "Error: some error while reading hash file\n";
+			hash_buf_size = 0;
+			end_of_file = true;
+			return false;
+		}
+	}
+	hash = hash_file_buf[kmer_number - hash_buf_start];
+	return true;
+}
+
+//-------------------------------------------------------------------------------
+// Return counter of the k-mer of given number (random access mode). Auxiliary function.
+//-------------------------------------------------------------------------------
+uint64 CKMCFile::GetCounterForRA(uint64 kmer_number)
+{
+	if (counter_size == 0)
+		return 1;
+
+	uchar *counter_ptr = sufix_file_buf + kmer_number * sufix_rec_size + sufix_size;
+	uint64 counter = 0;
+	for (uint32 b = 0; b < counter_size; b++)
+		counter |= (uint64)counter_ptr[b] << (8 * b);
+	return counter;
+}
+
 //-------------------------------------------------------------------------------
 // Release memory and close files in case they were opened 
 // RET: true - if files have been readed
@@ -611,15 +1151,23 @@ bool CKMCFile::Close()
 			fclose(file_suf);
 			file_suf = NULL;
 		}
+		if (file_hash)
+		{
+			fclose(file_hash);
+			file_hash = NULL;
+		}
 	
 		is_opened = closed;
 		end_of_file = false;
-		delete [] prefix_file_buf;
-		prefix_file_buf = NULL;
-		delete [] sufix_file_buf;
-		sufix_file_buf = NULL;
+		ReleaseRABuffers();
 		delete[] signature_map;
 		signature_map = NULL;
+		delete[] hash_file_buf;
+		hash_file_buf = NULL;
+		hash_index.clear();
+		hash_index.shrink_to_fit();
+		hash_index_ready = false;
+		with_hashes = false;
 
 		return true;
 	}
@@ -633,28 +1181,44 @@ bool CKMCFile::Close()
 bool CKMCFile::RestartListing(void)
 {
 	if(is_opened == opened_for_listing)
-	{
-		my_fseek(file_suf , 4 , SEEK_SET);
-		suf_file_left_to_read = suffix_file_total_to_read;
-		auto to_read = MIN(suf_file_left_to_read, part_size);
-		auto readed = fread(sufix_file_buf, 1, to_read, file_suf);
-		if (readed != to_read)
-		{
-			std::cerr << "Error: some error while reading suffix file\n";
-			return false;
-		}
+		return StartListing();
+	return false;
+}
+
+//----------------------------------------------------------------------------------
+// Position prefix, sufix and hash readers at the beginning of listing_range. Auxiliary function.
+// RET: true - if successful
+//----------------------------------------------------------------------------------
+bool CKMCFile::StartListing()
+{
+	prefixFileBufferForListingMode = std::make_unique<CPrefixFileBufferForListingMode>(file_pre, listing_range.lut_start, listing_range.lut_end,
+		lut_prefix_length, kmc_version == 0 && listing_range.lut_end == lut_last_index, total_kmers);
 
-		suf_file_left_to_read -= readed;
-		prefix_index = 0;
-		sufix_number = 0;
-		index_in_partial_buf = 0;
+	my_fseek(file_suf, 4 + listing_range.kmer_start * sufix_rec_size, SEEK_SET);
+	suf_file_left_to_read = suffix_file_total_to_read;
+	auto to_read = MIN(suf_file_left_to_read, part_size);
+	auto readed = fread(sufix_file_buf, 1, to_read, file_suf);
+	if (readed != to_read)
+	{
+		std::cerr << "Error: some error while reading suffix file\n";
+		return false;
+	}
 
-		end_of_file = total_kmers == 0;
+	suf_file_left_to_read -= readed;
+	prefix_index = 0;
+	sufix_number = listing_range.kmer_start;
+	index_in_partial_buf = 0;
 
-		return true;
+	if (with_hashes)
+	{
+		my_fseek(file_hash, 4 + 8 * listing_range.kmer_start, SEEK_SET);
+		hash_buf_start = listing_range.kmer_start;
+		hash_buf_size = 0;
 	}
-	return false;
-		
+
+	end_of_file = sufix_number == listing_range.kmer_end;
+
+	return true;
 }
 //----------------------------------------------------------------------------------------
 // Set the minimal value for a counter. Kmers with counters below this theshold are ignored
@@ -858,6 +1422,9 @@ bool CKMCFile::Info(CKMCFileInfo& info)
 		info.max_count = max_count;
 		info.total_kmers = total_kmers;
 		info.both_strands = both_strands;
+		info.with_hashes = with_hashes;
+		info.hash_seed = hash_seed;
+		info.max_hash = max_hash;
 		return true;
 	}
 	return false;
@@ -915,8 +1482,8 @@ uint32 CKMCFile::count_for_kmer_kmc1(CKmerAPI& kmer)
 		return false;
 	//look into the array with data
 
-	int64 index_start = prefix_file_buf[pattern_prefix_value];
-	int64 index_stop = prefix_file_buf[pattern_prefix_value + 1] - 1;
+	int64 index_start = lut_entry(pattern_prefix_value);
+	int64 index_stop = lut_entry(pattern_prefix_value + 1) - 1;
 
 	uint64 counter = 0;
 	if (BinarySearch(index_start, index_stop, kmer, counter, pattern_offset))
@@ -939,8 +1506,8 @@ uint32 CKMCFile::count_for_kmer_kmc2(CKmerAPI& kmer, uint32 bin_start_pos)
 		return false;
 	//look into the array with data
 
-	int64 index_start = *(prefix_file_buf + bin_start_pos + pattern_prefix_value);
-	int64 index_stop = *(prefix_file_buf + bin_start_pos + pattern_prefix_value + 1) - 1;
+	int64 index_start = lut_entry(bin_start_pos + pattern_prefix_value);
+	int64 index_stop = lut_entry(bin_start_pos + pattern_prefix_value + 1) - 1;
 
 	uint64 counter = 0;
 	if (BinarySearch(index_start, index_stop, kmer, counter, pattern_offset))
@@ -1318,84 +1885,54 @@ bool CKMCFile::GetCountersForRead_kmc2(const std::string& read, std::vector<uint
 //---------------------------------------------------------------------------------
 // Auxiliary function.
 //---------------------------------------------------------------------------------
-bool CKMCFile::BinarySearch(int64 index_start, int64 index_stop, const CKmerAPI& kmer, uint64& counter, uint32 pattern_offset)
+bool CKMCFile::BinarySearch(int64 index_start, int64 index_stop, const CKmerAPI& kmer, uint64& counter, uint32 /*pattern_offset*/)
 {
 	if (index_start >= static_cast<int64>(total_kmers))
 		return false;
-	uchar *sufix_byte_ptr = nullptr;
-	uint64 sufix = 0;
-
-	//sufix_offset is always 56
-	uint32 sufix_offset = 56;			// the offset of a sufix is for shifting the sufix towards MSB, to compare the sufix with a pattern
-	// Bytes of a pattern to search are always shifted towards MSB
-
-	uint32 row_index = 0;				// the number of a current row in an array kmer_data
-
-	bool found = false;
 
 	while (index_start <= index_stop)
 	{
 		int64 mid_index = (index_start + index_stop) / 2;
-		sufix_byte_ptr = &sufix_file_buf[mid_index * sufix_rec_size];
-
-		uint64 pattern = 0;
-
-		pattern_offset = (lut_prefix_length + kmer.byte_alignment) * 2;
+		int cmp = CompareSufix(&sufix_file_buf[mid_index * sufix_rec_size], kmer);
 
-		row_index = 0;
-		for (uint32 a = 0; a < sufix_size; a++)		//check byte by byte
+		if (cmp == 0)
 		{
-			pattern = kmer.kmer_data[row_index];
-			pattern = pattern << pattern_offset;
-			pattern = pattern & 0xff00000000000000;
-
-			sufix = sufix_byte_ptr[a];
-			sufix = sufix << sufix_offset;
-
-			if (pattern != sufix)
-				break;
-
-			pattern_offset += 8;
-
-			if (pattern_offset == 64)				//the end of a word
-			{
-				pattern_offset = 0;
-				row_index++;
-			}
+			counter = GetCounterForRA(mid_index);
+			//applay filtering only if counter_size != 0
+			return (counter_size == 0) || ((counter >= min_count) && (counter <= max_count));
 		}
-
-		if (pattern == sufix)
-		{
-			found = true;
-			break;
-		}
-		if (sufix < pattern)
+		if (cmp < 0)
 			index_start = mid_index + 1;
 		else
 			index_stop = mid_index - 1;
 	}
+	return false;
+}
 
-	if (found)
-	{
-		if (counter_size == 0)
-			counter = 1;
-		else
-		{
-			sufix_byte_ptr += sufix_size;
-			counter = *sufix_byte_ptr;
+//-----------------------------------------------------------------------------------------------
+// Compare a sufix of a record with a sufix of kmer (its symbols after lut prefix)
+// RET: < 0 if the record is smaller, 0 if equal, > 0 if greater
+//-----------------------------------------------------------------------------------------------
+int CKMCFile::CompareSufix(const uchar* sufix_byte_ptr, const CKmerAPI& kmer) const
+{
+	// Bytes of a pattern to compare are always shifted towards MSB
+	uint32 pattern_offset = (lut_prefix_length + kmer.byte_alignment) * 2;
+	uint32 row_index = 0;				// the number of a current row in an array kmer_data
 
-			for (uint32 b = 1; b < counter_size; b++)
-			{
-				uint64 aux = 0x000000ff & *(sufix_byte_ptr + b);
+	for (uint32 a = 0; a < sufix_size; a++)		//check byte by byte
+	{
+		uint64 pattern = (kmer.kmer_data[row_index] << pattern_offset) >> 56;
+		if (sufix_byte_ptr[a] != pattern)
+			return sufix_byte_ptr[a] < pattern ? -1 : 1;
 
-				aux = aux << 8 * (b);
-				counter = aux | counter;
-			}
+		pattern_offset += 8;
+		if (pattern_offset == 64)				//the end of a word
+		{
+			pattern_offset = 0;
+			row_index++;
 		}
-		//applay filtering only if counter_size != 0
-		return (counter_size == 0) || ((counter >= min_count) && (counter <= max_count));
 	}
-	return false;
+	return 0;
 }
 
 
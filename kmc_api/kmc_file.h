@@ -16,6 +16,9 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstring>
 #include <cassert>
 
 struct CKMCFileInfo
@@ -29,6 +32,18 @@ struct CKMCFileInfo
 	uint64 max_count;
 	bool both_strands;
 	uint64 total_kmers;
+	bool with_hashes;		// true if .kmc_hash file is present (kmc -hash)
+	uint32 hash_seed;
+	uint64 max_hash;
+};
+
+// A part of a database for parallel listing: LUT entries [lut_start, lut_end) and k-mers [kmer_start, kmer_end) of these prefixes
+struct CKMCFileRange
+{
+	uint64 lut_start = 0;
+	uint64 lut_end = 0;
+	uint64 kmer_start = 0;
+	uint64 kmer_end = 0;
 };
 
 class CKMCFile
@@ -61,16 +76,18 @@ class CKMCFile
 			posInBuf = 0;
 		}
 	public:
-		CPrefixFileBufferForListingMode(FILE* file, uint64_t wholeLutSize, uint64_t lutPrefixLen, bool isKMC1, uint64_t totalKmers)
+		//lutStart, lutEnd - LUT entries to list, isKMC1 must be false if lutEnd is not the last entry (guard)
+		CPrefixFileBufferForListingMode(FILE* file, uint64_t lutStart, uint64_t lutEnd, uint64_t lutPrefixLen, bool isKMC1, uint64_t totalKmers)
 			:
 			buff(new uint64_t[buffCapacity]),
-			leftToRead(wholeLutSize),
+			buffPosInFile(lutStart),
+			leftToRead(lutEnd - lutStart),
 			prefixMask((1ull << (2 * lutPrefixLen)) - 1),
 			file(file),
 			isKMC1(isKMC1),
 			totalKmers(totalKmers)
 		{
-			my_fseek(file, 4 + 8, SEEK_SET); //	skip KMCP and LUT[0] (always = 0)
+			my_fseek(file, 4 + 8 * (lutStart + 1), SEEK_SET); //	skip KMCP and LUT[lutStart] (the first k-mer of the range)
 		}
 
 		//no control if next prefix exists here, responsibility to the caller
@@ -103,10 +120,15 @@ protected:
 
 	FILE *file_pre;
 	FILE *file_suf;
+	FILE *file_hash;
 
-	uint64* prefix_file_buf; //only for random access mode
+	uint64* prefix_file_buf; //only for random access mode, nullptr if *.kmc_pre is mapped
+	const uchar* lut_data;	//only for random access mode, LUT in prefix_file_buf or in mapped_pre (not aligned to 8 bytes there)
 	uint64 prefix_file_buf_size; //only for random access mode
 	std::unique_ptr<CPrefixFileBufferForListingMode> prefixFileBufferForListingMode;
+	uint64 lut_last_index;			// The index of the last (guard) entry of LUT
+	CKMCFileRange listing_range;	// The part of the database listed in listing mode (whole database by default)
+	std::string db_file_name;
 
 	uint64 prefix_index;			// The current prefix's index in an array "prefix_file_buf", readed from *.kmc_pre
 	uint32 single_LUT_size;			// The size of a single LUT (in no. of elements)
@@ -114,7 +136,16 @@ protected:
 	uint32* signature_map;
 	uint32 signature_map_size;
 	
-	uchar* sufix_file_buf;
+	uchar* sufix_file_buf;			// in random access mode may point into mapped_suf
+
+	bool use_mmap;					// map files in random access mode (OpenForRAMapped)
+	bool mmap_populate;
+	uchar* mapped_pre;				// mappings of *.kmc_pre, *.kmc_suf and *.kmc_hash files, nullptr if files are read to RAM
+	uchar* mapped_suf;
+	uchar* mapped_hash;				// released when hash_index is built
+	uint64 mapped_pre_size;
+	uint64 mapped_suf_size;
+	uint64 mapped_hash_size;
 	uint64 sufix_number;			// The sufix's number to be listed
 	uint64 index_in_partial_buf;	// The current byte's number in an array "sufix_file_buf", for listing mode
 
@@ -135,10 +166,50 @@ protected:
 	uint32 original_min_count;
 	uint64 original_max_count;
 
+	bool with_hashes;				// .kmc_hash file with MurmurHash3 of each k-mer (in the order of *.kmc_suf) is present
+	uint32 hash_seed;
+	uint64 max_hash;
+	uint64* hash_file_buf;			// only for listing mode
+	uint64 hash_buf_start;			// the number of the first k-mer which hash is in "hash_file_buf"
+	uint64 hash_buf_size;
+	std::vector<std::pair<uint64, uint64>> hash_index;	// only for random access mode, (hash, k-mer number) sorted by hash, built by the first CheckHash
+	std::atomic<bool> hash_index_ready;
+	std::mutex hash_index_mutex;
+
 	static uint64 part_size; // the size of a block readed to sufix_file_buf, in listing mode 
+	static uint64 hash_part_size; // the number of hashes readed to hash_file_buf, in listing mode
 	
+	static const uint32 check_kmers_lanes = 16; // the number of binary searches interleaved in CheckKmers
+
 	bool BinarySearch(int64 index_start, int64 index_stop, const CKmerAPI& kmer, uint64& counter, uint32 pattern_offset);
 
+	// Compare a record of *.kmc_suf with a sufix of kmer. Auxiliary function.
+	int CompareSufix(const uchar* sufix_byte_ptr, const CKmerAPI& kmer) const;
+
+	// Return the LUT entry of given position (random access mode). Auxiliary function.
+	uint64 lut_entry(uint64 pos) const
+	{
+		uint64 r;
+		memcpy(&r, lut_data + pos * sizeof(uint64), sizeof(r));
+		return r;
+	}
+
+	// Find the position of the LUT entry of kmer in prefix_file_buf. Auxiliary function.
+	bool GetLutPosForRA(const CKmerAPI& kmer, uint64& lut_pos);
+
+	// Implementation of OpenForRA and OpenForRAMapped
+	bool OpenForRAImpl(const std::string &file_name, bool mapped, bool populate);
+
+	// Implementation of both OpenForListing, range == nullptr means the whole database
+	bool OpenForListingImpl(const std::string &file_name, const CKMCFileRange* range);
+
+	// Map a whole file, return nullptr if not possible. Auxiliary functions.
+	static void* MapFile(FILE* file, uint64& mapped_size, bool populate);
+	static void UnmapFile(void* ptr, uint64 mapped_size);
+
+	// Release (or unmap) prefix_file_buf and sufix_file_buf. Auxiliary function.
+	void ReleaseRABuffers();
+
 	// Open a file, recognize its size and check its marker. Auxiliary function.
 	bool OpenASingleFile(const std::string &file_name, FILE *&file_handler, uint64 &size, char marker[]);	
 
@@ -148,6 +219,21 @@ protected:
 	// Reload a contents of an array "sufix_file_buf" for listing mode. Auxiliary function. 
 	void Reload_sufix_file_buf();
 
+	// Position prefix, sufix and hash readers at the beginning of listing_range (listing mode). Auxiliary function.
+	bool StartListing();
+
+	// Open *.kmc_hash for listing mode, or open (map) it for random access mode. Auxiliary function.
+	bool OpenHashFile(const std::string& file_name, open_mode _open_mode);
+
+	// Build hash_index from *.kmc_hash (random access mode). Auxiliary function.
+	bool BuildHashIndex();
+
+	// Get the hash of the k-mer of given number, k-mers must be requested in increasing order (listing mode). Auxiliary function.
+	bool GetHashForListing(uint64 kmer_number, uint64& hash);
+
+	// Return counter of the k-mer of given number (random access mode). Auxiliary function.
+	uint64 GetCounterForRA(uint64 kmer_number);
+
 	// Implementation of GetCountersForRead for kmc1 database format for both strands
 	bool GetCountersForRead_kmc1_both_strands(const std::string& read, std::vector<uint32>& counters);
 
@@ -170,9 +256,21 @@ public:
 	// Open files *.kmc_pre & *.kmc_suf, read them to RAM, close files. *.kmc_suf is opened for random access
 	bool OpenForRA(const std::string &file_name);
 
+	// Map files *.kmc_pre & *.kmc_suf into memory (shared among processes), if populate is true the files are read at opening
+	// Falls back to OpenForRA for KMC1 databases and if mapping is not possible
+	bool OpenForRAMapped(const std::string &file_name, bool populate = false);
+
 	// Open files *kmc_pre & *.kmc_suf, read *.kmc_pre to RAM, *.kmc_suf is buffered
 	bool OpenForListing(const std::string& file_name);
 
+	// Open only a part of the database for listing (see GetListingRanges). Each thread may open its own range,
+	// ReadNextKmer, ReadNextKmers and RestartListing work within the range, Info and KmerCount describe the whole database
+	bool OpenForListing(const std::string& file_name, const CKMCFileRange& range);
+
+	// Split the opened database into at most n_ranges nonempty ranges of whole LUT prefixes with similar numbers of k-mers.
+	// K-mers of consecutive ranges follow each other in the order of listing
+	bool GetListingRanges(uint32 n_ranges, std::vector<CKMCFileRange>& ranges);
+
 	// Return true if kmc is in KMC2 compatiblie format
 	bool IsKMC2() const noexcept { return kmc_version == 0x200; }
 
@@ -180,6 +278,22 @@ public:
 	bool ReadNextKmer(CKmerAPI &kmer, uint64 &count); //for small k-values when counter may be longer than 4bytes
 	
 	bool ReadNextKmer(CKmerAPI &kmer, uint32 &count);
+
+	// Return next kmer, its counter and its hash stored in *.kmc_hash. Return false if EOF, the database has no hashes or *.kmc_hash cannot be read
+	bool ReadNextKmer(CKmerAPI &kmer, uint64 &count, uint64 &hash);
+
+	// Read up to max_kmers next k-mers at once (listing mode). Each k-mer takes (kmer_length + 31) / 32 words of kmers,
+	// packed 2 bits per symbol as in CKmerAPI::to_long. counts (saturated to 32 bits) and hashes may be nullptr,
+	// hashes are available only if HasHashes(). Return the number of k-mers read (0 if EOF)
+	uint64 ReadNextKmers(uint64* kmers, uint32* counts, uint64* hashes, uint64 max_kmers);
+
+	// Return true if the database has hashes of k-mers (kmc was run with -hash switch)
+	bool HasHashes() const noexcept { return with_hashes; }
+
+	// Seed of MurmurHash3 and max_hash (FracMinHash threshold) used when the database was created, valid only if HasHashes()
+	uint32 GetHashSeed() const noexcept { return hash_seed; }
+	uint64 GetMaxHash() const noexcept { return max_hash; }
+
 	// Release memory and close files in case they were opened 
 	bool Close();
 
@@ -215,6 +329,13 @@ public:
 
 	bool CheckKmer(CKmerAPI &kmer, uint64 &count);
 
+	// Check many k-mers at once, counters[i] is the counter of kmers[i] (0 if kmer does not exist).
+	// Binary searches of consecutive k-mers are interleaved with prefetching
+	bool CheckKmers(const std::vector<CKmerAPI>& kmers, std::vector<uint64>& counters);
+
+	// Return true if k-mer of given hash exists (only for databases with hashes). In this case return its counter in count
+	bool CheckHash(uint64 hash, uint64 &count);
+
 	// Return true if kmer exists
 	bool IsKmer(CKmerAPI &kmer);
 
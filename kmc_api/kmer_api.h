@@ -412,7 +412,7 @@ public:
 	// IN	: pos - a position of a symbol
 	// RET	: symbol - a symbol placed on a position pos
 	//-----------------------------------------------------------------------
-	inline uchar get_num_symbol(unsigned int pos)
+	inline uchar get_num_symbol(unsigned int pos) const
 	{
 		if (pos >= kmer_length)
 			return 0;
@@ -651,7 +651,7 @@ public:
 // IN	: sig_len	- the length of a signature
 // RET	: signature value
 //-----------------------------------------------------------------------
-	 uint32 get_signature(uint32 sig_len)
+	 uint32 get_signature(uint32 sig_len) const
 	 {
 		 uchar symb;
 		 CMmer cur_mmr(sig_len);
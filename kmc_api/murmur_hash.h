@@ -0,0 +1,138 @@
+/*
+  This file is a part of KMC software distributed under GNU GPL 3 licence.
+  The homepage of the KMC project is http://sun.aei.polsl.pl/kmc
+
+  Authors: Sebastian Deorowicz, Agnieszka Debudaj-Grabysz, Marek Kokot
+
+  Version: 3.2.2
+  Date   : 2023-03-10
+*/
+
+#ifndef _MURMUR_HASH_H
+#define _MURMUR_HASH_H
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+
+// MurmurHash3_x64_128 (public domain, Austin Appleby) - the hash function of sourmash FracMinHash sketches.
+// k-mer (as ACGT string) is kept in sketch if the first 64 bits of its hash are below max_hash.
+
+namespace murmur
+{
+
+// key may be not aligned to 8 bytes
+inline uint64_t getblock64 ( const uint8_t * p, int i )
+{
+  uint64_t r;
+  memcpy(&r, p + i * 8, sizeof(r));
+  return r;
+}
+
+inline uint64_t rotl64 ( uint64_t x, int8_t r )
+{
+  return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t fmix64 ( uint64_t k )
+{
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdull;
+  k ^= k >> 33;
+  k *= 0xc4ceb9fe1a85ec53ull;
+  k ^= k >> 33;
+
+  return k;
+}
+
+inline void MurmurHash3_x64_128 ( const void * key, const int len,
+                           const uint32_t seed, void * out )
+{
+  const uint8_t * data = (const uint8_t*)key;
+  const int nblocks = len / 16;
+
+  uint64_t h1 = seed;
+  uint64_t h2 = seed;
+
+  const uint64_t c1 = 0x87c37b91114253d5ull;
+  const uint64_t c2 = 0x4cf5ad432745937full;
+
+  //----------
+  // body
+
+  const uint8_t * blocks = data;
+
+  for(int i = 0; i < nblocks; i++)
+  {
+    uint64_t k1 = getblock64(blocks,i*2+0);
+    uint64_t k2 = getblock64(blocks,i*2+1);
+
+    k1 *= c1; k1  = rotl64(k1,31); k1 *= c2; h1 ^= k1;
+
+    h1 = rotl64(h1,27); h1 += h2; h1 = h1*5+0x52dce729;
+
+    k2 *= c2; k2  = rotl64(k2,33); k2 *= c1; h2 ^= k2;
+
+    h2 = rotl64(h2,31); h2 += h1; h2 = h2*5+0x38495ab5;
+  }
+
+  //----------
+  // tail
+
+  const uint8_t * tail = (const uint8_t*)(data + nblocks*16);
+
+  uint64_t k1 = 0;
+  uint64_t k2 = 0;
+
+  switch(len & 15)
+  {
+  case 15: k2 ^= ((uint64_t)tail[14]) << 48;
+  case 14: k2 ^= ((uint64_t)tail[13]) << 40;
+  case 13: k2 ^= ((uint64_t)tail[12]) << 32;
+  case 12: k2 ^= ((uint64_t)tail[11]) << 24;
+  case 11: k2 ^= ((uint64_t)tail[10]) << 16;
+  case 10: k2 ^= ((uint64_t)tail[ 9]) << 8;
+  case  9: k2 ^= ((uint64_t)tail[ 8]) << 0;
+           k2 *= c2; k2  = rotl64(k2,33); k2 *= c1; h2 ^= k2;
+
+  case  8: k1 ^= ((uint64_t)tail[ 7]) << 56;
+  case  7: k1 ^= ((uint64_t)tail[ 6]) << 48;
+  case  6: k1 ^= ((uint64_t)tail[ 5]) << 40;
+  case  5: k1 ^= ((uint64_t)tail[ 4]) << 32;
+  case  4: k1 ^= ((uint64_t)tail[ 3]) << 24;
+  case  3: k1 ^= ((uint64_t)tail[ 2]) << 16;
+  case  2: k1 ^= ((uint64_t)tail[ 1]) << 8;
+  case  1: k1 ^= ((uint64_t)tail[ 0]) << 0;
+           k1 *= c1; k1  = rotl64(k1,31); k1 *= c2; h1 ^= k1;
+  };
+
+  h1 ^= len; h2 ^= len;
+
+  h1 += h2;
+  h2 += h1;
+
+  h1 = fmix64(h1);
+  h2 = fmix64(h2);
+
+  h1 += h2;
+  h2 += h1;
+
+  memcpy(out, &h1, sizeof(h1));
+  memcpy((uint8_t*)out + sizeof(h1), &h2, sizeof(h2));
+}
+
+//----------------------------------------------------------------------------------
+// max_hash of FracMinHash sketch for given scaled value (the same rounding as in sourmash),
+// scaled 0 is not valid and is treated as 1 (all hashes are kept)
+inline uint64_t fmh_max_hash(uint32_t scaled)
+{
+  if (scaled <= 1)
+    return 0xFFFFFFFFFFFFFFFFull;
+  return (uint64_t)std::round((long double)(0xFFFFFFFFFFFFFFFFull) / (long double)(scaled));
+}
+
+} // namespace murmur
+
+#endif
+
+// ***** EOF
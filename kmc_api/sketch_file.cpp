@@ -0,0 +1,597 @@
+/*
+  This file is a part of KMC software distributed under GNU GPL 3 licence.
+  The homepage of the KMC project is http://sun.aei.polsl.pl/kmc
+
+  Authors: Sebastian Deorowicz, Agnieszka Debudaj-Grabysz, Marek Kokot
+
+  Version: 3.2.2
+  Date   : 2023-03-10
+*/
+
+#include "sketch_file.h"
+#include <cstring>
+#include <cctype>
+#include <cinttypes>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	const char* molecules[] = { "dna", "protein", "dayhoff", "hp" };
+	const uint32 n_molecules = sizeof(molecules) / sizeof(molecules[0]);
+
+	uint64 align_up(uint64 x)
+	{
+		return (x + SKETCH_ALIGNMENT - 1) / SKETCH_ALIGNMENT * SKETCH_ALIGNMENT;
+	}
+
+	uint64 abundances_offset(uint64 n_hashes)
+	{
+		return align_up(SKETCH_HEADER_SIZE + n_hashes * sizeof(uint64));
+	}
+
+	uint64 filename_offset(uint64 n_hashes, bool with_abundances)
+	{
+		if (with_abundances)
+			return align_up(abundances_offset(n_hashes) + n_hashes * sizeof(uint64));
+		return abundances_offset(n_hashes);
+	}
+
+	// Position just after `"key":` (and following spaces) or std::string::npos
+	size_t json_value_pos(const std::string& text, const std::string& key, size_t from)
+	{
+		size_t pos = text.find("\"" + key + "\"", from);
+		if (pos == std::string::npos)
+			return pos;
+		pos = text.find(':', pos + key.size() + 2);
+		if (pos == std::string::npos)
+			return pos;
+		pos = text.find_first_not_of(" \t\r\n", pos + 1);
+		return pos;
+	}
+
+	bool json_uint(const std::string& text, const std::string& key, size_t from, uint64& value)
+	{
+		size_t pos = json_value_pos(text, key, from);
+		if (pos == std::string::npos)
+			return false;
+		char* end;
+		value = strtoull(text.c_str() + pos, &end, 10);
+		return end != text.c_str() + pos;
+	}
+
+	// Escape sequences: \" \\ \/ \b \f \n \r \t and \u00XX (other code points are replaced by ?)
+	bool json_string(const std::string& text, const std::string& key, size_t from, std::string& value)
+	{
+		size_t pos = json_value_pos(text, key, from);
+		if (pos == std::string::npos || text[pos] != '"')
+			return false;
+		value.clear();
+		for (size_t i = pos + 1; i < text.size(); ++i)
+		{
+			char c = text[i];
+			if (c == '"')
+				return true;
+			if (c != '\\')
+			{
+				value.push_back(c);
+				continue;
+			}
+			if (++i == text.size())
+				return false;
+			switch (text[i])
+			{
+			case 'b': value.push_back('\b'); break;
+			case 'f': value.push_back('\f'); break;
+			case 'n': value.push_back('\n'); break;
+			case 'r': value.push_back('\r'); break;
+			case 't': value.push_back('\t'); break;
+			case 'u':
+			{
+				if (i + 4 >= text.size())
+					return false;
+				unsigned long code = strtoul(text.substr(i + 1, 4).c_str(), nullptr, 16);
+				value.push_back(code < 0x100 ? (char)code : '?');
+				i += 4;
+				break;
+			}
+			default: value.push_back(text[i]);
+			}
+		}
+		return false;
+	}
+
+	// String as JSON string literal (with quotes), readable by json_string
+	std::string json_quoted(const std::string& str)
+	{
+		std::string res = "\"";
+		for (char c : str)
+		{
+			if (c == '"' || c == '\\')
+			{
+				res.push_back('\\');
+				res.push_back(c);
+			}
+			else if ((uchar)c < 0x20)
+			{
+				char code[8];
+				snprintf(code, sizeof(code), "\\u%04x", (unsigned)(uchar)c);
+				res += code;
+			}
+			else
+				res.push_back(c);
+		}
+		res.push_back('"');
+		return res;
+	}
+
+	bool json_uint_array(const std::string& text, const std::string& key, size_t from, std::vector<uint64>& values)
+	{
+		size_t pos = json_value_pos(text, key, from);
+		if (pos == std::string::npos || text[pos] != '[')
+			return false;
+		const char* p = text.c_str() + pos + 1;
+		while (true)
+		{
+			while (*p == ' ' || *p == ',' || *p == '\t' || *p == '\r' || *p == '\n')
+				++p;
+			if (*p == ']')
+				return true;
+			char* end;
+			uint64 value = strtoull(p, &end, 10);
+			if (end == p)
+				return false;
+			values.push_back(value);
+			p = end;
+		}
+	}
+
+	// Write zeros to move file position to pos
+	bool pad_to(FILE* file, uint64 cur, uint64 pos)
+	{
+		static const uchar zeros[SKETCH_ALIGNMENT] = {};
+		return cur == pos || fwrite(zeros, 1, pos - cur, file) == pos - cur;
+	}
+
+	// Index of molecule in header of binary sketch, n_molecules if unknown
+	uint32 molecule_id(const std::string& molecule)
+	{
+		uint32 id = 0;
+		while (id < n_molecules && molecule != molecules[id])
+			++id;
+		return id;
+	}
+
+	bool write_header(FILE* file, const CSketchInfo& info, uint32 molecule, bool with_abundances)
+	{
+		uint32 version = SKETCH_VERSION;
+		uint32 flags = with_abundances ? SKETCH_FLAG_ABUNDANCES : 0;
+		uint32 filename_len = (uint32)info.filename.size();
+
+		uchar header[SKETCH_HEADER_SIZE] = {};
+		memcpy(header, SKETCH_MAGIC, 4);
+		memcpy(header + 4, &version, 4);
+		memcpy(header + 8, &info.ksize, 4);
+		memcpy(header + 12, &info.seed, 4);
+		memcpy(header + 16, &info.max_hash, 8);
+		memcpy(header + 24, &molecule, 4);
+		memcpy(header + 28, &flags, 4);
+		memcpy(header + 32, &info.n_hashes, 8);
+		memcpy(header + 40, &filename_len, 4);
+		return fwrite(header, 1, SKETCH_HEADER_SIZE, file) == SKETCH_HEADER_SIZE;
+	}
+
+	void write_json_prefix(FILE* file, const CSketchInfo& info)
+	{
+		fprintf(file, "[{\"class\":\"frac_kmc_signature\",\"email\":\"\",\"hash_function\":%s", json_quoted(info.hash_function).c_str());
+		fprintf(file, ",\"filename\":%s", json_quoted(info.filename).c_str());
+		fprintf(file, ",\"license\":\"CC0\"");
+		fprintf(file, ",\"signatures\":[{\"num\":0,\"ksize\":%" PRIu32 ",\"seed\":%" PRIu32 ",\"max_hash\":%" PRIu64, info.ksize, info.seed, info.max_hash);
+	}
+
+	void write_json_suffix(FILE* file, const CSketchInfo& info)
+	{
+		fprintf(file, "], \"molecule\":%s, \"md5sum\":\"abcd\"}], \"version\":0.1}]\n", json_quoted(info.molecule).c_str());
+	}
+}
+
+//----------------------------------------------------------------------------------
+CSketchFile::~CSketchFile()
+{
+	Close();
+}
+
+//----------------------------------------------------------------------------------
+void CSketchFile::Close()
+{
+#ifndef _WIN32
+	if (mapped)
+		munmap(mapped, mapped_size);
+#endif
+	mapped = nullptr;
+	mapped_size = 0;
+	own_hashes.clear();
+	own_hashes.shrink_to_fit();
+	own_abundances.clear();
+	own_abundances.shrink_to_fit();
+	hashes = abundances = nullptr;
+	info = CSketchInfo{};
+	binary = false;
+}
+
+//----------------------------------------------------------------------------------
+bool CSketchFile::Open(const std::string& file_name)
+{
+	Close();
+	if (OpenBinary(file_name))
+	{
+		binary = true;
+		return true;
+	}
+	Close();
+	return OpenJson(file_name);
+}
+
+//----------------------------------------------------------------------------------
+// Load the first signature of sourmash JSON file
+bool CSketchFile::OpenJson(const std::string& file_name)
+{
+	std::ifstream in(file_name, std::ios::binary);
+	if (!in)
+		return false;
+	std::stringstream buf;
+	buf << in.rdbuf();
+	std::string text = buf.str();
+
+	size_t sig_pos = json_value_pos(text, "signatures", 0);
+	if (sig_pos == std::string::npos)
+		return false;
+
+	uint64 ksize, seed;
+	if (!json_uint(text, "ksize", sig_pos, ksize) || !json_uint(text, "seed", sig_pos, seed) ||
+		!json_uint(text, "max_hash", sig_pos, info.max_hash) || !json_uint_array(text, "mins", sig_pos, own_hashes))
+	{
+		Close();
+		return false;
+	}
+	info.ksize = (uint32)ksize;
+	info.seed = (uint32)seed;
+	json_string(text, "molecule", sig_pos, info.molecule);
+	// sourmash writes e.g. "DNA" and lowercases it on read
+	std::transform(info.molecule.begin(), info.molecule.end(), info.molecule.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+
+	size_t hash_function_pos = text.rfind("\"hash_function\"", sig_pos);
+	if (hash_function_pos != std::string::npos)
+		json_string(text, "hash_function", hash_function_pos, info.hash_function);
+
+	// top level filename is stored before signatures
+	size_t filename_pos = text.rfind("\"filename\"", sig_pos);
+	if (filename_pos != std::string::npos)
+		json_string(text, "filename", filename_pos, info.filename);
+
+	// abundances are optional, but belong to the same signature only if they appear before the next one
+	size_t next_sig = text.find("\"ksize\"", json_value_pos(text, "ksize", sig_pos));
+	size_t abund_pos = text.find("\"abundances\"", sig_pos);
+	if (abund_pos != std::string::npos && abund_pos < next_sig)
+	{
+		if (!json_uint_array(text, "abundances", sig_pos, own_abundances) || own_abundances.size() != own_hashes.size())
+		{
+			Close();
+			return false;
+		}
+		info.with_abundances = true;
+	}
+
+	if (!std::is_sorted(own_hashes.begin(), own_hashes.end()))
+	{
+		std::vector<std::pair<uint64, uint64>> tmp(own_hashes.size());
+		for (size_t i = 0; i < own_hashes.size(); ++i)
+			tmp[i] = std::make_pair(own_hashes[i], info.with_abundances ? own_abundances[i] : 0);
+		std::sort(tmp.begin(), tmp.end());
+		for (size_t i = 0; i < tmp.size(); ++i)
+		{
+			own_hashes[i] = tmp[i].first;
+			if (info.with_abundances)
+				own_abundances[i] = tmp[i].second;
+		}
+	}
+
+	info.n_hashes = own_hashes.size();
+	hashes = own_hashes.data();
+	abundances = info.with_abundances ? own_abundances.data() : nullptr;
+	return true;
+}
+
+//----------------------------------------------------------------------------------
+uint64 CSketchFile::CountBelow(uint64 max_hash) const
+{
+	return std::lower_bound(hashes, hashes + info.n_hashes, max_hash) - hashes;
+}
+
+//----------------------------------------------------------------------------------
+// Map (or read if mapping is not possible) a sketch in binary format
+bool CSketchFile::OpenBinary(const std::string& file_name)
+{
+	FILE* file = my_fopen(file_name.c_str(), "rb");
+	if (!file)
+		return false;
+
+	uchar header[SKETCH_HEADER_SIZE];
+	if (fread(header, 1, SKETCH_HEADER_SIZE, file) != SKETCH_HEADER_SIZE || memcmp(header, SKETCH_MAGIC, 4) != 0)
+	{
+		fclose(file);
+		return false;
+	}
+
+	uint32 version, molecule, flags, filename_len;
+	memcpy(&version, header + 4, 4);
+	memcpy(&info.ksize, header + 8, 4);
+	memcpy(&info.seed, header + 12, 4);
+	memcpy(&info.max_hash, header + 16, 8);
+	memcpy(&molecule, header + 24, 4);
+	memcpy(&flags, header + 28, 4);
+	memcpy(&info.n_hashes, header + 32, 8);
+	memcpy(&filename_len, header + 40, 4);
+
+	my_fseek(file, 0, SEEK_END);
+	uint64 file_size = my_ftell(file);
+
+	info.with_abundances = (flags & SKETCH_FLAG_ABUNDANCES) != 0;
+	uint64 name_pos = filename_offset(info.n_hashes, info.with_abundances);
+	if (version != SKETCH_VERSION || molecule >= n_molecules || name_pos + filename_len != file_size)
+	{
+		fclose(file);
+		info = CSketchInfo{};
+		return false;
+	}
+	info.molecule = molecules[molecule];
+	info.filename.resize(filename_len);
+	my_fseek(file, name_pos, SEEK_SET);
+	if (filename_len && fread(&info.filename[0], 1, filename_len, file) != filename_len)
+	{
+		fclose(file);
+		info = CSketchInfo{};
+		return false;
+	}
+
+#ifndef _WIN32
+	void* ptr = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+	if (ptr != MAP_FAILED)
+	{
+		fclose(file);
+		mapped = ptr;
+		mapped_size = file_size;
+		hashes = (const uint64*)((const uchar*)mapped + SKETCH_HEADER_SIZE);
+		if (info.with_abundances)
+			abundances = (const uint64*)((const uchar*)mapped + abundances_offset(info.n_hashes));
+		return true;
+	}
+#endif
+
+	own_hashes.resize(info.n_hashes);
+	my_fseek(file, SKETCH_HEADER_SIZE, SEEK_SET);
+	bool ok = fread(own_hashes.data(), sizeof(uint64), info.n_hashes, file) == info.n_hashes;
+	if (ok && info.with_abundances)
+	{
+		own_abundances.resize(info.n_hashes);
+		my_fseek(file, abundances_offset(info.n_hashes), SEEK_SET);
+		ok = fread(own_abundances.data(), sizeof(uint64), info.n_hashes, file) == info.n_hashes;
+	}
+	fclose(file);
+	if (!ok)
+	{
+		Close();
+		return false;
+	}
+	hashes = own_hashes.data();
+	abundances = info.with_abundances ? own_abundances.data() : nullptr;
+	return true;
+}
+
+//----------------------------------------------------------------------------------
+bool CSketchFile::Save(const std::string& file_name, const CSketchInfo& info, const uint64* hashes, const uint64* abundances)
+{
+	uint32 molecule = molecule_id(info.molecule);
+	if (molecule == n_molecules)
+		return false;
+
+	FILE* file = my_fopen(file_name.c_str(), "wb");
+	if (!file)
+		return false;
+
+	uint64 n_hashes = info.n_hashes;
+	uint32 filename_len = (uint32)info.filename.size();
+
+	bool ok = write_header(file, info, molecule, abundances != nullptr);
+	ok = ok && fwrite(hashes, sizeof(uint64), n_hashes, file) == n_hashes;
+	ok = ok && pad_to(file, SKETCH_HEADER_SIZE + n_hashes * sizeof(uint64), abundances_offset(n_hashes));
+	if (abundances)
+	{
+		ok = ok && fwrite(abundances, sizeof(uint64), n_hashes, file) == n_hashes;
+		ok = ok && pad_to(file, abundances_offset(n_hashes) + n_hashes * sizeof(uint64), filename_offset(n_hashes, true));
+	}
+	ok = ok && fwrite(info.filename.data(), 1, filename_len, file) == filename_len;
+
+	return fclose(file) == 0 && ok;
+}
+
+//----------------------------------------------------------------------------------
+bool CSketchFile::SaveJson(const std::string& file_name, const CSketchInfo& info, const uint64* hashes, const uint64* abundances)
+{
+	FILE* file = my_fopen(file_name.c_str(), "wb");
+	if (!file)
+		return false;
+	setvbuf(file, NULL, _IOFBF, 1 << 24);
+
+	write_json_prefix(file, info);
+
+	fprintf(file, ",\"mins\":[");
+	for (uint64 i = 0; i < info.n_hashes; ++i)
+		fprintf(file, i ? ",%" PRIu64 : "%" PRIu64, hashes[i]);
+
+	if (abundances)
+	{
+		fprintf(file, "],\"abundances\":[");
+		for (uint64 i = 0; i < info.n_hashes; ++i)
+			fprintf(file, i ? ",%" PRIu64 : "%" PRIu64, abundances[i]);
+	}
+
+	write_json_suffix(file, info);
+
+	return fclose(file) == 0;
+}
+
+//----------------------------------------------------------------------------------
+CSketchWriter::~CSketchWriter()
+{
+	if (file)
+		fclose(file);
+	if (tmp)
+		fclose(tmp);
+}
+
+//----------------------------------------------------------------------------------
+bool CSketchWriter::Open(const std::string& file_name, const CSketchInfo& _info, bool _binary)
+{
+	info = _info;
+	info.n_hashes = 0;
+	binary = _binary;
+	ok = true;
+	molecule = molecule_id(info.molecule);
+	if (binary && molecule == n_molecules)
+		return false;
+
+	file = my_fopen(file_name.c_str(), "wb");
+	if (!file)
+		return false;
+	setvbuf(file, NULL, _IOFBF, 1 << 24);
+	if (info.with_abundances && !(tmp = tmpfile()))
+		return false;
+
+	if (binary)
+		ok = write_header(file, info, molecule, info.with_abundances);	// n_hashes is updated at Close
+	else
+	{
+		write_json_prefix(file, info);
+		fprintf(file, ",\"mins\":[");
+	}
+	return ok;
+}
+
+//----------------------------------------------------------------------------------
+void CSketchWriter::Add(uint64 hash, uint64 abundance)
+{
+	if (binary)
+	{
+		ok = ok && fwrite(&hash, sizeof(uint64), 1, file) == 1;
+		if (tmp)
+			ok = ok && fwrite(&abundance, sizeof(uint64), 1, tmp) == 1;
+	}
+	else
+	{
+		fprintf(file, info.n_hashes ? ",%" PRIu64 : "%" PRIu64, hash);
+		if (tmp)
+			fprintf(tmp, info.n_hashes ? ",%" PRIu64 : "%" PRIu64, abundance);
+	}
+	++info.n_hashes;
+}
+
+//----------------------------------------------------------------------------------
+bool CSketchWriter::Close()
+{
+	if (!file)
+		return false;
+	uint64 n_hashes = info.n_hashes;
+	if (binary)
+		ok = ok && pad_to(file, SKETCH_HEADER_SIZE + n_hashes * sizeof(uint64), abundances_offset(n_hashes));
+	else if (tmp)
+		fprintf(file, "],\"abundances\":[");
+
+	if (tmp)
+	{
+		rewind(tmp);
+		std::vector<char> buf(1 << 20);
+		size_t readed;
+		while ((readed = fread(buf.data(), 1, buf.size(), tmp)) > 0)
+			ok = ok && fwrite(buf.data(), 1, readed, file) == readed;
+		fclose(tmp);
+		tmp = nullptr;
+		if (binary)
+			ok = ok && pad_to(file, abundances_offset(n_hashes) + n_hashes * sizeof(uint64), filename_offset(n_hashes, true));
+	}
+
+	if (binary)
+	{
+		ok = ok && fwrite(info.filename.data(), 1, info.filename.size(), file) == info.filename.size();
+		ok = ok && my_fseek(file, 0, SEEK_SET) == 0 && write_header(file, info, molecule, info.with_abundances);
+	}
+	else
+		write_json_suffix(file, info);
+
+	ok = fclose(file) == 0 && ok;
+	file = nullptr;
+	return ok;
+}
+
+//----------------------------------------------------------------------------------
+uint64 sorted_intersection_size(const uint64* a, uint64 size_a, const uint64* b, uint64 size_b)
+{
+	if (size_a > size_b)
+	{
+		std::swap(a, b);
+		std::swap(size_a, size_b);
+	}
+	uint64 res = 0;
+
+	// Similar sizes: linear merge
+	if (size_a * 32 > size_b)
+	{
+		uint64 i = 0, j = 0;
+		while (i < size_a && j < size_b)
+		{
+			if (a[i] < b[j])
+				++i;
+			else if (b[j] < a[i])
+				++j;
+			else
+			{
+				++res;
+				++i;
+				++j;
+			}
+		}
+		return res;
+	}
+
+	// Small vs large: galloping search from the last found position
+	uint64 lo = 0;
+	for (uint64 i = 0; i < size_a && lo < size_b; ++i)
+	{
+		uint64 step = 1;
+		uint64 hi = lo;
+		while (hi < size_b && b[hi] < a[i])
+		{
+			lo = hi + 1;
+			hi += step;
+			step *= 2;
+		}
+		hi = MIN(hi + 1, size_b);
+		lo = std::lower_bound(b + lo, b + hi, a[i]) - b;
+		if (lo < size_b && b[lo] == a[i])
+		{
+			++res;
+			++lo;
+		}
+	}
+	return res;
+}
+
+// ***** EOF
@@ -0,0 +1,129 @@
+/*
+  This file is a part of KMC software distributed under GNU GPL 3 licence.
+  The homepage of the KMC project is http://sun.aei.polsl.pl/kmc
+
+  Authors: Sebastian Deorowicz, Agnieszka Debudaj-Grabysz, Marek Kokot
+
+  Version: 3.2.2
+  Date   : 2023-03-10
+*/
+
+#ifndef _SKETCH_FILE_H
+#define _SKETCH_FILE_H
+
+#include "kmer_defs.h"
+#include <string>
+#include <vector>
+
+// Binary sketch layout (little endian, all sections aligned to 64 bytes):
+//   [0, 64)    header: "FMHS", version, ksize, seed, max_hash, molecule, flags, n_hashes, filename length
+//   [64, ...)  n_hashes sorted uint64 hashes
+//   [...]      n_hashes uint64 abundances (only if SKETCH_FLAG_ABUNDANCES is set)
+//   [...]      filename (not zero terminated)
+#define SKETCH_MAGIC			"FMHS"
+#define SKETCH_VERSION			1
+#define SKETCH_HEADER_SIZE		64
+#define SKETCH_ALIGNMENT		64
+#define SKETCH_FLAG_ABUNDANCES	1
+
+struct CSketchInfo
+{
+	uint32 ksize = 0;
+	uint32 seed = 0;
+	uint64 max_hash = 0;
+	std::string molecule = "dna";
+	std::string hash_function = "0.murmur64";
+	std::string filename;
+	bool with_abundances = false;
+	uint64 n_hashes = 0;
+};
+
+//************************************************************************************************************
+// CSketchFile - FracMinHash sketch: sorted array of hashes and optional parallel array of abundances.
+// A binary sketch is mapped into memory as is, so the hashes are available without any parsing.
+//************************************************************************************************************
+class CSketchFile
+{
+	CSketchInfo info;
+	const uint64* hashes = nullptr;
+	const uint64* abundances = nullptr;
+
+	std::vector<uint64> own_hashes;			// used when the file could not be mapped
+	std::vector<uint64> own_abundances;
+
+	void* mapped = nullptr;
+	uint64 mapped_size = 0;
+	bool binary = false;
+
+	bool OpenBinary(const std::string& file_name);
+	bool OpenJson(const std::string& file_name);
+
+public:
+	CSketchFile() = default;
+	CSketchFile(const CSketchFile&) = delete;
+	CSketchFile& operator=(const CSketchFile&) = delete;
+	~CSketchFile();
+
+	// Open sketch file, binary or sourmash JSON (in case of JSON only the first signature is loaded)
+	bool Open(const std::string& file_name);
+
+	// Release the memory (or mapping) of the sketch
+	void Close();
+
+	const CSketchInfo& Info() const { return info; }
+
+	// true if the sketch was read from binary format, false for JSON
+	bool IsBinary() const { return binary; }
+	uint64 Size() const { return info.n_hashes; }
+	const uint64* Hashes() const { return hashes; }
+
+	// nullptr if the sketch has no abundances
+	const uint64* Abundances() const { return abundances; }
+
+	// Number of hashes below max_hash, i.e. size of the sketch downsampled to max_hash
+	uint64 CountBelow(uint64 max_hash) const;
+
+	// Store sketch in binary format, hashes must be sorted, abundances may be nullptr
+	static bool Save(const std::string& file_name, const CSketchInfo& info, const uint64* hashes, const uint64* abundances);
+
+	// Store sketch as sourmash compatible JSON, hashes must be sorted, abundances may be nullptr
+	static bool SaveJson(const std::string& file_name, const CSketchInfo& info, const uint64* hashes, const uint64* abundances);
+};
+
+//************************************************************************************************************
+// CSketchWriter - sketch stored hash by hash (in increasing order), so a sketch of any size is written with
+// constant memory. Abundances are kept in a temporary file until Close, since they follow all the hashes.
+//************************************************************************************************************
+class CSketchWriter
+{
+	CSketchInfo info;
+	bool binary = true;
+	uint32 molecule = 0;
+	FILE* file = nullptr;
+	FILE* tmp = nullptr;
+	bool ok = true;
+
+public:
+	CSketchWriter() = default;
+	CSketchWriter(const CSketchWriter&) = delete;
+	CSketchWriter& operator=(const CSketchWriter&) = delete;
+	~CSketchWriter();
+
+	// info.n_hashes is ignored, it is counted by Add
+	bool Open(const std::string& file_name, const CSketchInfo& info, bool binary);
+
+	void Add(uint64 hash, uint64 abundance = 0);
+
+	bool Close();
+
+	uint64 Size() const { return info.n_hashes; }
+};
+
+//----------------------------------------------------------------------------------
+// Number of common elements of two sorted arrays. If one array is much smaller,
+// its elements are searched in the larger one with galloping (exponential) search.
+uint64 sorted_intersection_size(const uint64* a, uint64 size_a, const uint64* b, uint64 size_b);
+
+#endif
+
+// ***** EOF
@@ -530,7 +530,9 @@ public:
 
 	void operator()()
 	{
+		CPerfThreadStats perf_stats(PerfPhase::binary_reader);
 		reader->Process();
+		perf_stats.AddBytes(reader->GetTotalSize());
 	}
 };
 
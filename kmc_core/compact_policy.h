@@ -0,0 +1,182 @@
+/*
+  This file is a part of KMC software distributed under GNU GPL 3 licence.
+  The homepage of the KMC project is http://sun.aei.polsl.pl/kmc
+
+  Authors: Sebastian Deorowicz, Agnieszka Debudaj-Grabysz, Marek Kokot
+
+  Version: 3.2.2
+  Date   : 2023-03-10
+*/
+
+#ifndef _COMPACT_POLICY_H
+#define _COMPACT_POLICY_H
+
+#include "defs.h"
+#include "params.h"
+#include "kmer.h"
+#include "critical_error_handler.h"
+#include "../kmc_api/murmur_hash.h"
+#include <cstring>
+#include <string>
+#include <sstream>
+#include <type_traits>
+#include <vector>
+
+//************************************************************************************************************
+// Policies of the loops compacting sorted k-mers of a bin (CKmerBinSorter, CKXmerMerger). A loop is a template
+// over the output (KMC, KFF or none), the FracMinHash filter (none or scaled) and the counter size in bytes.
+// The instance is chosen once per bin by dispatch_compaction, so the loop has no per k-mer branches on these
+// parameters and the stores of counters are unrolled.
+//************************************************************************************************************
+enum class CompactOutput { kmc, kff, none };
+
+//----------------------------------------------------------------------------------
+// ASCII of the 4 symbols packed in a byte of k-mer, the most significant first
+class CKmerByteDecoder
+{
+	char symbols[256][4];
+
+	CKmerByteDecoder()
+	{
+		for (uint32 b = 0; b < 256; ++b)
+			for (uint32 i = 0; i < 4; ++i)
+				symbols[b][i] = "ACGT"[(b >> (6 - 2 * i)) & 3];
+	}
+public:
+	static const CKmerByteDecoder& Inst()
+	{
+		static CKmerByteDecoder inst;
+		return inst;
+	}
+
+	const char* Symbols(uchar b) const
+	{
+		return symbols[b];
+	}
+};
+
+//----------------------------------------------------------------------------------
+// Same as kmer.get_string_representation(kmer_len), but without allocation and 4 symbols at once
+template<unsigned SIZE>
+inline void kmer_to_ascii(CKmer<SIZE>& kmer, uint32 kmer_len, char* str)
+{
+	const CKmerByteDecoder& decoder = CKmerByteDecoder::Inst();
+	uint32 n_full_bytes = kmer_len / 4;
+	uint32 rest = kmer_len % 4;
+	if (rest)
+	{
+		memcpy(str, decoder.Symbols(kmer.get_byte(n_full_bytes)) + 4 - rest, rest);
+		str += rest;
+	}
+	for (int32 j = (int32)n_full_bytes - 1; j >= 0; --j, str += 4)
+		memcpy(str, decoder.Symbols(kmer.get_byte(j)), 4);
+}
+
+//----------------------------------------------------------------------------------
+// FracMinHash of k-mer: MurmurHash3 of its ASCII representation
+template<unsigned SIZE>
+inline uint64 kmer_hash(CKmer<SIZE>& kmer, uint32 kmer_len, uint32 seed)
+{
+	char str[MAX_K];
+	kmer_to_ascii(kmer, kmer_len, str);
+	uint64_t hash_values[2] = { 0 };
+	murmur::MurmurHash3_x64_128(str, kmer_len, seed, hash_values);
+	return hash_values[0];
+}
+
+//----------------------------------------------------------------------------------
+// With scaled == 1 (threshold is 2^64-1) all k-mers are kept and hashing is skipped (hash is not set).
+// There is no cheaper function that could reject k-mers for sure before MurmurHash3 of the ASCII k-mer,
+// so the loops call this only for k-mers that passed the cheap checks (distinct, count >= cutoff_min).
+template<bool SCALED, unsigned SIZE>
+inline bool fmh_admissible(CKmer<SIZE>& kmer, uint32 kmer_len, uint32 seed, uint64 threshold, uint64& hash)
+{
+	if (!SCALED)
+		return true;
+	hash = kmer_hash(kmer, kmer_len, seed);
+	return hash < threshold;
+}
+
+//----------------------------------------------------------------------------------
+// Hashes of stored k-mers (for .kmc_hash file) are collected by the loops in the order of records,
+// the hash computed by the filter is reused
+template<CompactOutput OUTPUT, bool SCALED, unsigned SIZE>
+inline void store_kmer_hash(std::vector<uint64>* hashes, CKmer<SIZE>& kmer, uint32 kmer_len, uint32 seed, uint64 hash)
+{
+	if (OUTPUT != CompactOutput::kmc || !hashes)
+		return;
+	hashes->push_back(SCALED ? hash : kmer_hash(kmer, kmer_len, seed));
+}
+
+//----------------------------------------------------------------------------------
+// Store kmer_bytes lowest bytes of k-mer (most significant first) and its counter: little endian in KMC,
+// big endian in KFF, nothing without output
+template<CompactOutput OUTPUT, uint32 COUNTER_SIZE, unsigned SIZE>
+inline void store_compacted_kmer(uchar* out_buffer, uint64& out_pos, CKmer<SIZE>& kmer, uint32 kmer_bytes, uint32 count)
+{
+	if (OUTPUT == CompactOutput::none)
+		return;
+	for (int32 j = (int32)kmer_bytes - 1; j >= 0; --j)
+		out_buffer[out_pos++] = kmer.get_byte(j);
+	if (OUTPUT == CompactOutput::kmc)
+		for (uint32 j = 0; j < COUNTER_SIZE; ++j)
+			out_buffer[out_pos++] = (count >> (j * 8)) & 0xFF;
+	else
+		for (int32 j = (int32)COUNTER_SIZE - 1; j >= 0; --j)
+			out_buffer[out_pos++] = (count >> (j * 8)) & 0xFF;
+}
+
+//----------------------------------------------------------------------------------
+template<CompactOutput OUTPUT, bool SCALED, typename FUN>
+void dispatch_compaction_counter(uint32 counter_size, FUN& fun)
+{
+	using output_t = std::integral_constant<CompactOutput, OUTPUT>;
+	using scaled_t = std::integral_constant<bool, SCALED>;
+	switch (counter_size)
+	{
+	case 0: fun(output_t(), scaled_t(), std::integral_constant<uint32, 0>()); break;
+	case 1: fun(output_t(), scaled_t(), std::integral_constant<uint32, 1>()); break;
+	case 2: fun(output_t(), scaled_t(), std::integral_constant<uint32, 2>()); break;
+	case 3: fun(output_t(), scaled_t(), std::integral_constant<uint32, 3>()); break;
+	default: fun(output_t(), scaled_t(), std::integral_constant<uint32, 4>()); break;
+	}
+}
+
+//----------------------------------------------------------------------------------
+// Call fun(output, scaled, counter_size) with std::integral_constant arguments matching the parameters of the bin
+template<typename FUN>
+void dispatch_compaction(bool without_output, OutputType output_type, bool scaled, uint32 counter_size, FUN&& fun)
+{
+	if (without_output)
+	{
+		// counter_size is not used without output
+		if (scaled)
+			fun(std::integral_constant<CompactOutput, CompactOutput::none>(), std::true_type(), std::integral_constant<uint32, 0>());
+		else
+			fun(std::integral_constant<CompactOutput, CompactOutput::none>(), std::false_type(), std::integral_constant<uint32, 0>());
+	}
+	else if (output_type == OutputType::KMC)
+	{
+		if (scaled)
+			dispatch_compaction_counter<CompactOutput::kmc, true>(counter_size, fun);
+		else
+			dispatch_compaction_counter<CompactOutput::kmc, false>(counter_size, fun);
+	}
+	else if (output_type == OutputType::KFF)
+	{
+		if (scaled)
+			dispatch_compaction_counter<CompactOutput::kff, true>(counter_size, fun);
+		else
+			dispatch_compaction_counter<CompactOutput::kff, false>(counter_size, fun);
+	}
+	else
+	{
+		std::ostringstream ostr;
+		ostr << "Error: not implemented, plase contact authors showing this message" << __FILE__ << "\t" << __LINE__;
+		CCriticalErrorHandler::Inst().HandleCriticalError(ostr.str());
+	}
+}
+
+#endif
+
+// ***** EOF
@@ -59,7 +59,17 @@ void save_bins_stats(CKMCQueues& Queues, CKMCParams& Params, uint32 kmer_size, u
 		CCriticalErrorHandler::Inst().HandleCriticalError(ostr.str());
 	}
 	using ull = unsigned long long;
-	fprintf(stats_file, "%s;%s;%s;%s;%s;%s\n", "bin_id", "n_rec", "n_super_kmers", "size", "2nd stage MEM", "n_singatures");
+
+	// Predicted load of bins comes from the stats sample, so scale it to the real number of 2nd stage records (k-mers or (k+x)-mers)
+	uint64 sum_predicted = 0;
+	for (int32 i = 0; i < Params.n_bins; ++i)
+		sum_predicted += Queues.s_mapper->GetPredictedBinLoad(i);
+	uint64 sum_actual = Params.max_x ? Queues.bd->get_n_plus_x_recs_sum() : Queues.bd->get_n_rec_sum();
+	double predicted_scale = sum_predicted ? (double)sum_actual / sum_predicted : 0.0;
+	uint64 max_n_rec = 0;
+	uint32 n_nonempty_bins = 0;
+
+	fprintf(stats_file, "%s;%s;%s;%s;%s;%s;%s\n", "bin_id", "n_rec", "n_super_kmers", "size", "2nd stage MEM", "n_singatures", "predicted_n_2nd_stage_recs");
 	while ((bin_id = Queues.bd->get_next_sort_bin()) >= 0)
 	{
 		Queues.bd->read(bin_id, file, name, size, n_rec, n_plus_x_recs, n_super_kmers);
@@ -126,7 +136,13 @@ void save_bins_stats(CKMCQueues& Queues, CKMCParams& Params, uint32 kmer_size, u
 				++n_signatures;
 		}
 
-		fprintf(stats_file, "%i;%llu;%llu;%llu;%llu;%llu\n", bin_id, (ull)n_rec, (ull)n_super_kmers, (ull)size, (ull)req_size, (ull)n_signatures);
+		uint64 predicted_n_rec = (uint64)(Queues.s_mapper->GetPredictedBinLoad(bin_id) * predicted_scale);
+		if (n_rec > max_n_rec)
+			max_n_rec = n_rec;
+		if (n_rec)
+			++n_nonempty_bins;
+
+		fprintf(stats_file, "%i;%llu;%llu;%llu;%llu;%llu;%llu\n", bin_id, (ull)n_rec, (ull)n_super_kmers, (ull)size, (ull)req_size, (ull)n_signatures, (ull)predicted_n_rec);
 		sum_size += size;
 		sum_n_rec += n_rec;
 		sum_n_plus_x_recs += n_plus_x_recs;
@@ -135,6 +151,8 @@ void save_bins_stats(CKMCQueues& Queues, CKMCParams& Params, uint32 kmer_size, u
 
 	fprintf(stats_file, "%s;%llu;%llu;%llu\n", "SUMMARY", (ull)sum_n_rec, (ull)sum_n_super_kmers, (ull)sum_size);
 	fprintf(stats_file, "n_reads: %llu\n", (ull)n_reads);
+	if (n_nonempty_bins)
+		fprintf(stats_file, "max_n_rec / mean_n_rec (non-empty bins): %.3f\n", (double)max_n_rec * n_nonempty_bins / sum_n_rec);
 
 	fclose(stats_file);
 
@@ -1197,6 +1197,7 @@ void CWFastqReader::operator()()
 {
 	uchar *part;
 	uint64 part_filled;
+	CPerfThreadStats perf_stats(PerfPhase::fastq_reader);
 
 	CFastqReader fqr(pmm_fastq, file_type, kmer_len, binary_pack_queue, pmm_binary_file_reader, bam_task_manager, part_queue, nullptr, missingEOL_at_EOF_counter);
 	fqr.SetPartSize(part_size);
@@ -1208,8 +1209,16 @@ void CWFastqReader::operator()()
 	{
 		fqr.Init();
 		ReadType read_type;
-		while (fqr.GetPartNew(part, part_filled, read_type))
+		while (true)
+		{
+			CPerfTraceScope trace_part("read part");
+			if (!fqr.GetPartNew(part, part_filled, read_type))
+				break;
+			trace_part.SetArg("bytes", part_filled);
+			perf_stats.AddBytes(part_filled);
+			perf_stats.AddRecords(1);
 			part_queue->push(part, part_filled, read_type);
+		}
 	}
 	part_queue->mark_completed();
 }
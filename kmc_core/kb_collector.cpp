@@ -73,20 +73,7 @@ void CKmerBinCollector::PutExtendedKmer(char* seq, uint32 n)
 	++n_super_kmers;
 	n_recs += n - kmer_len + 1;
 	if (max_x) ///for max_x = 0 k-mers (not k+x-mers) will be sorted
-	{
-		if (!both_strands)
-			n_plus_x_recs += 1 + (n - kmer_len) / (max_x + 1);
-		else
-		{
-			switch (max_x)
-			{
-			case 1: update_n_plus_x_recs<2>(seq, n); break;
-			case 2: update_n_plus_x_recs<3>(seq, n); break;
-			case 3: update_n_plus_x_recs<4>(seq, n); break;
-			}
-
-		}
-	}
+		n_plus_x_recs += count_2nd_stage_recs(seq, n, kmer_len, max_x, both_strands);
 }
 
 //---------------------------------------------------------------------------------
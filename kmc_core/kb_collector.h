@@ -33,7 +33,6 @@ class CKmerBinCollector
 	uint64 prev_n_plus_x_recs = 0;
 	uint64 prev_pos = 0;
 
-	enum comparision_state  { kmer_smaller, rev_smaller, equals };
 	uint32 bin_no;
 	CBinPartQueue *bin_part_queue;
 	CBinDesc *bd;
@@ -54,8 +53,6 @@ class CKmerBinCollector
 	uint32 kmer_bytes;
 	bool both_strands;
 
-	template<unsigned DIVIDE_FACTOR> void update_n_plus_x_recs(char* seq, uint32 n);
-
 public:
 	CKmerBinCollector(CKMCQueues& Queues, CKMCParams& Params, uint32 _buffer_size, uint32 _bin_no);
 	void PutExtendedKmer(char* seq, uint32 n);	
@@ -63,12 +60,15 @@ public:
 };
 
 //---------------------------------------------------------------------------------
-template<unsigned DIVIDE_FACTOR> void CKmerBinCollector::update_n_plus_x_recs(char* seq, uint32 n)
+// Number of (k+x)-mers (canonical, x < DIVIDE_FACTOR) sorted in the 2nd stage for a super k-mer of n symbols
+template<unsigned DIVIDE_FACTOR> uint32 count_n_plus_x_recs(const char* seq, uint32 n, uint32 kmer_len)
 {
+	enum comparision_state  { kmer_smaller, rev_smaller, equals };
 	uchar kmer, rev;
 	uint32 kmer_pos = 4;
 	uint32 rev_pos = kmer_len;
 	uint32 x;
+	uint32 n_plus_x_recs = 0;
 
 	kmer = (seq[0] << 6) + (seq[1] << 4) + (seq[2] << 2) + seq[3];
 	rev = ((3 - seq[kmer_len - 1]) << 6) + ((3 - seq[kmer_len - 2]) << 4) + ((3 - seq[kmer_len - 3]) << 2) + (3 - seq[kmer_len - 4]);
@@ -113,6 +113,23 @@ template<unsigned DIVIDE_FACTOR> void CKmerBinCollector::update_n_plus_x_recs(ch
 		}
 	}
 	n_plus_x_recs += 1 + x / DIVIDE_FACTOR;
+	return n_plus_x_recs;
+}
+
+//---------------------------------------------------------------------------------
+// Number of records sorted in the 2nd stage for a super k-mer of n symbols: k-mers if max_x is 0, (k+x)-mers otherwise
+inline uint32 count_2nd_stage_recs(const char* seq, uint32 n, uint32 kmer_len, uint32 max_x, bool both_strands)
+{
+	if (!max_x)
+		return n - kmer_len + 1;
+	if (!both_strands)
+		return 1 + (n - kmer_len) / (max_x + 1);
+	switch (max_x)
+	{
+	case 1: return count_n_plus_x_recs<2>(seq, n, kmer_len);
+	case 2: return count_n_plus_x_recs<3>(seq, n, kmer_len);
+	default: return count_n_plus_x_recs<4>(seq, n, kmer_len);
+	}
 }
 
 #endif
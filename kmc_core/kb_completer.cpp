@@ -11,6 +11,7 @@
 #include <numeric>
 #include "kb_completer.h"
 #include "critical_error_handler.h"
+#include "../kmc_api/murmur_hash.h"
 #include <sstream>
 
 using namespace std;
@@ -37,6 +38,7 @@ CKmerBinCompleter::CKmerBinCompleter(CKMCParams &Params, CKMCQueues &Queues)
 	use_strict_mem = Params.use_strict_mem;
 	kmer_file_name = file_name + ".kmc_suf";
 	lut_file_name  = file_name + ".kmc_pre";
+	hash_file_name = file_name + ".kmc_hash";
 
 	kmer_len       = Params.kmer_len;
 	signature_len  = Params.signature_len;
@@ -47,6 +49,9 @@ CKmerBinCompleter::CKmerBinCompleter(CKMCParams &Params, CKMCQueues &Queues)
 	lut_prefix_len = Params.lut_prefix_len;
 	both_strands   = Params.both_strands;
 	without_output = Params.without_output;
+	store_hashes   = Params.store_hashes && !without_output;
+	seed           = Params.seed;
+	max_hash       = murmur::fmh_max_hash(Params.scaled);
 
 	kmer_t_size    = Params.KMER_T_size;
 
@@ -62,9 +67,11 @@ void CKmerBinCompleter::ProcessBinsFirstStage()
 	uchar *data = nullptr;
 	//uint64 data_size = 0;
 	list<pair<uint64, uint64>> data_packs;
+	vector<uint64> hashes;
 	uchar *lut = nullptr;
 	uint64 lut_size = 0;
 	counter_size = 0;
+	CPerfThreadStats perf_stats(PerfPhase::bin_completer);
 	if (output_type == OutputType::KMC)
 	{
 		sig_map_size = (1 << (signature_len * 2)) + 1;
@@ -96,6 +103,19 @@ void CKmerBinCompleter::ProcessBinsFirstStage()
 				fclose(out_kmer);
 				CCriticalErrorHandler::Inst().HandleCriticalError(ostr.str());
 			}
+
+			if (store_hashes)
+			{
+				out_hash = fopen(hash_file_name.c_str(), "wb");
+				if (!out_hash)
+				{
+					std::ostringstream ostr;
+					ostr << "Error: Cannot create " << hash_file_name;
+					fclose(out_kmer);
+					fclose(out_lut);
+					CCriticalErrorHandler::Inst().HandleCriticalError(ostr.str());
+				}
+			}
 		}
 		else if (output_type == OutputType::KFF)
 		{			
@@ -116,6 +136,7 @@ void CKmerBinCompleter::ProcessBinsFirstStage()
 
 	char s_kmc_pre[] = "KMCP";
 	char s_kmc_suf[] = "KMCS";
+	char s_kmc_hash[] = "KMCH";
 
 	if (!without_output)
 	{
@@ -124,6 +145,8 @@ void CKmerBinCompleter::ProcessBinsFirstStage()
 			// Markers at the beginning
 			fwrite(s_kmc_pre, 1, 4, out_lut);
 			fwrite(s_kmc_suf, 1, 4, out_kmer);
+			if (store_hashes)
+				fwrite(s_kmc_hash, 1, 4, out_hash);
 		}
 	}
 
@@ -131,9 +154,11 @@ void CKmerBinCompleter::ProcessBinsFirstStage()
 	while (!kq->empty())
 	{
 		// Get the next bin
-		if (!kq->pop(bin_id, data, data_packs, lut, lut_size, _n_unique, _n_cutoff_min, _n_cutoff_max, _n_total))
+		if (!kq->pop(bin_id, data, data_packs, lut, lut_size, _n_unique, _n_cutoff_min, _n_cutoff_max, _n_total, hashes))
 			continue;
 
+		CPerfTraceScope trace_bin("write bin", "bin", bin_id);
+
 		// Decrease memory size allocated by stored bin
 		string name;
 		uint64 n_rec;
@@ -145,7 +170,9 @@ void CKmerBinCompleter::ProcessBinsFirstStage()
 		bd->read(bin_id, file, name, raw_size, n_rec, n_plus_x_recs, n_super_kmers);
 
 		uint64 lut_recs = lut_size / sizeof(uint64);
-
+		for (auto& e : data_packs)
+			perf_stats.AddBytes(e.second - e.first);
+		perf_stats.AddRecords(_n_unique);
 
 		if (!without_output)
 		{
@@ -168,6 +195,9 @@ void CKmerBinCompleter::ProcessBinsFirstStage()
 					fwrite(data + e.first, 1, e.second - e.first, out_kmer);
 #endif
 				}
+				// hashes were computed by the sorters, in the order of records
+				if (store_hashes)
+					fwrite(hashes.data(), sizeof(uint64), hashes.size(), out_hash);
 			}
 			else if (output_type == OutputType::KFF)
 			{
@@ -228,6 +258,7 @@ void CKmerBinCompleter::ProcessBinsSecondStage()
 {
 	char s_kmc_pre[] = "KMCP";
 	char s_kmc_suf[] = "KMCS";
+	char s_kmc_hash[] = "KMCH";
 	if (use_strict_mem)
 	{
 		int32 bin_id;
@@ -284,6 +315,12 @@ void CKmerBinCompleter::ProcessBinsSecondStage()
 			fwrite(s_kmc_suf, 1, 4, out_kmer);
 			fclose(out_kmer);
 
+			if (store_hashes)
+			{
+				fwrite(s_kmc_hash, 1, 4, out_hash);
+				fclose(out_hash);
+			}
+
 			fwrite(&n_recs, 1, sizeof(uint64), out_lut);
 
 			//store signature mapping 
@@ -303,8 +340,13 @@ void CKmerBinCompleter::ProcessBinsSecondStage()
 
 			store_uint(out_lut, both_strands ? 0 : 1, 1);			offset++;
 
+			// Flags (bit 0: .kmc_hash file is present) and parameters of hashes
+			store_uint(out_lut, store_hashes ? 1 : 0, 1);			offset++;
+			store_uint(out_lut, store_hashes ? seed : 0, 4);		offset += 4;
+			store_uint(out_lut, store_hashes ? max_hash : 0, 8);	offset += 8;
+
 			// Space for future use
-			for (int32 i = 0; i < 27; ++i)
+			for (int32 i = 0; i < 14; ++i)
 			{
 				store_uint(out_lut, 0, 1);
 				offset++;
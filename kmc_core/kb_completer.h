@@ -19,6 +19,7 @@
 #include <numeric>
 #include <array>
 #include <stdio.h>
+#include <vector>
 #include "small_k_buf.h"
 #include "kff_writer.h"
 
@@ -27,7 +28,7 @@
 //************************************************************************************************************
 class CKmerBinCompleter
 {
-	string file_name, kmer_file_name, lut_file_name;
+	string file_name, kmer_file_name, lut_file_name, hash_file_name;
 	CKmerQueue *kq;
 	CBinDesc *bd;
 	CSignatureMapper *s_mapper;
@@ -35,7 +36,7 @@ class CKmerBinCompleter
 	uint64 _n_unique, _n_cutoff_min, _n_cutoff_max, _n_total;
 	uint64 n_recs;
 
-	FILE *out_kmer, *out_lut;
+	FILE *out_kmer, *out_lut, *out_hash;
 	uint32 lut_pos;
 	uint32 sig_map_size;
 	uint64 counter_size;
@@ -56,6 +57,9 @@ class CKmerBinCompleter
 	int32 signature_len;	
 	bool both_strands;
 	bool without_output;
+	bool store_hashes;
+	uint32 seed;
+	uint64 max_hash;
 	bool store_uint(FILE *out, uint64 x, uint32 size);
 	std::unique_ptr<CKFFWriter> kff_writer;
 	OutputType output_type;
@@ -57,6 +57,16 @@ template <unsigned SIZE> class CKmerBinReader
 		return (x + ALIGNMENT-1) / ALIGNMENT * ALIGNMENT;
 	}
 
+	void prefetch_next_bin()
+	{
+		int32 next_bin_id = bd->peek_next_sort_bin();
+		if (next_bin_id < 0)
+			return;
+		CMemDiskFile* next_file = bd->get_file(next_bin_id);
+		if (next_file)
+			next_file->Prefetch();
+	}
+
 public:
 	CKmerBinReader(CKMCParams &Params, CKMCQueues &Queues);
 	~CKmerBinReader();
@@ -113,15 +123,22 @@ template <unsigned SIZE> void CKmerBinReader<SIZE>::ProcessBins()
 	uint64 n_rec;
 	uint64 n_plus_x_recs;
 
+	CPerfThreadStats perf_stats(PerfPhase::bin_reader);
 	CPercentProgress percent_progress("Stage 2: ", true, percentProgressObserver);
 	percent_progress.SetMaxVal(bd->get_n_rec_sum());
 	percent_progress.NotifyProgress(0);
 
 	while ((bin_id = bd->get_next_sort_bin()) >= 0)		// Get id of the next bin to read
 	{				
+		CPerfTraceScope trace_bin("read bin", "bin", bin_id);
 		bd->read(bin_id, file, name, size, n_rec, n_plus_x_recs);
 		fflush(stdout);
 
+		// Let the OS read the current and the next bin in background while we possibly wait for memory in memory_bins->init
+		if (size > 0 && file)
+			file->Prefetch();
+		prefetch_next_bin();
+
 		// Reserve memory necessary to process the current bin at all next stages
 		uint64 input_kmer_size;
 		uint64 kxmer_counter_size;
@@ -185,6 +202,8 @@ template <unsigned SIZE> void CKmerBinReader<SIZE>::ProcessBins()
 				ostr << "Error: Corrupted file: " << name << "   " << "Real size : " << readed << "   " << "Should be : " << size;
 				CCriticalErrorHandler::Inst().HandleCriticalError(ostr.str());
 			}
+			perf_stats.AddBytes(size);
+			perf_stats.AddRecords(n_rec);
 
 			// Reserve memory necessary to process the whole bin
 			memory_bins->extend(bin_id, rec_len, round_up_to_alignment(size), round_up_to_alignment(input_kmer_size), round_up_to_alignment(out_buffer_size), round_up_to_alignment(kxmer_counter_size), round_up_to_alignment(lut_size));
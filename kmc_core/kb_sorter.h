@@ -35,113 +35,11 @@
 
 
 #include "kxmer_set.h"
+#include "compact_policy.h"
 #include "rev_byte.h"
 
 using namespace std;
 
-
-#define ROTL64(x,y)	rotl64(x,y)
-#define BIG_CONSTANT(x) (x)
-
-/*
-inline uint64_t getblock64 ( const uint64_t * p, int i )
-{
-  return p[i];
-}
-
-inline uint64_t rotl64 ( uint64_t x, int8_t r )
-{
-  return (x << r) | (x >> (64 - r));
-}
-
-inline uint64_t fmix64 ( uint64_t k )
-{
-  k ^= k >> 33;
-  k *= BIG_CONSTANT(0xff51afd7ed558ccd);
-  k ^= k >> 33;
-  k *= BIG_CONSTANT(0xc4ceb9fe1a85ec53);
-  k ^= k >> 33;
-
-  return k;
-}
-
-void MurmurHash3_x64_128 ( const void * key, const int len,
-                           const uint32_t seed, void * out )
-{
-  const uint8_t * data = (const uint8_t*)key;
-  const int nblocks = len / 16;
-
-  uint64_t h1 = seed;
-  uint64_t h2 = seed;
-
-  const uint64_t c1 = BIG_CONSTANT(0x87c37b91114253d5);
-  const uint64_t c2 = BIG_CONSTANT(0x4cf5ad432745937f);
-
-  //----------
-  // body
-
-  const uint64_t * blocks = (const uint64_t *)(data);
-
-  for(int i = 0; i < nblocks; i++)
-  {
-    uint64_t k1 = getblock64(blocks,i*2+0);
-    uint64_t k2 = getblock64(blocks,i*2+1);
-
-    k1 *= c1; k1  = ROTL64(k1,31); k1 *= c2; h1 ^= k1;
-
-    h1 = ROTL64(h1,27); h1 += h2; h1 = h1*5+0x52dce729;
-
-    k2 *= c2; k2  = ROTL64(k2,33); k2 *= c1; h2 ^= k2;
-
-    h2 = ROTL64(h2,31); h2 += h1; h2 = h2*5+0x38495ab5;
-  }
-
-  //----------
-  // tail
-
-  const uint8_t * tail = (const uint8_t*)(data + nblocks*16);
-
-  uint64_t k1 = 0;
-  uint64_t k2 = 0;
-
-  switch(len & 15)
-  {
-  case 15: k2 ^= ((uint64_t)tail[14]) << 48;
-  case 14: k2 ^= ((uint64_t)tail[13]) << 40;
-  case 13: k2 ^= ((uint64_t)tail[12]) << 32;
-  case 12: k2 ^= ((uint64_t)tail[11]) << 24;
-  case 11: k2 ^= ((uint64_t)tail[10]) << 16;
-  case 10: k2 ^= ((uint64_t)tail[ 9]) << 8;
-  case  9: k2 ^= ((uint64_t)tail[ 8]) << 0;
-           k2 *= c2; k2  = ROTL64(k2,33); k2 *= c1; h2 ^= k2;
-
-  case  8: k1 ^= ((uint64_t)tail[ 7]) << 56;
-  case  7: k1 ^= ((uint64_t)tail[ 6]) << 48;
-  case  6: k1 ^= ((uint64_t)tail[ 5]) << 40;
-  case  5: k1 ^= ((uint64_t)tail[ 4]) << 32;
-  case  4: k1 ^= ((uint64_t)tail[ 3]) << 24;
-  case  3: k1 ^= ((uint64_t)tail[ 2]) << 16;
-  case  2: k1 ^= ((uint64_t)tail[ 1]) << 8;
-  case  1: k1 ^= ((uint64_t)tail[ 0]) << 0;
-           k1 *= c1; k1  = ROTL64(k1,31); k1 *= c2; h1 ^= k1;
-  };
-
-  h1 ^= len; h2 ^= len;
-
-  h1 += h2;
-  h2 += h1;
-
-  h1 = fmix64(h1);
-  h2 = fmix64(h2);
-
-  h1 += h2;
-  h2 += h1;
-
-  ((uint64_t*)out)[0] = h1;
-  ((uint64_t*)out)[1] = h2;
-}
-*/
-
 template<unsigned SIZE> class CExpandThread;
 
 //************************************************************************************************************
@@ -204,8 +102,10 @@ private:
 	void InitKXMerSet(uint64 start_pos, uint64 end_pos, uint32 offset, uint32 depth);
 	void InitKXMerSetMultithreaded(CKXmerSetMultiThreaded<SIZE>& kxmer_set_multithreaded, uint64 start_pos, uint64 end_pos, uint32 offset, uint32 depth);
 	void CompactKxmers();
+	template <CompactOutput OUTPUT, bool SCALED, uint32 COUNTER_SIZE> uint64 MergeKxmers(uint64* lut, uchar* out_buffer, uint32 kmer_symbols, uint64 kmer_bytes, vector<uint64>* hashes);
 	void PreCompactKxmers(uint64& compacted_count);
 	void CompactKmers();
+	template <CompactOutput OUTPUT, bool SCALED, uint32 COUNTER_SIZE> void CompactKmers();
 	void ExpandKxmersAll(uint64 tmp_size);
 	void ExpandKxmersBoth(uint64 tmp_size);
 	void ExpandKmersAll(uint64 tmp_size);
@@ -223,6 +123,8 @@ private:
 	uint64_t largest_value = 0xFFFFFFFFFFFFFFFF;
 	uint64_t threshold = largest_value;
 
+	bool store_hashes;
+
 
 public:
 	static uint32 PROB_BUF_SIZE;
@@ -316,11 +218,7 @@ template <unsigned SIZE> CKmerBinSorter<SIZE>::CKmerBinSorter(CKMCParams &Params
 	scaled = Params.scaled;
 	seed = Params.seed;
 	threshold = std::round((long double)(largest_value)/(long double)(scaled));
-	//cout << "threshold = " << threshold << endl;
-	//cout << "scaled = " << scaled << endl;
-	//cout << "seed = " << seed << endl;
-	//cout << "Param.seed = " << Params.seed << endl;
-	//cout << "Param.scaled = " << Params.scaled << endl;
+	store_hashes = Params.store_hashes && !without_output;
 }
 
 //----------------------------------------------------------------------------------
@@ -336,23 +234,31 @@ template <unsigned SIZE> void CKmerBinSorter<SIZE>::ProcessBins()
 	uint64 tmp_size;
 	uint64 tmp_n_rec;
 	CMemDiskFile *file;
+	CPerfThreadStats perf_stats(PerfPhase::bin_sorter);
 
 	while (sorters_manager->GetNext(bin_id, data, size, n_rec, n_sorting_threads))
 	{
+		CPerfTraceScope trace_bin("sort bin", "bin", bin_id);
 		// Get bin data
 		bd->read(bin_id, file, desc, tmp_size, tmp_n_rec, n_plus_x_recs);
+		perf_stats.AddBytes(size);
+		perf_stats.AddRecords(n_rec);
 
 		// Uncompact the kmers - append truncate prefixes
 
+		perf_stats.StartStep(PerfStep::expand);
 		Expand(tmp_size);
 
 		memory_bins->free(bin_id, CMemoryBins::mba_input_file);
 
 		// Perform sorting of kmers in a bin
+		perf_stats.StartStep(PerfStep::sort);
 		Sort();
 
 		// Compact the same kmers (occurring at neighbour positions now)
+		perf_stats.StartStep(PerfStep::compact);
 		Compact();
+		perf_stats.EndStep();
 
 		sorters_manager->ReturnThreads(n_sorting_threads, bin_id);
 	}
@@ -1057,6 +963,63 @@ template<unsigned SIZE> void CKmerBinSorter<SIZE>::PreCompactKxmers(uint64& comp
 	}
 }
 
+//----------------------------------------------------------------------------------
+// Merge k+x-mers of kxmer_set (single thread), returns the size of the output
+template <unsigned SIZE> template <CompactOutput OUTPUT, bool SCALED, uint32 COUNTER_SIZE>
+uint64 CKmerBinSorter<SIZE>::MergeKxmers(uint64* lut, uchar* out_buffer, uint32 kmer_symbols, uint64 kmer_bytes, vector<uint64>* hashes)
+{
+	uint64 out_pos = 0;
+	uint64 counter_pos = 0;
+
+	// Filter and store a k-mer with all its occurrences counted, so it is hashed once (and only if count >= cutoff_min)
+	auto compact_kmer = [&](CKmer<SIZE>& kmer, uint32 count) {
+		n_total += count;
+		++n_unique;
+		uint64 hash = 0;
+		if (count < cutoff_min || !fmh_admissible<SCALED>(kmer, kmer_len, seed, threshold, hash))
+			n_cutoff_min++;
+		else if (count > cutoff_max)
+			n_cutoff_max++;
+		else
+		{
+			if (count > counter_max)
+				count = counter_max;
+
+			if (OUTPUT == CompactOutput::kmc)
+				lut[kmer.remove_suffix(2 * kmer_symbols)]++;
+			// Store compacted kmer
+			store_compacted_kmer<OUTPUT, COUNTER_SIZE>(out_buffer, out_pos, kmer, (uint32)kmer_bytes, count);
+			store_kmer_hash<OUTPUT, SCALED>(hashes, kmer, kmer_len, seed, hash);
+		}
+	};
+
+	CKmer<SIZE> kmer, next_kmer;
+	kmer.clear();
+	next_kmer.clear();
+	uint32 count;
+	//first
+	kxmer_set.get_min(counter_pos, kmer);
+	count = kxmer_counters[counter_pos];
+
+	//rest
+	while (kxmer_set.get_min(counter_pos, next_kmer))
+	{
+		if (kmer == next_kmer)
+			count += kxmer_counters[counter_pos];
+		else
+		{
+			compact_kmer(kmer, count);
+			count = kxmer_counters[counter_pos];
+			kmer = next_kmer;
+		}
+	}
+
+	//last one
+	compact_kmer(kmer, count);
+
+	return out_pos;
+}
+
 //----------------------------------------------------------------------------------
 template <unsigned SIZE> void CKmerBinSorter<SIZE>::CompactKxmers()
 {
@@ -1089,6 +1052,7 @@ template <unsigned SIZE> void CKmerBinSorter<SIZE>::CompactKxmers()
 	fill_n(lut, lut_recs, 0);
 
 	list<pair<uint64, uint64>> output_packs_desc;
+	vector<uint64> hashes;
 	if (n_plus_x_recs)
 	{
 		uchar* raw_kxmer_counters = nullptr;
@@ -1107,7 +1071,7 @@ template <unsigned SIZE> void CKmerBinSorter<SIZE>::CompactKxmers()
 		{
 			//cout << "seed=" << seed << " and scaled=" << scaled << endl;
 			CKXmerSetMultiThreaded<SIZE> kxmer_set_multithreaded(buffer, kxmer_counters, compacted_count,
-				cutoff_min, cutoff_max, counter_max, kmer_len, lut_prefix_len, lut, out_buffer, n_sorting_threads, seed, scaled);
+				cutoff_min, cutoff_max, counter_max, kmer_len, lut_prefix_len, lut, out_buffer, n_sorting_threads, seed, scaled, store_hashes);
 
 			for (uint32 i = 1; i < 5; ++i)
 				InitKXMerSetMultithreaded(kxmer_set_multithreaded, pos[i - 1], pos[i], max_x + 2 - i, i);
@@ -1116,136 +1080,18 @@ template <unsigned SIZE> void CKmerBinSorter<SIZE>::CompactKxmers()
 
 			kxmer_set_multithreaded.GetStats(n_unique, n_cutoff_min, n_cutoff_max, n_total);
 			output_packs_desc = std::move(kxmer_set_multithreaded.GetOutputPacksDesc());
+			hashes = std::move(kxmer_set_multithreaded.GetHashes());
 		}
 		else
 		{
-			uint64 out_pos = 0;
 			for (uint32 i = 1; i < 5; ++i)
 				InitKXMerSet(pos[i - 1], pos[i], max_x + 2 - i, i);
 
-			uint64 counter_pos = 0;
-			uint64 counter_size = calc_counter_size(cutoff_max, counter_max);
-
-			CKmer<SIZE> kmer, next_kmer;
-			kmer.clear();
-			next_kmer.clear();
-			CKmer<SIZE> kmer_mask;
-			kmer_mask.set_n_1(kmer_len * 2);
-			uint32 count;
-			//first
-			kxmer_set.get_min(counter_pos, kmer);
-			count = kxmer_counters[counter_pos];
-
-			// MRH start
-			//std::string str_rep = kmer.get_string_representation(kmer_len);
-			//uint64_t hash_values[2] = {0};
-			//MurmurHash3_x64_128 ( str_rep.c_str(), kmer_len, seed, hash_values );
-			//std::cout << str_rep << " hashed to " << hash_values[0] << " at place3, where seed=" << seed << " and Scaled=" << scaled << endl;
-            // MRH end
-
-			//rest
-			while (kxmer_set.get_min(counter_pos, next_kmer))
-			{
-                // MRH start
-				std::string str_rep = kmer.get_string_representation(kmer_len);
-				uint64_t hash_values[2] = {0};
-				MurmurHash3_x64_128 ( str_rep.c_str(), kmer_len, seed, hash_values );
-				//std::cout << str_rep << " hashed to " << hash_values[0] << " at place2, where seed=" << seed << " and Scaled=" << scaled << endl;
-                // MRH end
-				if (kmer == next_kmer)
-					count += kxmer_counters[counter_pos];
-				else
-				{
-					n_total += count;
-					++n_unique;
-					if (count < cutoff_min || hash_values[0] >= threshold)
-						n_cutoff_min++;
-					else if (count >cutoff_max)
-						n_cutoff_max++;
-					else
-					{
-						if (count > counter_max)
-							count = counter_max;
-
-						if (!without_output)
-						{
-							if(output_type == OutputType::KMC)
-							{
-								lut[kmer.remove_suffix(2 * kmer_symbols)]++;
-								// Store compacted kmer
-
-								for (int32 j = (int32)kmer_bytes - 1; j >= 0; --j)
-									out_buffer[out_pos++] = kmer.get_byte(j);
-								for (int32 j = 0; j < (int32)counter_size; ++j)
-									out_buffer[out_pos++] = (count >> (j * 8)) & 0xFF;
-							}
-							else if (output_type == OutputType::KFF)
-							{
-								for (int32 j = (int32)kmer_bytes - 1; j >= 0; --j)
-									out_buffer[out_pos++] = kmer.get_byte(j);
-
-								for (int32 j = (int32)counter_size - 1; j >= 0; --j)
-									out_buffer[out_pos++] = (count >> (j * 8)) & 0xFF;
-							}
-							else
-							{
-								std::ostringstream ostr;
-								ostr << "Error: not implemented, plase contact authors showing this message" << __FILE__ << "\t" << __LINE__;
-								CCriticalErrorHandler::Inst().HandleCriticalError(ostr.str());
-							}
-						}
-					}
-					count = kxmer_counters[counter_pos];
-					kmer = next_kmer;
-				}
-			}
-
-			// MRH start
-			std::string str_rep = next_kmer.get_string_representation(kmer_len);
-			uint64_t hash_values[2] = {0};
-			MurmurHash3_x64_128 ( str_rep.c_str(), kmer_len, seed, hash_values );
-			//std::cout << str_rep << " hased to " << hash_values[0] << " place1, where seed=" << seed << " and Scaled=" << scaled << endl;
-			// MRH end
-			//last one
-			++n_unique;
-			n_total += count;
-			if (count < cutoff_min || hash_values[0] >= threshold)
-				n_cutoff_min++;
-			else if (count >cutoff_max)
-				n_cutoff_max++;
-			else
-			{
-
-				if (count > counter_max)
-					count = counter_max;
-
-				if (!without_output)
-				{
-					if (output_type == OutputType::KMC)
-					{
-						lut[kmer.remove_suffix(2 * kmer_symbols)]++;
-						// Store compacted kmer
-
-						for (int32 j = (int32)kmer_bytes - 1; j >= 0; --j)
-							out_buffer[out_pos++] = kmer.get_byte(j);
-						for (int32 j = 0; j < (int32)counter_size; ++j)
-							out_buffer[out_pos++] = (count >> (j * 8)) & 0xFF;
-					}
-					else if (output_type == OutputType::KFF)
-					{
-						for (int32 j = (int32)kmer_bytes - 1; j >= 0; --j)
-							out_buffer[out_pos++] = kmer.get_byte(j);
-						for (int32 j = (int32)counter_size - 1; j >= 0; --j)
-							out_buffer[out_pos++] = (count >> (j * 8)) & 0xFF;
-					}
-					else
-					{
-						std::ostringstream ostr;
-						ostr << "Error: not implemented, plase contact authors showing this message" << __FILE__ << "\t" << __LINE__;
-						CCriticalErrorHandler::Inst().HandleCriticalError(ostr.str());
-					}
-				}
-			}
+			uint64 out_pos = 0;
+			dispatch_compaction(without_output, output_type, threshold != largest_value, calc_counter_size(cutoff_max, counter_max),
+				[&](auto output, auto scaled, auto counter_size) {
+					out_pos = this->template MergeKxmers<decltype(output)::value, decltype(scaled)::value, decltype(counter_size)::value>(lut, out_buffer, kmer_symbols, kmer_bytes, store_hashes ? &hashes : nullptr);
+				});
 
 			if(!without_output)
 				output_packs_desc.emplace_back(0, out_pos);
@@ -1256,7 +1102,7 @@ template <unsigned SIZE> void CKmerBinSorter<SIZE>::CompactKxmers()
 
 
 	// Push the sorted and compacted kmer bin to a queue in a form ready to be stored to HDD
-	kq->push(bin_id, out_buffer, output_packs_desc, raw_lut, lut_size, n_unique, n_cutoff_min, n_cutoff_max, n_total);
+	kq->push(bin_id, out_buffer, output_packs_desc, raw_lut, lut_size, n_unique, n_cutoff_min, n_cutoff_max, n_total, std::move(hashes));
 
 	if (buffer_input)
 	{
@@ -1271,6 +1117,15 @@ template <unsigned SIZE> void CKmerBinSorter<SIZE>::CompactKxmers()
 
 //----------------------------------------------------------------------------------
 template <unsigned SIZE> void CKmerBinSorter<SIZE>::CompactKmers()
+{
+	dispatch_compaction(without_output, output_type, threshold != largest_value, calc_counter_size(cutoff_max, counter_max),
+		[this](auto output, auto scaled, auto counter_size) {
+			this->template CompactKmers<decltype(output)::value, decltype(scaled)::value, decltype(counter_size)::value>();
+		});
+}
+
+//----------------------------------------------------------------------------------
+template <unsigned SIZE> template <CompactOutput OUTPUT, bool SCALED, uint32 COUNTER_SIZE> void CKmerBinSorter<SIZE>::CompactKmers()
 {
 	uint64 i;
 
@@ -1284,8 +1139,6 @@ template <unsigned SIZE> void CKmerBinSorter<SIZE>::CompactKmers()
 		lut_recs = 0;
 	uint64 lut_size = lut_recs * sizeof(uint64);
 
-	uint64 counter_size = calc_counter_size(cutoff_max, counter_max);
-
 	uchar *out_buffer;
 	uchar *raw_lut;
 
@@ -1303,14 +1156,36 @@ template <unsigned SIZE> void CKmerBinSorter<SIZE>::CompactKmers()
 	n_cutoff_max = 0;
 	n_total = 0;
 
-	if (n_rec)			// non-empty bin
-	{
+	vector<uint64> hashes;
+	vector<uint64>* hashes_ptr = store_hashes ? &hashes : nullptr;
+
+	// Filter and store a k-mer with all its occurrences counted
+	auto compact_kmer = [&](CKmer<SIZE>& kmer, uint32 count) {
+		++n_unique;
+		uint64 hash = 0;
+		// k-mers below cutoff_min are not hashed
+		if (count < cutoff_min || !fmh_admissible<SCALED>(kmer, kmer_len, seed, threshold, hash))
+			n_cutoff_min++;
+		else if (count > cutoff_max)
+			n_cutoff_max++;
+		else
+		{
+			if (count > counter_max)
+				count = counter_max;
 
+			// Store compacted kmer
+			store_compacted_kmer<OUTPUT, COUNTER_SIZE>(out_buffer, out_pos, kmer, (uint32)kmer_bytes, count);
+			store_kmer_hash<OUTPUT, SCALED>(hashes_ptr, kmer, kmer_len, seed, hash);
+			if (OUTPUT == CompactOutput::kmc)
+				lut[kmer.remove_suffix(2 * kmer_symbols)]++;
+		}
+	};
 
+	if (n_rec)			// non-empty bin
+	{
 		act_kmer = &buffer[0];
 		count = 1;
 
-
 		n_total = n_rec;
 
 		for (i = 1; i < n_rec; ++i)
@@ -1319,117 +1194,19 @@ template <unsigned SIZE> void CKmerBinSorter<SIZE>::CompactKmers()
 				count++;
 			else
 			{
-				// MRH start
-				std::string str_rep = act_kmer->get_string_representation(kmer_len);
-				uint64_t hash_values[2] = {0};
-				MurmurHash3_x64_128 ( str_rep.c_str(), kmer_len, seed, hash_values );
-				// MRH end
-				if (count < cutoff_min || hash_values[0] >= threshold)
-				{
-					act_kmer = &buffer[i];
-					n_cutoff_min++;
-					n_unique++;
-					count = 1;
-				}
-				else if (count > cutoff_max)
-				{
-					act_kmer = &buffer[i];
-					n_cutoff_max++;
-					n_unique++;
-					count = 1;
-				}
-				else
-				{
-					if (count > counter_max)
-						count = counter_max;
-
-					if (!without_output)
-					{
-						if (output_type == OutputType::KMC)
-						{
-							// Store compacted kmer
-							for (int32 j = (int32)kmer_bytes - 1; j >= 0; --j)
-								out_buffer[out_pos++] = act_kmer->get_byte(j);
-							for (int32 j = 0; j < (int32)counter_size; ++j)
-								out_buffer[out_pos++] = (count >> (j * 8)) & 0xFF;
-
-							lut[act_kmer->remove_suffix(2 * kmer_symbols)]++;
-						}
-						else if (output_type == OutputType::KFF)
-						{
-							for (int32 j = (int32)kmer_bytes - 1; j >= 0; --j)
-								out_buffer[out_pos++] = act_kmer->get_byte(j);
-
-							for (int32 j = (int32)counter_size - 1; j >= 0; --j)
-								out_buffer[out_pos++] = (count >> (j * 8)) & 0xFF;
-						}
-						else
-						{
-							std::ostringstream ostr;
-							ostr << "Error: not implemented, plase contact authors showing this message" << __FILE__ << "\t" << __LINE__;
-							CCriticalErrorHandler::Inst().HandleCriticalError(ostr.str());
-						}
-					}
-					act_kmer = &buffer[i];
-					count = 1;
-					n_unique++;
-				}
+				compact_kmer(*act_kmer, count);
+				act_kmer = &buffer[i];
+				count = 1;
 			}
 		}
 
-		// MRH start
-		std::string str_rep = act_kmer->get_string_representation(kmer_len);
-		uint64_t hash_values[2] = {0};
-		MurmurHash3_x64_128 ( str_rep.c_str(), kmer_len, seed, hash_values );
-		//std::cout << str_rep << " hashed to " << hash_values[0] << " at place4, where seed=" << seed << " and Scaled=" << scaled << endl;
-		// MRH end
-		if (count < cutoff_min || hash_values[0] >= threshold)
-		{
-			n_cutoff_min++;
-		}
-		else if (count > cutoff_max)
-		{
-			n_cutoff_max++;
-		}
-		else
-		{
-			if (count > counter_max)
-				count = counter_max;
-
-			if (!without_output)
-			{
-				if (output_type == OutputType::KMC)
-				{
-					// Store compacted kmer
-					for (int32 j = (int32)kmer_bytes - 1; j >= 0; --j)
-						out_buffer[out_pos++] = act_kmer->get_byte(j);
-					for (int32 j = 0; j < (int32)counter_size; ++j)
-						out_buffer[out_pos++] = (count >> (j * 8)) & 0xFF;
-
-					lut[act_kmer->remove_suffix(2 * kmer_symbols)]++;
-				}
-				else if (output_type == OutputType::KFF)
-				{
-					for (int32 j = (int32)kmer_bytes - 1; j >= 0; --j)
-						out_buffer[out_pos++] = act_kmer->get_byte(j);
-					for (int32 j = (int32)counter_size - 1; j >= 0; --j)
-						out_buffer[out_pos++] = (count >> (j * 8)) & 0xFF;
-				}
-				else
-				{
-					std::ostringstream ostr;
-					ostr << "Error: not implemented, plase contact authors showing this message" << __FILE__ << "\t" << __LINE__;
-					CCriticalErrorHandler::Inst().HandleCriticalError(ostr.str());
-				}
-			}
-		}
-		n_unique++;
+		compact_kmer(*act_kmer, count);
 	}
 	list<pair<uint64, uint64>> data_packs;
-	if(!without_output)
+	if (OUTPUT != CompactOutput::none)
 		data_packs.emplace_back(0, out_pos);
 	// Push the sorted and compacted kmer bin to a priority queue in a form ready to be stored to HDD
-	kq->push(bin_id, out_buffer, data_packs, raw_lut, lut_size, n_unique, n_cutoff_min, n_cutoff_max, n_total);
+	kq->push(bin_id, out_buffer, data_packs, raw_lut, lut_size, n_unique, n_cutoff_min, n_cutoff_max, n_total, std::move(hashes));
 
 	if (buffer_input)
 	{
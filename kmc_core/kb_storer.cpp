@@ -177,6 +177,8 @@ bool CKmerBinStorer::OpenFiles()
 // 
 void CKmerBinStorer::ProcessQueue()
 {
+	CPerfThreadStats perf_stats(PerfPhase::bin_storer);
+
 	// Process the queue
 	while(!q_part->completed())
 	{
@@ -188,6 +190,9 @@ void CKmerBinStorer::ProcessQueue()
 		list<pair<uint64, uint64>> expander_parts;
 		if (q_part->pop(bin_id, part, true_size, alloc_size, expander_parts))
 		{
+			CPerfTraceScope trace_part("store part", "bin", bin_id);
+			perf_stats.AddBytes(true_size);
+			perf_stats.AddRecords(1);
 			epd->push(bin_id, expander_parts);
 			expander_parts.clear();
 			if(!buffer[bin_id])
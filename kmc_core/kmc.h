@@ -87,6 +87,7 @@ template <unsigned SIZE> class CKMC {
 
 
 	void CheckAndReportMissingEOLs();
+	void ReportOversizedSignatures(uint64 bin_mem_budget);
 	
 	void buildSignatureMapping();
 
@@ -133,6 +134,7 @@ template <unsigned SIZE> void CKMC<SIZE>::SetParamsStage1(const KMC::Stage1Param
 	//added by MRH
 	Params.seed = stage1Params.GetSeed();
 	Params.scaled = stage1Params.GetScaled();
+	Params.trace_file_name = stage1Params.GetTraceFile();
 	//std::cout << "seed: " << Params.seed << std::endl;
 	//std::cout << "scaled: " << Params.scaled << std::endl;
 
@@ -230,6 +232,12 @@ template <unsigned SIZE> void CKMC<SIZE>::SetParamsStage2(const KMC::Stage2Param
 
 	Params.without_output = stage2Params.GetWithoutOutput();
 	Params.use_strict_mem = stage2Params.GetStrictMemoryMode();
+	Params.store_hashes = stage2Params.GetStoreHashes();
+	if (Params.store_hashes && (Params.use_strict_mem || Params.output_type != OutputType::KMC))
+	{
+		Params.warningsLogger->Log("hashes of k-mers can be stored only for KMC output in non strict memory mode, they will not be stored");
+		Params.store_hashes = false;
+	}
 
 	Params.max_mem_size = NORM(((uint64)stage2Params.GetMaxRamGB()) * 1000000000ull, (uint64)MIN_MEM * 1000000000ull, 1024ull * 1000000000ull);
 	SetThreads2Stage(stage2Params);
@@ -756,6 +764,32 @@ template <unsigned SIZE> bool CKMC<SIZE>::AdjustMemoryLimitsSmallK()
 	return true;
 }
 
+//----------------------------------------------------------------------------------
+// Warn about signatures which alone are predicted to need more memory in the 2nd stage than a single bin should use
+template <unsigned SIZE>
+void CKMC<SIZE>::ReportOversizedSignatures(uint64 bin_mem_budget)
+{
+	const auto& oversized = Queues.s_mapper->GetOversizedSignatures();
+	const uint32 max_reported = 5;
+	for (uint32 i = 0; i < oversized.size() && i < max_reported; ++i)
+	{
+		std::string signature(Params.signature_len, ' ');
+		for (int j = 0; j < Params.signature_len; ++j)
+			signature[j] = "ACGT"[(oversized[i].first >> 2 * (Params.signature_len - j - 1)) & 3];
+
+		std::ostringstream ostr;
+		ostr << "signature " << signature << " is predicted to need " << oversized[i].second / 1000000 << "MB in the 2nd stage, more than "
+			<< bin_mem_budget / 1000000 << "MB per thread. Its bin cannot be split, so the 2nd stage may run it alone or exceed the memory limit";
+		Params.warningsLogger->Log(ostr.str());
+	}
+	if (oversized.size() > max_reported)
+	{
+		std::ostringstream ostr;
+		ostr << (oversized.size() - max_reported) << " more signatures are predicted to need more than " << bin_mem_budget / 1000000 << "MB in the 2nd stage";
+		Params.warningsLogger->Log(ostr.str());
+	}
+}
+
 //----------------------------------------------------------------------------------
 template <unsigned SIZE>
 void CKMC<SIZE>::CheckAndReportMissingEOLs()
@@ -1038,6 +1072,10 @@ template <unsigned SIZE> void CKMC<SIZE>::buildSignatureMapping()
 
 		bin_file_reader_thread.join();
 
+		// The sample is the beginning of the input, its stats are scaled to the (predicted) size of the whole input
+		uint64 sample_size = Queues.stats_part_queue->get_bytes_pushed();
+		double sample_scale = sample_size ? MAX(1.0, (double)w_bin_file_reader->GetPredictedSize() / sample_size) : 1.0;
+
 		w_bin_file_reader.reset();
 
 		for (auto& ptr : Queues.binary_pack_queues)
@@ -1066,10 +1104,18 @@ template <unsigned SIZE> void CKMC<SIZE>::buildSignatureMapping()
 
 		CStopWatch heuristic_time;
 
+		// In the 2nd stage a bin needs memory for its records (k-mers or (k+x)-mers) and for sorting them,
+		// (k+x)-mers have also counters used when they are expanded to k-mers.
+		// Sorters work on bins in parallel, so a single bin should fit in the memory share of a thread
+		uint64 rec_bytes = 2 * sizeof(CKmer<SIZE>) + (Params.max_x ? sizeof(uint32) : 0);
+		uint64 bin_mem_budget = Params.max_mem_size / MAX(1, Params.n_threads);
+
 		heuristic_time.startTimer();
-		Queues.s_mapper->Init(stats);
+		Queues.s_mapper->Init(stats, rec_bytes, sample_scale, bin_mem_budget);
 		heuristic_time.stopTimer();
 
+		ReportOversizedSignatures(bin_mem_budget);
+
 		Queues.pmm_stats->free(stats);
 		Queues.pmm_stats->release();
 		Queues.pmm_stats.reset();
@@ -1418,6 +1464,11 @@ template <unsigned SIZE> KMC::Stage2Results CKMC<SIZE>::ProcessStage2_impl()
 		return results;
 	if (was_small_k_opt)
 	{
+		if (Params.store_hashes)
+		{
+			Params.warningsLogger->Log("hashes of k-mers cannot be stored in small k optimization mode, they will not be stored");
+			Params.store_hashes = false;
+		}
 		return ProcessSmallKOptimization_Stage2();
 	}
 	CStopWatch timer_stage2;
@@ -1733,6 +1784,8 @@ template <unsigned SIZE> KMC::Stage2Results CKMC<SIZE>::ProcessStage2_impl()
 
 	// ***** End of Stage 2 *****
 	w_completer->GetTotal(results.nUniqueKmers, results.nBelowCutoffMin, results.nAboveCutoffMax, results.nTotalKmers);
+	Queues.sorters_manager->GetTailStats(results.sortersTailNs, results.sortersTailIdleThreadNs);
+	results.nSortingThreads = Params.n_sorters;
 	
 	uint64 stat_n_plus_x_recs, stat_n_recs, stat_n_recs_tmp, stat_n_plus_x_recs_tmp;
 	stat_n_plus_x_recs = stat_n_recs = stat_n_recs_tmp = stat_n_plus_x_recs_tmp = 0;
@@ -1807,17 +1860,76 @@ template <unsigned SIZE> KMC::Stage2Results CKMC<SIZE>::ProcessStage2_impl()
 	return results;
 }
 
+//----------------------------------------------------------------------------------
+// Move counters of workers that finished since the last call to results
+inline std::vector<KMC::ThreadStats> take_thread_stats()
+{
+	std::vector<KMC::ThreadStats> res;
+	for (auto& rec : CPerfStatsCollector::Inst().Take())
+	{
+		KMC::ThreadStats stats;
+		stats.phase = perf_phase_name(rec.phase);
+		stats.threadNo = rec.thread_no;
+		stats.bytes = rec.counters.bytes;
+		stats.records = rec.counters.records;
+		stats.wallNs = rec.counters.wall_ns;
+		stats.busyNs = rec.counters.busy_ns();
+		stats.idleNs = rec.counters.idle_ns;
+		stats.blockedNs = rec.counters.blocked_ns;
+		stats.nIdleWaits = rec.counters.n_idle_waits;
+		stats.nBlockedWaits = rec.counters.n_blocked_waits;
+		if (rec.phase == PerfPhase::bin_sorter)
+			for (int i = 0; i < (int)PerfStep::no_steps; ++i)
+				stats.stepsNs.emplace_back(perf_step_name((PerfStep)i), rec.counters.step_ns[i]);
+		res.push_back(std::move(stats));
+	}
+	return res;
+}
+
 template <unsigned SIZE> KMC::Stage1Results CKMC<SIZE>::ProcessStage1()
 {
-	auto res = ProcessStage1_impl();
-	CThreadExceptionCollector::Inst().RethrowIfAnyException();
+	CPerfStatsCollector::Inst().Take();
+	// tracing is per run, so a previous run which did not reach the end of stage 2 must not leave it enabled
+	if (!Params.trace_file_name.empty())
+		CPerfStatsCollector::Inst().EnableTrace();
+	else
+		CPerfStatsCollector::Inst().DisableTrace();
+	KMC::Stage1Results res;
+	try
+	{
+		res = ProcessStage1_impl();
+		CThreadExceptionCollector::Inst().RethrowIfAnyException();
+	}
+	catch (...)
+	{
+		CPerfStatsCollector::Inst().DisableTrace();
+		throw;
+	}
+	res.threadStats = take_thread_stats();
 	return res;
 }
 
 template <unsigned SIZE> KMC::Stage2Results CKMC<SIZE>::ProcessStage2()
 {
-	auto res = ProcessStage2_impl();
-	CThreadExceptionCollector::Inst().RethrowIfAnyException();
+	CPerfStatsCollector::Inst().Take();
+	KMC::Stage2Results res;
+	try
+	{
+		res = ProcessStage2_impl();
+		CThreadExceptionCollector::Inst().RethrowIfAnyException();
+	}
+	catch (...)
+	{
+		CPerfStatsCollector::Inst().DisableTrace();
+		throw;
+	}
+	res.threadStats = take_thread_stats();
+	if (!Params.trace_file_name.empty() && !CPerfStatsCollector::Inst().SaveTrace(Params.trace_file_name))
+	{
+		std::ostringstream ostr;
+		ostr << "cannot save trace of execution to " << Params.trace_file_name;
+		Params.warningsLogger->Log(ostr.str());
+	}
 	return res;
 }
 
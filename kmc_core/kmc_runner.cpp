@@ -214,6 +214,12 @@ namespace KMC
 		return *this;
 	}
 
+	Stage1Params& Stage1Params::SetTraceFile(const std::string& traceFile)
+	{
+		this->traceFile = traceFile;
+		return *this;
+	}
+
 	Stage1Params& Stage1Params::SetNThreads(uint32_t nThreads)
 	{
 		this->nThreads = nThreads;
@@ -384,6 +390,11 @@ namespace KMC
 		this->withoutOutput = withoutOutput;
 		return *this;
 	}
+	Stage2Params& Stage2Params::SetStoreHashes(bool storeHashes)
+	{
+		this->storeHashes = storeHashes;
+		return *this;
+	}
 	Stage2Params& Stage2Params::SetStrictMemoryNSortingThreadsPerSorters(uint32_t strictMemoryNSortingThreadsPerSorters)
 	{
 		if (strictMemoryNSortingThreadsPerSorters < MIN_SMSO || strictMemoryNSortingThreadsPerSorters > MAX_SMSO)
@@ -438,6 +449,8 @@ namespace KMC
 		{
 			if (!stage1WasCalled)
 				throw std::runtime_error("Cannot run stage 2 when stage 1 was not run");
+			//bins of stage 1 are consumed by stage 2, so each stage 2 needs its own stage 1
+			stage1WasCalled = false;
 			return app->ProcessStage2(stage2Params);
 		}
 	};
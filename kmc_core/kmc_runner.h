@@ -131,6 +131,8 @@ namespace KMC
 		uint32_t scaled = 1;
 		uint32_t seed = 0;
 
+		std::string traceFile;
+
 #ifdef DEVELOP_MODE
 		bool developVerbose = false;
 #endif
@@ -158,6 +160,9 @@ namespace KMC
 		Stage1Params& SetScaled(const uint32_t scaled);
 		Stage1Params& SetSeed(const uint32_t seed);
 
+		//events of workers of both stages are saved in Chrome trace event format after the second stage
+		Stage1Params& SetTraceFile(const std::string& traceFile);
+
 #ifdef DEVELOP_MODE
 		Stage1Params& SetDevelopVerbose(bool developVerbose);
 #endif
@@ -184,6 +189,7 @@ namespace KMC
 		//added my MRH
 		uint32_t GetScaled() const noexcept { return scaled; }
 		uint32_t GetSeed() const noexcept { return seed; }
+		const std::string& GetTraceFile() const noexcept { return traceFile; }
 #ifdef DEVELOP_MODE
 		bool GetDevelopVerbose() const noexcept { return developVerbose; }
 #endif
@@ -201,6 +207,7 @@ namespace KMC
 		std::string outputFileName;
 		OutputFileType outputFileType = OutputFileType::KMC;
 		bool withoutOutput = false;
+		bool storeHashes = false;
 		uint32_t strictMemoryNSortingThreadsPerSorters = 0;
 		uint32_t strictMemoryNUncompactors = 0;
 		uint32_t strictMemoryNMergers = 0;
@@ -216,6 +223,7 @@ namespace KMC
 		Stage2Params& SetOutputFileName(const std::string& outputFileName);
 		Stage2Params& SetOutputFileType(OutputFileType outputFileType);
 		Stage2Params& SetWithoutOutput(bool withoutOutput);		
+		Stage2Params& SetStoreHashes(bool storeHashes);
 		Stage2Params& SetStrictMemoryNSortingThreadsPerSorters(uint32_t strictMemoryNSortingThreadsPerSorters);
 		Stage2Params& SetStrictMemoryNUncompactors(uint32_t strictMemoryNUncompactors);
 		Stage2Params& SetStrictMemoryNMergers(uint32_t strictMemoryNMergers);
@@ -229,11 +237,28 @@ namespace KMC
 		const std::string& GetOutputFileName() const noexcept { return outputFileName; }
 		OutputFileType GetOutputFileType() const noexcept { return outputFileType; }
 		bool GetWithoutOutput() const noexcept { return withoutOutput; }
+		bool GetStoreHashes() const noexcept { return storeHashes; }
 		uint32_t GetStrictMemoryNSortingThreadsPerSorters() const noexcept { return strictMemoryNSortingThreadsPerSorters; }
 		uint32_t GetStrictMemoryNUncompactors() const noexcept { return strictMemoryNUncompactors; }
 		uint32_t GetStrictMemoryNMergers() const noexcept { return strictMemoryNMergers; }
 	};
 
+	//counters of a single worker thread, times in nanoseconds, busy = wall - idle - blocked
+	struct ThreadStats
+	{
+		std::string phase;
+		uint32_t threadNo{};
+		uint64_t bytes{};
+		uint64_t records{};
+		uint64_t wallNs{};
+		uint64_t busyNs{};
+		uint64_t idleNs{};		//waiting for input
+		uint64_t blockedNs{};	//waiting for memory or for the next phase
+		uint64_t nIdleWaits{};
+		uint64_t nBlockedWaits{};
+		std::vector<std::pair<std::string, uint64_t>> stepsNs; //only for bin_sorter: expand, sort, compact
+	};
+
 	struct Stage1Results
 	{
 		double time{};
@@ -242,6 +267,7 @@ namespace KMC
 		uint64_t nTotalSuperKmers{};
 		uint64_t tmpSize{};
 		std::vector<uint64_t> estimatedHistogram;
+		std::vector<ThreadStats> threadStats;
 	};
 
 	struct Stage2Results
@@ -254,6 +280,10 @@ namespace KMC
 		uint64_t nAboveCutoffMax{};
 		uint64_t nTotalKmers{}; //TODO: this can be get after first stage, maybe changed
 		uint64_t nUniqueKmers{};
+		std::vector<ThreadStats> threadStats;
+		uint32_t nSortingThreads{};
+		uint64_t sortersTailNs{};			//from the first sorter without more bins till the end of sorting
+		uint64_t sortersTailIdleThreadNs{};	//sum of times the sorting threads were idle in the tail
 	};
 
 	
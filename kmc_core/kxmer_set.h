@@ -14,6 +14,8 @@
 #include <queue>
 #include <cmath>
 #include "exception_aware_thread.h"
+#include "../kmc_api/murmur_hash.h"
+#include "compact_policy.h"
 
 using namespace std;
 
@@ -21,109 +23,6 @@ using namespace std;
 
 #define MAX_FOR_X_3 112
 
-
-#define ROTL64(x,y)	rotl64(x,y)
-#define BIG_CONSTANT(x) (x)
-
-
-inline uint64_t getblock64 ( const uint64_t * p, int i )
-{
-  return p[i];
-}
-
-inline uint64_t rotl64 ( uint64_t x, int8_t r )
-{
-  return (x << r) | (x >> (64 - r));
-}
-
-inline uint64_t fmix64 ( uint64_t k )
-{
-  k ^= k >> 33;
-  k *= BIG_CONSTANT(0xff51afd7ed558ccd);
-  k ^= k >> 33;
-  k *= BIG_CONSTANT(0xc4ceb9fe1a85ec53);
-  k ^= k >> 33;
-
-  return k;
-}
-
-void MurmurHash3_x64_128 ( const void * key, const int len,
-                           const uint32_t seed, void * out )
-{
-  const uint8_t * data = (const uint8_t*)key;
-  const int nblocks = len / 16;
-
-  uint64_t h1 = seed;
-  uint64_t h2 = seed;
-
-  const uint64_t c1 = BIG_CONSTANT(0x87c37b91114253d5);
-  const uint64_t c2 = BIG_CONSTANT(0x4cf5ad432745937f);
-
-  //----------
-  // body
-
-  const uint64_t * blocks = (const uint64_t *)(data);
-
-  for(int i = 0; i < nblocks; i++)
-  {
-    uint64_t k1 = getblock64(blocks,i*2+0);
-    uint64_t k2 = getblock64(blocks,i*2+1);
-
-    k1 *= c1; k1  = ROTL64(k1,31); k1 *= c2; h1 ^= k1;
-
-    h1 = ROTL64(h1,27); h1 += h2; h1 = h1*5+0x52dce729;
-
-    k2 *= c2; k2  = ROTL64(k2,33); k2 *= c1; h2 ^= k2;
-
-    h2 = ROTL64(h2,31); h2 += h1; h2 = h2*5+0x38495ab5;
-  }
-
-  //----------
-  // tail
-
-  const uint8_t * tail = (const uint8_t*)(data + nblocks*16);
-
-  uint64_t k1 = 0;
-  uint64_t k2 = 0;
-
-  switch(len & 15)
-  {
-  case 15: k2 ^= ((uint64_t)tail[14]) << 48;
-  case 14: k2 ^= ((uint64_t)tail[13]) << 40;
-  case 13: k2 ^= ((uint64_t)tail[12]) << 32;
-  case 12: k2 ^= ((uint64_t)tail[11]) << 24;
-  case 11: k2 ^= ((uint64_t)tail[10]) << 16;
-  case 10: k2 ^= ((uint64_t)tail[ 9]) << 8;
-  case  9: k2 ^= ((uint64_t)tail[ 8]) << 0;
-           k2 *= c2; k2  = ROTL64(k2,33); k2 *= c1; h2 ^= k2;
-
-  case  8: k1 ^= ((uint64_t)tail[ 7]) << 56;
-  case  7: k1 ^= ((uint64_t)tail[ 6]) << 48;
-  case  6: k1 ^= ((uint64_t)tail[ 5]) << 40;
-  case  5: k1 ^= ((uint64_t)tail[ 4]) << 32;
-  case  4: k1 ^= ((uint64_t)tail[ 3]) << 24;
-  case  3: k1 ^= ((uint64_t)tail[ 2]) << 16;
-  case  2: k1 ^= ((uint64_t)tail[ 1]) << 8;
-  case  1: k1 ^= ((uint64_t)tail[ 0]) << 0;
-           k1 *= c1; k1  = ROTL64(k1,31); k1 *= c2; h1 ^= k1;
-  };
-
-  h1 ^= len; h2 ^= len;
-
-  h1 += h2;
-  h2 += h1;
-
-  h1 = fmix64(h1);
-  h2 = fmix64(h2);
-
-  h1 += h2;
-  h2 += h1;
-
-  ((uint64_t*)out)[0] = h1;
-  ((uint64_t*)out)[1] = h2;
-}
-
-
 template <unsigned SIZE>
 class CKXmerSet;
 
@@ -465,6 +364,8 @@ class CKXmerMerger
 	uint64_t threshold = largest_value;
 
 	list<pair<uint64, uint64>> packs;
+	bool store_hashes;
+	list<pair<uint64, vector<uint64>>> hash_packs;		// hashes of records of each pack, by its start
 public:
 
 	void GetStats(uint64& _n_unique, uint64& _n_cutoff_min, uint64& _n_cutoff_max, uint64& _n_total)
@@ -484,9 +385,7 @@ public:
 		mask.set_n_1(kmer_len * 2);
 
 		uint64 last_prefix = 0;
-		uint64 last_prefix_n_recs = 0;
 		uint64 first_prefix = 1ull << 2 * lut_prefix_len;
-		uint64 first_prefix_n_recs = 0;
 
 		uint32 suffix_len_bits = (kmer_len - lut_prefix_len) * 2;
 		uint64 kmer_bytes = suffix_len_bits / 8;
@@ -512,16 +411,59 @@ public:
 					first_prefix = candidate_min_prefix;
 			}
 		}
+		dispatch_compaction(without_output, output_type, threshold != largest_value, counter_size,
+			[&](auto output, auto scaled, auto counter_bytes) {
+				this->template Merge<decltype(output)::value, decltype(scaled)::value, decltype(counter_bytes)::value>(out_start, first_prefix, last_prefix, suffix_len_bits, kmer_bytes);
+			});
+	}
+
+	template<CompactOutput OUTPUT, bool SCALED, uint32 COUNTER_SIZE>
+	void Merge(uint64 out_start, uint64 first_prefix, uint64 last_prefix, uint32 suffix_len_bits, uint64 kmer_bytes)
+	{
 		uint64 counter_pos = 0;
+		uint64 last_prefix_n_recs = 0;
+		uint64 first_prefix_n_recs = 0;
+
+		uint64 out_pos = out_start;
+		vector<uint64> hashes;
+		vector<uint64>* hashes_ptr = store_hashes ? &hashes : nullptr;
+
+		// Filter and store a k-mer with all its occurrences counted, records of the first and last prefix
+		// can be shared with other threads, so they are added to lut by lut_updater
+		auto compact_kmer = [&](CKmer<SIZE>& kmer, uint32 count) {
+			n_total += count;
+			++n_unique;
+			uint64 hash = 0;
+			// k-mers below cutoff_min are not hashed
+			if (count < cutoff_min || !fmh_admissible<SCALED>(kmer, kmer_len, seed, threshold, hash))
+				n_cutoff_min++;
+			else if (count > cutoff_max)
+				n_cutoff_max++;
+			else
+			{
+				if (count > counter_max)
+					count = counter_max;
+
+				if (OUTPUT == CompactOutput::kmc)
+				{
+					uint64 prefix = kmer.remove_suffix(suffix_len_bits);
+					if (prefix == last_prefix)
+						++last_prefix_n_recs;
+					else if (prefix == first_prefix)
+						++first_prefix_n_recs;
+					else
+						++lut[prefix];
+				}
+				store_compacted_kmer<OUTPUT, COUNTER_SIZE>(out_buffer, out_pos, kmer, (uint32)kmer_bytes, count);
+				store_kmer_hash<OUTPUT, SCALED>(hashes_ptr, kmer, kmer_len, seed, hash);
+			}
+		};
 
 		CKmer<SIZE> kmer, next_kmer;
 		kmer.clear();
 		next_kmer.clear();
 		uint32 count;
 
-
-		uint64 out_pos = out_start;
-
 		//first
 		if (kxmer_set.get_min(counter_pos, kmer))
 		{
@@ -534,120 +476,24 @@ public:
 					count += kxmer_counters[counter_pos];
 				else
 				{
-					//MRH start
-					std::string str_rep = kmer.get_string_representation(kmer_len);
-					uint64_t hash_values[2] = {0};
-					MurmurHash3_x64_128 ( str_rep.c_str(), kmer_len, seed, hash_values );
-					//MRH end
-
-					n_total += count;
-					++n_unique;
-					if (count < cutoff_min || hash_values[0] >= threshold)
-						n_cutoff_min++;
-					else if (count > cutoff_max)
-						n_cutoff_max++;
-					else
-					{
-						if (count > counter_max)
-							count = counter_max;
-
-						if (!without_output)
-						{
-							if (output_type == OutputType::KMC)
-							{
-								uint64 prefix = kmer.remove_suffix(suffix_len_bits);
-								if (prefix == last_prefix)
-									++last_prefix_n_recs;
-								else if (prefix == first_prefix)
-									++first_prefix_n_recs;
-								else
-									++lut[prefix];
-
-								for (int32 j = (int32)kmer_bytes - 1; j >= 0; --j)
-									out_buffer[out_pos++] = kmer.get_byte(j);
-								for (int32 j = 0; j < (int32)counter_size; ++j)
-									out_buffer[out_pos++] = (count >> (j * 8)) & 0xFF;
-							}
-							else if (output_type == OutputType::KFF)
-							{
-								for (int32 j = (int32)kmer_bytes - 1; j >= 0; --j)
-									out_buffer[out_pos++] = kmer.get_byte(j);
-
-								for (int32 j = (int32)counter_size - 1; j >= 0; --j)
-									out_buffer[out_pos++] = (count >> (j * 8)) & 0xFF;
-							}
-							else
-							{
-								std::ostringstream ostr;
-								ostr << "Error: not implemented, plase contact authors showing this message" << __FILE__ << "\t" << __LINE__;
-								CCriticalErrorHandler::Inst().HandleCriticalError(ostr.str());
-							}
-						}
-					}
+					compact_kmer(kmer, count);
 					count = kxmer_counters[counter_pos];
 					kmer = next_kmer;
 				}
 			}
 			//last one
-			++n_unique;
-			n_total += count;
+			compact_kmer(kmer, count);
 
-			//MRH start
-			std::string str_rep = kmer.get_string_representation(kmer_len);
-			uint64_t hash_values[2] = {0};
-			MurmurHash3_x64_128 ( str_rep.c_str(), kmer_len, seed, hash_values );
-			//MRH end
-
-			if (count < cutoff_min || hash_values[0] >= threshold)
-				n_cutoff_min++;
-			else if (count > cutoff_max)
-				n_cutoff_max++;
-			else
+			if (OUTPUT != CompactOutput::none)
 			{
-				if (count > counter_max)
-					count = counter_max;
-
-				if (!without_output)
-				{
-					if (output_type == OutputType::KMC)
-					{
-						uint64 prefix = kmer.remove_suffix(suffix_len_bits);
-						if (prefix == last_prefix)
-							++last_prefix_n_recs;
-						else if (prefix == first_prefix)
-							++first_prefix_n_recs;
-						else
-							++lut[prefix];
-
-						for (int32 j = (int32)kmer_bytes - 1; j >= 0; --j)
-							out_buffer[out_pos++] = kmer.get_byte(j);
-						for (int32 j = 0; j < (int32)counter_size; ++j)
-							out_buffer[out_pos++] = (count >> (j * 8)) & 0xFF;
-					}
-					else if (output_type == OutputType::KFF)
-					{
-						for (int32 j = (int32)kmer_bytes - 1; j >= 0; --j)
-							out_buffer[out_pos++] = kmer.get_byte(j);
-
-						for (int32 j = (int32)counter_size - 1; j >= 0; --j)
-							out_buffer[out_pos++] = (count >> (j * 8)) & 0xFF;
-					}
-					else
-					{
-						std::ostringstream ostr;
-						ostr << "Error: not implemented, plase contact authors showing this message" << __FILE__ << "\t" << __LINE__;
-						CCriticalErrorHandler::Inst().HandleCriticalError(ostr.str());
-					}
-				}
-			}
-			if (!without_output)
-			{
-				if(output_type == OutputType::KMC)
+				if (OUTPUT == CompactOutput::kmc)
 				{
 					lut_updater.UpdateLut(last_prefix, last_prefix_n_recs);
 					lut_updater.UpdateLut(first_prefix, first_prefix_n_recs);
 				}
 				packs.emplace_back(out_start, out_pos);
+				if (hashes_ptr)
+					hash_packs.emplace_back(out_start, std::move(hashes));
 			}
 		}
 	}
@@ -668,7 +514,8 @@ public:
 		bool without_output,
 		OutputType output_type,
 		uint32 seed,
-		uint32 scaled)
+		uint32 scaled,
+		bool store_hashes)
 			:
 		sub_array_descs(sub_array_descs),
 		sub_array_desc_generator(sub_array_desc_generator),
@@ -685,7 +532,8 @@ public:
 		lut_prefix_len(lut_prefix_len),
 		out_buffer(out_buffer),
 		without_output(without_output),
-		output_type(output_type)
+		output_type(output_type),
+		store_hashes(store_hashes)
 	{
 		this->seed = seed;
 		this->scaled = scaled;
@@ -710,6 +558,11 @@ public:
 	{
 		return packs;
 	}
+
+	list<pair<uint64, vector<uint64>>>& GetHashPacks()
+	{
+		return hash_packs;
+	}
 };
 
 template<unsigned SIZE>
@@ -738,6 +591,8 @@ class CKXmerSetMultiThreaded
 	uint32_t scaled = 1;
 
 	list<pair<uint64, uint64>> output_packs_desc;
+	bool store_hashes;
+	vector<uint64> hashes;
 
 public:
 	CKXmerSetMultiThreaded(CKmer<SIZE>* buffer,
@@ -752,7 +607,8 @@ public:
 		uchar* out_buffer,
 		uint32 n_threads,
 		uint32 seed,
-		uint32 scaled)
+		uint32 scaled,
+		bool store_hashes)
 			:
 		buffer(buffer),
 		kxmer_counters(kxmer_counters),
@@ -764,7 +620,8 @@ public:
 		lut_prefix_len(lut_prefix_len),
 		lut(lut),
 		out_buffer(out_buffer),
-		n_threads(n_threads)
+		n_threads(n_threads),
+		store_hashes(store_hashes)
 	{
 		this->seed = seed;
 		this->scaled = scaled;
@@ -789,7 +646,7 @@ public:
 		for (uint32 i = 0; i < n_threads; ++i)
 		{
 			mergers.push_back(std::make_unique<CKXmerMerger<SIZE>>(sub_array_descs, sub_array_desc_generator, lut_updater, buffer, kxmer_counters, cutoff_min,
-				cutoff_max, counter_max, kmer_len, lut, counter_size, lut_prefix_len, out_buffer, without_output, output_type, seed, scaled));
+				cutoff_max, counter_max, kmer_len, lut, counter_size, lut_prefix_len, out_buffer, without_output, output_type, seed, scaled, store_hashes));
 			threads.emplace_back(ref(*mergers.back()));
 		}
 
@@ -800,9 +657,11 @@ public:
 		uint64 tmp_n_cutoff_min = 0;
 		uint64 tmp_n_cutoff_max = 0;
 		uint64 tmp_n_total = 0;
+		list<pair<uint64, vector<uint64>>> hash_packs;
 
 		for (auto& ptr : mergers)
 		{
+			hash_packs.splice(hash_packs.end(), ptr->GetHashPacks());
 			ptr->GetStats(tmp_n_unique, tmp_n_cutoff_min, tmp_n_cutoff_max, tmp_n_total);
 			output_packs_desc.splice(output_packs_desc.end(), move(ptr->GetPacks()));
 			n_unique += tmp_n_unique;
@@ -814,6 +673,11 @@ public:
 		for (auto& ptr : mergers)
 			ptr.reset();
 		output_packs_desc.sort([](const pair<uint64, uint64>& e1, const pair<uint64, uint64>& e2){return e1.first < e2.first; });
+
+		// hashes in the order of records, i.e. of packs
+		hash_packs.sort([](const pair<uint64, vector<uint64>>& e1, const pair<uint64, vector<uint64>>& e2){return e1.first < e2.first; });
+		for (auto& e : hash_packs)
+			hashes.insert(hashes.end(), e.second.begin(), e.second.end());
 	}
 
 	void GetStats(uint64& _n_unique, uint64& _n_cutoff_min, uint64& _n_cutoff_max, uint64& _n_total)
@@ -828,6 +692,11 @@ public:
 	{
 		return output_packs_desc;
 	}
+
+	vector<uint64>& GetHashes()
+	{
+		return hashes;
+	}
 };
 
 #endif
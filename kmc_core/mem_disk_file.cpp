@@ -11,6 +11,9 @@
 #include "mem_disk_file.h"
 #include "critical_error_handler.h"
 #include <sstream>
+#ifndef _WIN32
+#include <fcntl.h>
+#endif
 using namespace std;
 
 //----------------------------------------------------------------------------------
@@ -56,6 +59,19 @@ void CMemDiskFile::Rewind()
 	}
 }
 
+//----------------------------------------------------------------------------------
+// Hint the OS to start reading the whole file in background, so that a following Read
+// is served from the page cache instead of stalling on the disk
+void CMemDiskFile::Prefetch()
+{
+	if (memory_mode || !file)
+		return;
+#ifndef _WIN32
+	posix_fadvise(fileno(file), 0, 0, POSIX_FADV_SEQUENTIAL);
+	posix_fadvise(fileno(file), 0, 0, POSIX_FADV_WILLNEED);
+#endif
+}
+
 //----------------------------------------------------------------------------------
 int CMemDiskFile::Close()
 {
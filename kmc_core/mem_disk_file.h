@@ -34,6 +34,7 @@ public:
 	CMemDiskFile(bool _memory_mode);
 	void Open(const string& f_name);
 	void Rewind();
+	void Prefetch();
 	int Close();
 	size_t Read(uchar * ptr, size_t size, size_t count);
 	size_t Write(const uchar * ptr, size_t size, size_t count);
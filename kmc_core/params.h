@@ -41,6 +41,7 @@ struct CKMCParams {
 
 	string json_summary_file_name = "";
 	bool without_output = false;
+	bool store_hashes = false;			// store MurmurHash3 of each k-mer in .kmc_hash file
 
 	uint32 lut_prefix_len;
 
@@ -103,6 +104,8 @@ struct CKMCParams {
 	uint32_t scaled;
 	uint32_t seed;
 
+	std::string trace_file_name;
+
 	KMC::EstimateHistogramCfg estimateHistogramCfg = KMC::EstimateHistogramCfg::DONT_ESTIMATE;
 	//params for strict memory mode
 	int sm_n_uncompactors;
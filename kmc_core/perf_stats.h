@@ -0,0 +1,392 @@
+/*
+  This file is a part of KMC software distributed under GNU GPL 3 licence.
+  The homepage of the KMC project is http://sun.aei.polsl.pl/kmc
+
+  Authors: Sebastian Deorowicz, Agnieszka Debudaj-Grabysz, Marek Kokot
+
+  Version: 3.2.2
+  Date   : 2023-03-10
+*/
+
+#ifndef _PERF_STATS_H
+#define _PERF_STATS_H
+
+#include "defs.h"
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <string>
+#include <cstdio>
+#include <atomic>
+
+//************************************************************************************************************
+// Per-thread counters of the pipeline workers. Each worker owns its CPerfThreadStats (on its stack), so the
+// counters are updated without atomics. Waits on queues and memory pools are timed only if the thread really
+// blocks. When the worker finishes, its counters are moved to CPerfStatsCollector.
+// If tracing is enabled, each worker also records timed events (parts, bins, sort steps, waits) in its own
+// ring buffer, and the buffers are saved as a Chrome trace event file (chrome://tracing, Perfetto).
+//************************************************************************************************************
+enum class PerfPhase { binary_reader, fastq_reader, splitter, bin_storer, bin_reader, bin_sorter, bin_completer };
+
+inline const char* perf_phase_name(PerfPhase phase)
+{
+	switch (phase)
+	{
+	case PerfPhase::binary_reader:	return "binary_reader";
+	case PerfPhase::fastq_reader:	return "fastq_reader";
+	case PerfPhase::splitter:		return "splitter";
+	case PerfPhase::bin_storer:		return "bin_storer";
+	case PerfPhase::bin_reader:		return "bin_reader";
+	case PerfPhase::bin_sorter:		return "bin_sorter";
+	case PerfPhase::bin_completer:	return "bin_completer";
+	}
+	return "unknown";
+}
+
+// idle - waiting for input (pop from empty queue), blocked - waiting for memory or for other threads to proceed
+enum class PerfWait { idle, blocked };
+
+// Steps of processing a bin by CKmerBinSorter (compact includes merging of k+x-mers and hashing of k-mers)
+enum class PerfStep { expand, sort, compact, no_steps };
+
+inline const char* perf_step_name(PerfStep step)
+{
+	switch (step)
+	{
+	case PerfStep::expand:	return "expand";
+	case PerfStep::sort:	return "sort";
+	case PerfStep::compact:	return "compact";
+	default:				return "unknown";
+	}
+}
+
+struct CPerfCounters
+{
+	uint64 bytes = 0;
+	uint64 records = 0;
+	uint64 wall_ns = 0;
+	uint64 idle_ns = 0;
+	uint64 blocked_ns = 0;
+	uint64 n_idle_waits = 0;
+	uint64 n_blocked_waits = 0;
+	uint64 step_ns[(int)PerfStep::no_steps] = {};
+
+	uint64 busy_ns() const
+	{
+		return wall_ns > idle_ns + blocked_ns ? wall_ns - idle_ns - blocked_ns : 0;
+	}
+};
+
+struct CPerfThreadRecord
+{
+	PerfPhase phase;
+	uint32 thread_no;
+	CPerfCounters counters;
+};
+
+// Complete event: name and arg_name must be string literals, times are relative to the start of tracing
+struct CTraceEvent
+{
+	const char* name;
+	const char* arg_name;
+	int64 arg;
+	uint64 start_ns;
+	uint64 dur_ns;
+};
+
+//----------------------------------------------------------------------------------
+// Events of a single thread, the oldest events are overwritten when the buffer is full
+class CTraceBuffer
+{
+	static const uint32 MAX_EVENTS = 1 << 18;
+	std::vector<CTraceEvent> events;
+	uint64 n_recorded = 0;
+public:
+	void Add(const CTraceEvent& event)
+	{
+		if (events.size() < MAX_EVENTS)
+			events.push_back(event);
+		else
+			events[n_recorded % MAX_EVENTS] = event;
+		++n_recorded;
+	}
+
+	uint64 NDropped() const
+	{
+		return n_recorded - events.size();
+	}
+
+	template<typename Fun> void ForEach(Fun fun) const
+	{
+		if (events.empty())
+			return;
+		uint64 first = n_recorded % events.size();
+		for (uint64 i = 0; i < events.size(); ++i)
+			fun(events[(first + i) % events.size()]);
+	}
+};
+
+//----------------------------------------------------------------------------------
+class CPerfStatsCollector
+{
+	std::mutex mtx;
+	std::vector<CPerfThreadRecord> records;
+
+	// read by workers while the main thread enables or disables tracing; trace_start is set before workers start
+	std::atomic<bool> trace_enabled{ false };
+	std::chrono::steady_clock::time_point trace_start;
+	std::vector<std::pair<std::string, std::unique_ptr<CTraceBuffer>>> traces;
+public:
+	static CPerfStatsCollector& Inst()
+	{
+		static CPerfStatsCollector inst;
+		return inst;
+	}
+
+	void Add(PerfPhase phase, const CPerfCounters& counters, std::unique_ptr<CTraceBuffer> trace)
+	{
+		std::lock_guard<std::mutex> lck(mtx);
+		uint32 thread_no = 0;
+		for (auto& rec : records)
+			if (rec.phase == phase)
+				++thread_no;
+		records.push_back({ phase, thread_no, counters });
+		if (trace)
+			traces.emplace_back(perf_phase_name(phase) + std::string(" ") + std::to_string(thread_no), std::move(trace));
+	}
+
+	// Must be called before workers are started, events of all workers started later are kept until SaveTrace
+	void EnableTrace()
+	{
+		std::lock_guard<std::mutex> lck(mtx);
+		trace_enabled.store(true, std::memory_order_relaxed);
+		trace_start = std::chrono::steady_clock::now();
+		traces.clear();
+	}
+
+	// Stop tracing and drop collected events, e.g. when the run failed or the next one is not traced
+	void DisableTrace()
+	{
+		std::lock_guard<std::mutex> lck(mtx);
+		trace_enabled.store(false, std::memory_order_relaxed);
+		traces.clear();
+	}
+
+	bool TraceEnabled() const
+	{
+		return trace_enabled.load(std::memory_order_relaxed);
+	}
+
+	std::chrono::steady_clock::time_point TraceStart() const
+	{
+		return trace_start;
+	}
+
+	// Save events in Chrome trace event format and stop tracing
+	bool SaveTrace(const std::string& file_name)
+	{
+		std::lock_guard<std::mutex> lck(mtx);
+		trace_enabled.store(false, std::memory_order_relaxed);
+		FILE* out = fopen(file_name.c_str(), "w");
+		if (!out)
+			return false;
+		fprintf(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+		fprintf(out, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"kmc\"}}");
+		for (uint32 tid = 0; tid < traces.size(); ++tid)
+		{
+			auto& trace = *traces[tid].second;
+			fprintf(out, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"%s\", \"dropped_events\": %llu}}",
+				tid, traces[tid].first.c_str(), (unsigned long long)trace.NDropped());
+			trace.ForEach([out, tid](const CTraceEvent& e) {
+				fprintf(out, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f", e.name, tid, e.start_ns / 1e3, e.dur_ns / 1e3);
+				if (e.arg_name)
+					fprintf(out, ", \"args\": {\"%s\": %lld}", e.arg_name, (long long)e.arg);
+				fprintf(out, "}");
+			});
+		}
+		fprintf(out, "\n]}\n");
+		traces.clear();
+		return fclose(out) == 0;
+	}
+
+	// Get records of all finished workers and start collecting from scratch
+	std::vector<CPerfThreadRecord> Take()
+	{
+		std::lock_guard<std::mutex> lck(mtx);
+		std::vector<CPerfThreadRecord> res;
+		res.swap(records);
+		return res;
+	}
+};
+
+//----------------------------------------------------------------------------------
+class CPerfThreadStats
+{
+	using clock = std::chrono::steady_clock;
+
+	PerfPhase phase;
+	CPerfCounters counters;
+	clock::time_point start;
+	CPerfThreadStats* prev;
+	PerfStep step = PerfStep::no_steps;
+	clock::time_point step_start;
+	std::unique_ptr<CTraceBuffer> trace;
+	clock::time_point trace_start;
+
+	static CPerfThreadStats*& current()
+	{
+		static thread_local CPerfThreadStats* inst = nullptr;
+		return inst;
+	}
+
+public:
+	explicit CPerfThreadStats(PerfPhase phase) : phase(phase), start(clock::now()), prev(current())
+	{
+		current() = this;
+		auto& collector = CPerfStatsCollector::Inst();
+		if (collector.TraceEnabled())
+		{
+			trace = std::make_unique<CTraceBuffer>();
+			trace_start = collector.TraceStart();
+		}
+	}
+
+	~CPerfThreadStats()
+	{
+		counters.wall_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count();
+		current() = prev;
+		CPerfStatsCollector::Inst().Add(phase, counters, std::move(trace));
+	}
+
+	CPerfThreadStats(const CPerfThreadStats&) = delete;
+	CPerfThreadStats& operator=(const CPerfThreadStats&) = delete;
+
+	// Stats of the worker running in the calling thread (nullptr for not instrumented threads)
+	static CPerfThreadStats* Current()
+	{
+		return current();
+	}
+
+	void AddBytes(uint64 n)
+	{
+		counters.bytes += n;
+	}
+
+	void AddRecords(uint64 n)
+	{
+		counters.records += n;
+	}
+
+	// Finish the current step (if any) and start the next one
+	void StartStep(PerfStep next)
+	{
+		auto now = clock::now();
+		if (step != PerfStep::no_steps)
+		{
+			counters.step_ns[(int)step] += std::chrono::duration_cast<std::chrono::nanoseconds>(now - step_start).count();
+			TraceEvent(perf_step_name(step), step_start, now);
+		}
+		step = next;
+		step_start = now;
+	}
+
+	void EndStep()
+	{
+		StartStep(PerfStep::no_steps);
+	}
+
+	bool Tracing() const
+	{
+		return trace != nullptr;
+	}
+
+	void TraceEvent(const char* name, clock::time_point event_start, clock::time_point event_end, const char* arg_name = nullptr, int64 arg = 0)
+	{
+		if (!trace)
+			return;
+		trace->Add({ name, arg_name, arg,
+			(uint64)std::chrono::duration_cast<std::chrono::nanoseconds>(event_start - trace_start).count(),
+			(uint64)std::chrono::duration_cast<std::chrono::nanoseconds>(event_end - event_start).count() });
+	}
+
+	void AddWait(PerfWait kind, uint64 ns)
+	{
+		if (kind == PerfWait::idle)
+		{
+			counters.idle_ns += ns;
+			++counters.n_idle_waits;
+		}
+		else
+		{
+			counters.blocked_ns += ns;
+			++counters.n_blocked_waits;
+		}
+	}
+};
+
+//----------------------------------------------------------------------------------
+// cv.wait(lck, predicate) that adds the waiting time to the stats of the calling thread.
+// The clock is read only when the predicate does not hold at the first check.
+template<typename CV, typename Predicate>
+void perf_wait(CV& cv, std::unique_lock<std::mutex>& lck, Predicate&& predicate, PerfWait kind)
+{
+	bool waited = false;
+	std::chrono::steady_clock::time_point wait_start;
+	cv.wait(lck, [&] {
+		if (predicate())
+			return true;
+		if (!waited)
+		{
+			waited = true;
+			wait_start = std::chrono::steady_clock::now();
+		}
+		return false;
+	});
+	if (waited)
+		if (auto stats = CPerfThreadStats::Current())
+		{
+			auto wait_end = std::chrono::steady_clock::now();
+			stats->AddWait(kind, std::chrono::duration_cast<std::chrono::nanoseconds>(wait_end - wait_start).count());
+			stats->TraceEvent(kind == PerfWait::idle ? "idle" : "blocked", wait_start, wait_end);
+		}
+}
+
+//----------------------------------------------------------------------------------
+// Trace event covering the lifetime of the object, nothing is done if the calling thread does not trace
+class CPerfTraceScope
+{
+	CPerfThreadStats* stats;
+	const char* name;
+	const char* arg_name;
+	int64 arg;
+	std::chrono::steady_clock::time_point start;
+public:
+	CPerfTraceScope(const char* name, const char* arg_name = nullptr, int64 arg = 0) :
+		stats(CPerfThreadStats::Current()), name(name), arg_name(arg_name), arg(arg)
+	{
+		if (stats && !stats->Tracing())
+			stats = nullptr;
+		if (stats)
+			start = std::chrono::steady_clock::now();
+	}
+
+	void SetArg(const char* arg_name, int64 arg)
+	{
+		this->arg_name = arg_name;
+		this->arg = arg;
+	}
+
+	~CPerfTraceScope()
+	{
+		if (stats)
+			stats->TraceEvent(name, start, std::chrono::steady_clock::now(), arg_name, arg);
+	}
+
+	CPerfTraceScope(const CPerfTraceScope&) = delete;
+	CPerfTraceScope& operator=(const CPerfTraceScope&) = delete;
+};
+
+#endif
+
+// ***** EOF
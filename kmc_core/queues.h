@@ -15,12 +15,14 @@
 #include <stdio.h>
 #include <tuple>
 #include <queue>
+#include <deque>
 #include <list>
 #include <set>
 #include <map>
 #include <string>
 #include "mem_disk_file.h"
 #include "critical_error_handler.h"
+#include "perf_stats.h"
 #include "thread_cancellation_exception.h"
 #include <cassert>
 #include <thread>
@@ -69,7 +71,7 @@ public:
 	bool pop(uchar* &data, uint64 &size, FilePart &file_part, CompressionType &mode)
 	{
 		std::unique_lock<std::mutex> lck(mtx);
-		cv_pop.wait(lck, [this]{return !q.empty() || completed; });
+		perf_wait(cv_pop, lck, [this]{return !q.empty() || completed; }, PerfWait::idle);
 
 		if (q.empty())
 			return false;
@@ -86,7 +88,7 @@ public:
 	bool peek_next_pack(uchar* &data, uint64 &size)
 	{
 		std::unique_lock<std::mutex> lck(mtx);
-		cv_pop.wait(lck, [this] {return !q.empty() || completed; });
+		perf_wait(cv_pop, lck, [this] {return !q.empty() || completed; }, PerfWait::idle);
 		if (q.empty())
 			return false;
 		data = get<0>(q.front());
@@ -97,7 +99,7 @@ public:
 	bool is_next_last()
 	{
 		std::unique_lock<std::mutex> lck(mtx);
-		cv_pop.wait(lck, [this]{return !q.empty() || completed; });
+		perf_wait(cv_pop, lck, [this]{return !q.empty() || completed; }, PerfWait::idle);
 		if (q.empty())
 			return true;
 		return get<2>(q.front()) == FilePart::End;
@@ -191,7 +193,7 @@ public:
 class CPartQueue
 {
 	typedef tuple<uchar *, uint64, ReadType> elem_t;
-	typedef queue<elem_t, list<elem_t>> queue_t;
+	typedef queue<elem_t, deque<elem_t>> queue_t;
 
 	queue_t q;
 	bool is_completed;
@@ -237,7 +239,7 @@ public:
 
 	bool pop(uchar *&part, uint64 &size, ReadType& read_type) {
 		unique_lock<mutex> lck(mtx);
-		cv_pop.wait(lck, [this]{return !this->q.empty() || !this->n_readers; });
+		perf_wait(cv_pop, lck, [this]{return !this->q.empty() || !this->n_readers; }, PerfWait::idle);
 
 		if (q.empty())
 			return false;
@@ -252,7 +254,7 @@ public:
 class CStatsPartQueue
 {
 	typedef tuple<uchar *, uint64, ReadType> elem_t;
-	typedef queue<elem_t, list<elem_t>> queue_t;
+	typedef queue<elem_t, deque<elem_t>> queue_t;
 
 	queue_t q;
 
@@ -260,6 +262,7 @@ class CStatsPartQueue
 	CThrowingOnCancelConditionVariable cv_pop;
 	int n_readers;
 	int64 bytes_to_read;
+	uint64 bytes_pushed = 0;
 
 public:
 	CStatsPartQueue(int _n_readers, int64 _bytes_to_read)
@@ -290,6 +293,7 @@ public:
 		bool was_empty = q.empty();
 		q.push(make_tuple(part, size, read_type));
 		bytes_to_read -= size;
+		bytes_pushed += size;
 		if (was_empty)
 			cv_pop.notify_one();
 
@@ -298,7 +302,7 @@ public:
 
 	bool pop(uchar *&part, uint64 &size, ReadType& read_type) {
 		unique_lock<mutex> lck(mtx);
-		cv_pop.wait(lck, [this]{return !this->q.empty() || !this->n_readers; });
+		perf_wait(cv_pop, lck, [this]{return !this->q.empty() || !this->n_readers; }, PerfWait::idle);
 
 		if (q.empty())
 			return false;
@@ -308,13 +312,19 @@ public:
 
 		return true;
 	}
+
+	// Size of the sample (input data used for stats)
+	uint64 get_bytes_pushed() const {
+		lock_guard<mutex> lck(mtx);
+		return bytes_pushed;
+	}
 };
 
 //************************************************************************************************************
 class CBinPartQueue
 {
 	typedef tuple<int32, uchar *, uint32, uint32, list<pair<uint64, uint64>>> elem_t;
-	typedef queue<elem_t, list<elem_t>> queue_t;
+	typedef queue<elem_t, deque<elem_t>> queue_t;
 	queue_t q;
 
 	int n_writers;
@@ -356,7 +366,7 @@ public:
 	}
 	bool pop(int32 &bin_id, uchar *&part, uint32 &true_size, uint32 &alloc_size, list<pair<uint64, uint64>>& expander_parts) {
 		unique_lock<mutex> lck(mtx);
-		cv_pop.wait(lck, [this]{return !q.empty() || !n_writers; });
+		perf_wait(cv_pop, lck, [this]{return !q.empty() || !n_writers; }, PerfWait::idle);
 
 		if(q.empty())
 			return false;
@@ -496,6 +506,14 @@ public:
 		return res;
 	}
 
+	uint64 get_n_plus_x_recs_sum()
+	{
+		uint64 res = 0;
+		for (auto& e : m)
+			res += e.second.n_plus_x_recs;
+		return res;
+	}
+
 	vector<pair<int32, int64>> get_sorted_req_sizes(uint32 max_x, const uint64 size_of_kmer_t, uint32 cutoff_min, int64 cutoff_max, int64 counter_max, uint32 lut_prefix_len)
 	{
 		lock_guard<mutex> lck(mtx);
@@ -569,6 +587,22 @@ public:
 			return -1000;
 		return sorted_bins[bin_id];
 	}
+	// Id of the bin that will be returned by the next call of get_next_sort_bin (without advancing)
+	int32 peek_next_sort_bin()
+	{
+		lock_guard<mutex> lck(mtx);
+		int32 next_bin_id = bin_id + 1;
+		if (next_bin_id >= (int32)m.size())
+			return -1000;
+		return sorted_bins[next_bin_id];
+	}
+	CMemDiskFile* get_file(int32 bin_id)
+	{
+		lock_guard<mutex> lck(mtx);
+		auto p = m.find(bin_id);
+		assert(p != m.end());
+		return p->second.file;
+	}
 	void init_random()
 	{
 		lock_guard<mutex> lck(mtx);
@@ -682,7 +716,7 @@ public:
 class CBinQueue
 {
 	typedef tuple<int32, uchar *, uint64, uint64> elem_t;
-	typedef queue<elem_t, list<elem_t>> queue_t;
+	typedef queue<elem_t, deque<elem_t>> queue_t;
 	queue_t q;
 
 	int n_writers;
@@ -717,6 +751,13 @@ public:
 		if(was_empty)
 			cv_pop.notify_all();
 	}
+	// Returns true if no more bins will be pushed; n_left is the number of bins still in the queue
+	bool all_pushed(uint64& n_left)
+	{
+		lock_guard<mutex> lck(mtx);
+		n_left = q.size();
+		return !n_writers;
+	}
 	int32 top_bin_id()
 	{
 		unique_lock<mutex> lck(mtx);
@@ -726,7 +767,7 @@ public:
 	bool pop(int32 &bin_id, uchar *&part, uint64 &size, uint64 &n_rec, bool& is_allowed, const set<int>& allowed) {
 		unique_lock<mutex> lck(mtx);
 
-		cv_pop.wait(lck, [this]{return !q.empty() || !n_writers; });
+		perf_wait(cv_pop, lck, [this]{return !q.empty() || !n_writers; }, PerfWait::idle);
 
 		if (q.empty())
 			return false;
@@ -767,7 +808,7 @@ public:
 	bool pop(int32 &bin_id, uchar *&part, uint64 &size, uint64 &n_rec) {
 		unique_lock<mutex> lck(mtx);
 
-		cv_pop.wait(lck, [this]{return !q.empty() || !n_writers; });
+		perf_wait(cv_pop, lck, [this]{return !q.empty() || !n_writers; }, PerfWait::idle);
 
 		if(q.empty())
 			return false;
@@ -785,7 +826,7 @@ public:
 //************************************************************************************************************
 class CKmerQueue
 {
-	typedef tuple<int32, uchar*, list<pair<uint64, uint64>>, uchar*, uint64, uint64, uint64, uint64, uint64> data_t;
+	typedef tuple<int32, uchar*, list<pair<uint64, uint64>>, uchar*, uint64, uint64, uint64, uint64, uint64, vector<uint64>> data_t;
 	typedef list<data_t> list_t;
 	int n_writers;
 private:
@@ -823,14 +864,15 @@ public:
 		n_writers += n;
 	}
 
-	void push(int32 bin_id, uchar *data, list<pair<uint64, uint64>> data_packs, uchar *lut, uint64 lut_size, uint64 n_unique, uint64 n_cutoff_min, uint64 n_cutoff_max, uint64 n_total) {
+	// hashes of k-mers in the order of records (only with -hash)
+	void push(int32 bin_id, uchar *data, list<pair<uint64, uint64>> data_packs, uchar *lut, uint64 lut_size, uint64 n_unique, uint64 n_cutoff_min, uint64 n_cutoff_max, uint64 n_total, vector<uint64> hashes) {
 		lock_guard<mutex> lck(mtx);
-		l.push_back(std::make_tuple(bin_id, data, std::move(data_packs), lut, lut_size, n_unique, n_cutoff_min, n_cutoff_max, n_total));
+		l.push_back(std::make_tuple(bin_id, data, std::move(data_packs), lut, lut_size, n_unique, n_cutoff_min, n_cutoff_max, n_total, std::move(hashes)));
 		cv_pop.notify_all();
 	}
-	bool pop(int32 &bin_id, uchar *&data, list<pair<uint64, uint64>>& data_packs, uchar *&lut, uint64 &lut_size, uint64 &n_unique, uint64 &n_cutoff_min, uint64 &n_cutoff_max, uint64 &n_total) {
+	bool pop(int32 &bin_id, uchar *&data, list<pair<uint64, uint64>>& data_packs, uchar *&lut, uint64 &lut_size, uint64 &n_unique, uint64 &n_cutoff_min, uint64 &n_cutoff_max, uint64 &n_total, vector<uint64>& hashes) {
 		unique_lock<mutex> lck(mtx);
-		cv_pop.wait(lck, [this]{return !l.empty() || !n_writers; });
+		perf_wait(cv_pop, lck, [this]{return !l.empty() || !n_writers; }, PerfWait::idle);
 
 		if (l.empty())
 			return false;
@@ -844,6 +886,7 @@ public:
 		n_cutoff_min = get<6>(l.front());
 		n_cutoff_max = get<7>(l.front());
 		n_total = get<8>(l.front());
+		hashes = std::move(get<9>(l.front()));
 
 		l.pop_front();
 
@@ -861,12 +904,37 @@ protected:
 	int64 part_size;
 	int64 n_parts_total;
 	int64 n_parts_free;
+	uint32 n_waiting = 0;
+	// A freed part lets exactly one thread waiting in reserve() proceed, so one is woken. Pools whose waiters
+	// wait for different conditions (e.g. the order of BAM parts) must wake all of them
+	bool notify_all_on_free = false;
 
 	uchar *buffer, *raw_buffer;
 	uint32 *stack;
 
 	mutable mutex mtx;							// The mutex to synchronise on
 	CThrowingOnCancelConditionVariable cv;		// The condition to wait for
+
+	// Wait until the predicate holds; waiting threads are counted, so free() notifies only if somebody waits
+	template<typename Predicate> void wait_for_parts(unique_lock<mutex>& lck, Predicate predicate)
+	{
+		if (predicate())
+			return;
+		++n_waiting;
+		perf_wait(cv, lck, predicate, PerfWait::blocked);
+		--n_waiting;
+	}
+
+	void notify_waiting()
+	{
+		if (!n_waiting)
+			return;
+		if (notify_all_on_free)
+			cv.notify_all();
+		else
+			cv.notify_one();
+	}
+
 public:
 	CMemoryPool(int64 _total_size, int64 _part_size) {
 		raw_buffer = nullptr;
@@ -912,7 +980,7 @@ public:
 	void reserve(uchar* &part)
 	{
 		unique_lock<mutex> lck(mtx);
-		cv.wait(lck, [this]{return n_parts_free > 0; });
+		wait_for_parts(lck, [this] {return n_parts_free > 0; });
 
 		part = buffer + stack[--n_parts_free]*part_size;
 	}
@@ -920,7 +988,7 @@ public:
 	void reserve(char* &part)
 	{
 		unique_lock<mutex> lck(mtx);
-		cv.wait(lck, [this] {return n_parts_free > 0; });
+		wait_for_parts(lck, [this] {return n_parts_free > 0; });
 
 		part = (char*) (buffer + stack[--n_parts_free]*part_size);
 	}
@@ -928,7 +996,7 @@ public:
 	void reserve(uint32* &part)
 	{
 		unique_lock<mutex> lck(mtx);
-		cv.wait(lck, [this] {return n_parts_free > 0; });
+		wait_for_parts(lck, [this] {return n_parts_free > 0; });
 
 		part = (uint32*) (buffer + stack[--n_parts_free]*part_size);
 	}
@@ -936,7 +1004,7 @@ public:
 	void reserve(uint64* &part)
 	{
 		unique_lock<mutex> lck(mtx);
-		cv.wait(lck, [this] {return n_parts_free > 0; });
+		wait_for_parts(lck, [this] {return n_parts_free > 0; });
 
 		part = (uint64*) (buffer + stack[--n_parts_free]*part_size);
 	}
@@ -944,7 +1012,7 @@ public:
 	void reserve(double* &part)
 	{
 		unique_lock<mutex> lck(mtx);
-		cv.wait(lck, [this] {return n_parts_free > 0; });
+		wait_for_parts(lck, [this] {return n_parts_free > 0; });
 
 		part = (double*) (buffer + stack[--n_parts_free]*part_size);
 	}
@@ -952,7 +1020,7 @@ public:
 	void reserve(float* &part)
 	{
 		unique_lock<mutex> lck(mtx);
-		cv.wait(lck, [this] {return n_parts_free > 0; });
+		wait_for_parts(lck, [this] {return n_parts_free > 0; });
 
 		part = (float*)(buffer + stack[--n_parts_free] * part_size);
 	}
@@ -964,7 +1032,7 @@ public:
 
 		stack[n_parts_free++] = (uint32) ((part - buffer) / part_size);
 		
-		cv.notify_all();
+		notify_waiting();
 	}
 	// Deallocate memory buffer - char*
 	void free(char* part)
@@ -972,7 +1040,7 @@ public:
 		lock_guard<mutex> lck(mtx);
 
 		stack[n_parts_free++] = (uint32) (((uchar*) part - buffer) / part_size);
-		cv.notify_all();
+		notify_waiting();
 	}
 	// Deallocate memory buffer - uint32*
 	void free(uint32* part)
@@ -980,7 +1048,7 @@ public:
 		lock_guard<mutex> lck(mtx);
 
 		stack[n_parts_free++] = (uint32) ((((uchar *) part) - buffer) / part_size);
-		cv.notify_all();
+		notify_waiting();
 	}
 	// Deallocate memory buffer - uint64*
 	void free(uint64* part)
@@ -988,7 +1056,7 @@ public:
 		lock_guard<mutex> lck(mtx);
 
 		stack[n_parts_free++] = (uint32) ((((uchar *) part) - buffer) / part_size);
-		cv.notify_all();
+		notify_waiting();
 	}
 	// Deallocate memory buffer - double*
 	void free(double* part)
@@ -996,7 +1064,7 @@ public:
 		lock_guard<mutex> lck(mtx);
 
 		stack[n_parts_free++] = (uint32) ((((uchar *) part) - buffer) / part_size);
-		cv.notify_all();
+		notify_waiting();
 	}
 	// Deallocate memory buffer - float*
 	void free(float* part)
@@ -1004,7 +1072,7 @@ public:
 		lock_guard<mutex> lck(mtx);
 
 		stack[n_parts_free++] = (uint32)((((uchar *)part) - buffer) / part_size);
-		cv.notify_all();
+		notify_waiting();
 	}
 };
 
@@ -1037,7 +1105,8 @@ public:
 	void bam_reserve_gunzip(uchar* &part, uint32_t id)
 	{
 		unique_lock<mutex> lck(mtx);
-		cv.wait(lck, [this, id] {
+		notify_all_on_free = true; // from now on threads may wait for parts for different ids
+		wait_for_parts(lck, [this, id] {
 			if (id == bam_current_id)
 				return n_parts_free > 1;
 			else
@@ -1181,7 +1250,7 @@ public:
 		uint64 last_found_pos;
 
 		// Look for space to insert
-		cv.wait(lck, [&]() -> bool{
+		perf_wait(cv, lck, [&]() -> bool{
 			found_pos = total_size;
 			uint64 prev_end_pos = 0;
 			for (auto &p : map_reserved)
@@ -1214,7 +1283,7 @@ public:
 			}
 
 			return false;
-		});
+		}, PerfWait::blocked);
 
 		// Reserve found free space
 		map_reserved[found_pos] = req_size;
@@ -1273,7 +1342,7 @@ public:
 		uint64 found_pos;
 
 		// Look for space to insert
-		cv.wait(lck, [&]() -> bool{
+		perf_wait(cv, lck, [&]() -> bool{
 			found_pos = total_size;
 			uint64 prev_end_pos = 0;
 
@@ -1328,7 +1397,7 @@ public:
 			}
 
 			return false;
-		});
+		}, PerfWait::blocked);
 
 		uchar *base_ptr = get<0>(bin_ptrs[bin_id]) = buffer + found_pos;
 
@@ -1404,7 +1473,7 @@ public:
 		// We have to extend the buffer
 		
 		// Look for space to insert
-		cv.wait(lck, [&]() -> bool{
+		perf_wait(cv, lck, [&]() -> bool{
 			auto p = map_reserved.find(present_pos);
 			auto q = p;
 			++q;
@@ -1439,7 +1508,7 @@ public:
 			}
 
 			return false;
-		});
+		}, PerfWait::blocked);
 
 		// Case 2 - buffer must be extended but without reallocation
 		if (!must_reallocate)
@@ -2044,6 +2113,20 @@ class CSortersManager
 	mutex mtx;
 	CThrowingOnCancelConditionVariable cv_get_next;
 
+	// Tail of sorting: from the first sorter that found no more bins till all threads are returned.
+	// Threads idle in the tail could be used only if a bin already being sorted could take them
+	using clock = std::chrono::steady_clock;
+	bool in_tail = false;
+	clock::time_point tail_start, tail_last_change;
+	uint64 tail_ns = 0;
+	uint64 tail_idle_thread_ns = 0;
+
+	void update_tail_idle(clock::time_point now)
+	{
+		tail_idle_thread_ns += free_threads * (uint64)std::chrono::duration_cast<std::chrono::nanoseconds>(now - tail_last_change).count();
+		tail_last_change = now;
+	}
+
 public:
 	CSortersManager(uint32 n_bins, uint32 n_threads, CBinQueue *_bq, int64 max_mem_size, const vector<pair<int32, int64>>& sorted_bins)
 	{
@@ -2081,7 +2164,7 @@ public:
 		
 		bool no_more = false;
 		bool poped = false;
-		cv_get_next.wait(lck, [this, &bin_id, &part, &size, &n_rec, &no_more, &poped, &n_threads]
+		perf_wait(cv_get_next, lck, [this, &bin_id, &part, &size, &n_rec, &no_more, &poped, &n_threads]
 		{
 			if (!poped)
 			{
@@ -2101,11 +2184,24 @@ public:
 			{
 				++n_threads;
 			}
+
+			// When all bins are already read, the tail bins may take the threads that would otherwise idle till the end of stage 2
+			uint64 n_left;
+			if (bq->all_pushed(n_left))
+				n_threads = MAX(n_threads, free_threads / (int)(n_left + 1));
+
 			return free_threads >= n_threads;
-		});
+		}, PerfWait::idle);
 
 		if (no_more)
+		{
+			if (!in_tail && free_threads < max_sorters)
+			{
+				in_tail = true;
+				tail_start = tail_last_change = clock::now();
+			}
 			return false;
+		}
 	
 		free_threads -= n_threads;		
 
@@ -2118,12 +2214,24 @@ public:
 	void ReturnThreads(uint32 n_threads, uint32 bin_id)
 	{
 		lock_guard<mutex> lck(mtx);		
+		if (in_tail)
+			update_tail_idle(clock::now());
 		free_threads += n_threads;	
 		if (max_sorters / n_sorters[bin_id] < (int)n_threads)
 			--working_with_additional;		
+		if (in_tail && free_threads == max_sorters)
+			tail_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(tail_last_change - tail_start).count();
 		cv_get_next.notify_all();
 	}
 
+	// Valid when all sorters finished. idle_thread_ns is the sum over sorting threads of their idle time in the tail
+	void GetTailStats(uint64& _tail_ns, uint64& _idle_thread_ns)
+	{
+		lock_guard<mutex> lck(mtx);
+		_tail_ns = tail_ns;
+		_idle_thread_ns = tail_idle_thread_ns;
+	}
+
 	void NotifyBQPush()
 	{
 		lock_guard<mutex> lck(mtx);	
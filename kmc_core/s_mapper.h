@@ -15,6 +15,8 @@
 #include "params.h"
 #include "critical_error_handler.h"
 #include <sstream>
+#include <queue>
+#include <vector>
 #ifdef DEVELOP_MODE
 #include "develop.h"
 #endif
@@ -27,6 +29,8 @@ class CSignatureMapper
 	uint32 special_signature;
 	CMemoryPool* pmm_stats;
 	uint32 n_bins;
+	vector<uint64> predicted_bin_load;
+	vector<pair<uint32, uint64>> oversized_signatures; //signature, predicted 2nd stage memory of its bin
 
 #ifdef DEVELOP_MODE
 	bool verbose_log = false;
@@ -138,7 +142,10 @@ public:
 
 		fclose(file);
 	}
-	void Init(uint32* stats)
+	// stats: number of 2nd stage records (k-mers or (k+x)-mers) per signature in the sample
+	// rec_bytes: 2nd stage memory per record, sample_scale: ratio of the whole input to the sample
+	// bin_mem_budget: memory of a single bin, signatures predicted to need more are reported by GetOversizedSignatures
+	void Init(uint32* stats, uint64 rec_bytes, double sample_scale, uint64 bin_mem_budget)
 	{
 		uint32 *sorted;
 		pmm_stats->reserve(sorted);
@@ -146,85 +153,45 @@ public:
 			sorted[i] = i;
 		sort(sorted, sorted + map_size, Comp(stats));
 
-		list<pair<uint32, uint64>> _stats;
+		vector<pair<uint32, uint64>> _stats;
+		uint64 sum = 0;
 		for (uint32 i = 0; i < map_size ; ++i)
 		{
 			if (CMmer::is_allowed(sorted[i], signature_len))
+			{
 				_stats.push_back(make_pair(sorted[i], stats[sorted[i]]));
+				sum += stats[sorted[i]];
+			}
 		}
 
-		list<pair<uint32, uint64>> group;
-		uint32 bin_no = 0;
-		//counting sum
-		double sum = 0.0;
-		for (auto &i : _stats)
-		{
-			i.second += 1000;
-			sum += i.second;
-		}
+		// Signatures not seen in the sample may still occur in the whole input, so each signature gets a prior load.
+		// The prior is bounded by the mean sampled load, otherwise for small samples it hides the real differences between signatures
+		uint64 prior = MIN(1000ull, _stats.empty() ? 1000ull : MAX(1ull, sum / _stats.size()));
 
-		double mean = sum / n_bins;
-		double max_bin_size = 1.1 * mean;
-		uint32 n = n_bins - 1; //one is needed for disabled signatures
-		uint32 max_bins = n_bins - 1;
-		while (_stats.size() > n)
-		{
-			pair<uint32, uint64>& max = _stats.front();
+		// Longest processing time first: the next (smaller) signature goes to the bin with the least predicted 2nd stage memory.
+		// A heavy signature (e.g. poly-A) ends up alone in its bin, since no other signature is placed in the most loaded bin
+		uint32 n_used_bins = (uint32)MIN((uint64)(n_bins - 1), (uint64)_stats.size()); //one is needed for disabled signatures
+		typedef pair<uint64, uint32> bin_load_t; //predicted memory, bin_no
+		priority_queue<bin_load_t, vector<bin_load_t>, greater<bin_load_t>> bin_loads;
+		for (uint32 bin_no = 0; bin_no < n_used_bins; ++bin_no)
+			bin_loads.push(make_pair(0ull, bin_no));
 
-			if (max.second > mean)
-			{
-				signature_map[max.first] = bin_no++;				
-				sum -= max.second;
-				mean = sum / (max_bins - bin_no);
-				max_bin_size = 1.1 * mean;
-
-				_stats.pop_front();
-				--n;
-			}
-			else
-			{
-				//heuristic
-				group.clear();
-				double tmp_sum = 0.0;
-				uint32 in_current = 0;
-				for (auto it = _stats.begin(); it != _stats.end();)
-				{
-					//very simple optimization to decrease the number of unnecessary iterations in this loop
-					if (tmp_sum + _stats.back().second >= max_bin_size)
-						break;
-
-					if (tmp_sum + it->second < max_bin_size)
-					{
-						tmp_sum += it->second;
-						group.push_back(*it);
-						it = _stats.erase(it);
-						++in_current;
-					}
-					else
-						++it;
-				}
-
-				for (auto i = group.begin(); i != group.end(); ++i)
-				{
-					signature_map[i->first] = bin_no;
-				}
-				--n;
-				++bin_no;
-
-				sum -= tmp_sum;
-				mean = sum / (max_bins - bin_no);
-				max_bin_size = 1.1 * mean;
-			}
-		}
-		if (_stats.size() > 0)
+		predicted_bin_load.assign(n_bins, 0);
+		oversized_signatures.clear();
+		for (auto &i : _stats)
 		{
-			for (auto i = _stats.begin(); i != _stats.end(); ++i)
-			{
-				signature_map[i->first] = bin_no++;
-				//cout << "rest bin: " << i->second << "\n";
-			}
+			uint64 predicted_mem = (uint64)(i.second * sample_scale * rec_bytes);
+			if (predicted_mem > bin_mem_budget)
+				oversized_signatures.push_back(make_pair(i.first, predicted_mem));
+
+			bin_load_t least_loaded = bin_loads.top();
+			bin_loads.pop();
+			signature_map[i.first] = least_loaded.second;
+			predicted_bin_load[least_loaded.second] += i.second;
+			least_loaded.first += (i.second + prior) * rec_bytes;
+			bin_loads.push(least_loaded);
 		}
-		signature_map[special_signature] = bin_no;
+		signature_map[special_signature] = n_used_bins;
 		pmm_stats->free(sorted);
 
 #ifdef DEVELOP_MODE
@@ -265,6 +232,18 @@ public:
 		return signature_map[signature];
 	}
 
+	// Number of 2nd stage records in the stats sample for signatures mapped to the bin (0 if the map was not build from stats)
+	uint64 GetPredictedBinLoad(int32 bin_id)
+	{
+		return bin_id < (int32)predicted_bin_load.size() ? predicted_bin_load[bin_id] : 0;
+	}
+
+	// Signatures (from the heaviest) whose predicted 2nd stage memory exceeds bin_mem_budget of Init
+	const vector<pair<uint32, uint64>>& GetOversizedSignatures() const
+	{
+		return oversized_signatures;
+	}
+
 	inline int32 get_max_bin_no()
 	{
 		return signature_map[special_signature];
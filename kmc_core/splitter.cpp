@@ -28,6 +28,7 @@ CSplitter::CSplitter(CKMCParams &Params, CKMCQueues &Queues)
 	bin_part_queue = Queues.bpq.get();
 	pmm_reads = Queues.pmm_reads.get();
 	kmer_len = Params.kmer_len;
+	max_x = Params.max_x;
 	signature_len = Params.signature_len;
 
 	mem_part_pmm_bins = Params.mem_part_pmm_bins;
@@ -481,7 +482,7 @@ void CSplitter::CalcStats(uchar* _part, uint64 _part_size, ReadType read_type, u
 				if (seq[i] < 0)//'N'
 				{
 					if (len >= kmer_len)
-						_stats[current_signature.get()] += 1 + len - kmer_len;
+						_stats[current_signature.get()] += count_2nd_stage_recs(seq + i - len, len, kmer_len, max_x, both_strands);
 					len = 0;
 					++i;
 					break;
@@ -491,7 +492,7 @@ void CSplitter::CalcStats(uchar* _part, uint64 _part_size, ReadType read_type, u
 				{
 					if (len >= kmer_len)
 					{
-						_stats[current_signature.get()] += 1 + len - kmer_len;
+						_stats[current_signature.get()] += count_2nd_stage_recs(seq + i - len, len, kmer_len, max_x, both_strands);
 						len = kmer_len - 1;
 					}
 					current_signature.set(end_mmer);
@@ -504,7 +505,7 @@ void CSplitter::CalcStats(uchar* _part, uint64 _part_size, ReadType read_type, u
 				}
 				else if (signature_start_pos + kmer_len - 1 < i)//need to find new signature
 				{
-					_stats[current_signature.get()] += 1 + len - kmer_len;
+					_stats[current_signature.get()] += count_2nd_stage_recs(seq + i - len, len, kmer_len, max_x, both_strands);
 					len = kmer_len - 1;
 					//looking for new signature
 					++signature_start_pos;
@@ -525,7 +526,7 @@ void CSplitter::CalcStats(uchar* _part, uint64 _part_size, ReadType read_type, u
 			}
 		}
 		if (len >= kmer_len)//last one in read
-			_stats[current_signature.get()] += 1 + len - kmer_len;
+			_stats[current_signature.get()] += count_2nd_stage_recs(seq + i - len, len, kmer_len, max_x, both_strands);
 	}
 	pmm_reads->free(seq);
 }
@@ -829,6 +830,8 @@ CWSplitter::CWSplitter(CKMCParams &Params, CKMCQueues &Queues)
 // Execution
 void CWSplitter::operator()()
 {
+	CPerfThreadStats perf_stats(PerfPhase::splitter);
+
 	// Splitting parts
 	while (!pq->completed())
 	{
@@ -837,6 +840,8 @@ void CWSplitter::operator()()
 		ReadType read_type;
 		if (pq->pop(part, size, read_type))
 		{			
+			CPerfTraceScope trace_part("split part", "bytes", size);
+			perf_stats.AddBytes(size);
 			spl->ProcessReads(part, size, read_type);
 			pmm_fastq->free(part);
 		}
@@ -845,6 +850,7 @@ void CWSplitter::operator()()
 	bpq->mark_completed();
 
 	spl->GetTotal(n_reads);
+	perf_stats.AddRecords(n_reads);
 
 	spl.reset();
 }
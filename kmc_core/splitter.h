@@ -45,6 +45,7 @@ class CSplitter
 	uint32_t curr_read_len = 0;
 
 	uint32 kmer_len;
+	uint32 max_x;
 	//uint32 prefix_len;
 	uint32 signature_len;
 	uint32 n_bins;	
@@ -20,7 +20,7 @@
 #include "percent_progress.h"
 
 enum class CounterOpType { MIN, MAX, SUM, DIFF, FROM_DB1, FROM_DB2, NONE };
-enum class OutputType { KMC1, KFF1 };
+enum class OutputType { KMC1, KFF1, SKETCH_JSON, SKETCH_BIN };
 enum class KmerDBOpenMode { sequential, sorted, counters_only };
 
 class CCounterBuilder
@@ -76,6 +76,7 @@ struct COutputDesc : public CDescBase
 	uint64 counter_value = 0; //only for SET_COUNTER operation, 0 means not set yet
 	uint8_t encoding = 0b00011011; //for KFF writers
 	OutputType output_type = OutputType::KMC1;
+	bool output_type_set = false; //true if -o was given, KMC1 is also the default
 	COutputDesc(const std::string& file_src) :
 		CDescBase(file_src)		
 	{
@@ -113,9 +114,12 @@ struct CSimpleOutputDesc : public COutputDesc
 
 struct CTransformOutputDesc : public COutputDesc
 {
-	enum class OpType { HISTOGRAM, DUMP, SORT, REDUCE, COMPACT, SET_COUNTS };
+	enum class OpType { HISTOGRAM, DUMP, SORT, REDUCE, COMPACT, SET_COUNTS, SKETCH };
 	OpType op_type;
 	bool sorted_output = false; //only for dump operation, rest is sorted anyway (except histo which does not print k-mers at all)
+	uint32 scaled = 1000; //only for sketch operation
+	uint32 seed = 42; //only for sketch operation
+	bool sketch_abundances = false; //only for sketch operation
 	CTransformOutputDesc(OpType op_type) :op_type(op_type)
 	{ }
 };
@@ -162,7 +166,7 @@ struct CCheckParams
 class CConfig
 {
 public:	
-	enum class Mode { UNDEFINED, COMPLEX, COMPARE, FILTER, SIMPLE_SET, TRANSFORM, INFO, CHECK };
+	enum class Mode { UNDEFINED, COMPLEX, COMPARE, FILTER, SIMPLE_SET, TRANSFORM, INFO, CHECK, SKETCH_COMPLEX };
 	uint32 avaiable_threads;
 	uint32 kmer_len = 0;
 	Mode mode = Mode::UNDEFINED;
@@ -219,6 +223,8 @@ public:
 			return "transform";
 		case CConfig::Mode::CHECK:
 			return "check";
+		case CConfig::Mode::SKETCH_COMPLEX:
+			return "sketch-complex";
 		default:
 			return "";
 		}
@@ -279,6 +285,7 @@ public:
 				  << "  transform            - transforms single KMC's database\n"
 				  << "  simple               - performs set operation on two KMC's databases\n"
 				  << "  complex              - performs set operation on multiple KMC's databases\n"
+				  << "  sketch-complex       - performs set operation on multiple FracMinHash sketches\n"
 				  << "  filter               - filter out reads with too small number of k-mers\n"
 				  << " global parameters:\n"
 				  << "  -t<value>            - total number of threads (default: no. of CPU cores)\n"
@@ -355,6 +362,7 @@ public:
 				  << "  histogram                  - produce histogram of k-mers occurrences\n"
 				  << "  dump                       - produce text dump of kmc database\n"
 				  << "  set_counts <value>         - set all k-mer counts to specific value\n"
+				  << "  sketch                     - produce FracMinHash sketch (sourmash compatible) of k-mers of database\n"
 				  
 				  << " For input there are additional parameters:\n"
 				  << "  -ci<value> - exclude k-mers occurring less than <value> times \n"
@@ -374,6 +382,15 @@ public:
 
 				  << " For dump operation there are additional oper_params:\n"
 				  << "  -s - sorted output\n"
+
+				  << " For sketch operation there are additional oper_params:\n"
+				  << "  -scaled<value> - scaled value of FracMinHash (default: 1000)\n"
+				  << "  -S<value> - seed of MurmurHash3 (default: 42)\n"
+				  << "  -a - store abundances of hashes\n"
+				  << " and additional output_params:\n"
+				  << "  -ci<value> - exclude k-mers occurring less than <value> times \n"
+				  << "  -cx<value> - exclude k-mers occurring more of than <value> times\n"
+				  << "  -o<json|bin> - sketch as sourmash JSON or in binary format (default: json)\n"
 				  << "Example:\n"
 				  << "kmc_tools transform db reduce err_kmers -cx10 reduce valid_kmers -ci11 histogram histo.txt dump dump.txt\n";
 	}
@@ -429,6 +446,37 @@ public:
 	}
 };
 
+class CSketchComplexUsageDisplayer : public CUsageDisplayer
+{
+public:
+	CSketchComplexUsageDisplayer() :CUsageDisplayer("sketch-complex")
+	{}
+	void Display() const override
+	{
+		std::cout << "Sketch-complex operation is the complex operation performed on FracMinHash sketches instead of KMC's databases. Command-line syntax:\n"
+				  << "kmc_tools sketch-complex <operations_definition_file>\n"
+				  << " operations_definition_file - has the same syntax as for complex operation (see: kmc_tools complex), but:\n"
+				  << "  input paths are sketches (binary or sourmash JSON, produced by kmc_dump)\n"
+				  << "  -ci, -cx parameters refer to abundances of hashes (each hash has abundance 1 if sketch was stored without abundances)\n"
+				  << "  all sketches must have the same k, seed and molecule, each operation downsamples its arguments to the smaller max_hash\n"
+				  << "output_params are:\n"
+				  << "  -ci<value> - exclude hashes occurring less than <value> times \n"
+				  << "  -cx<value> - exclude hashes occurring more of than <value> times\n"
+				  << "  -o<json/bin> - output sketch as sourmash JSON or in binary format (default: json)\n"
+				  << "Example:\n"
+				  << " __________________________________________________________________ \n"
+				  << "|INPUT:                                                            |\n"
+				  << "|s1 = sample1.json                                                 |\n"
+				  << "|s2 = sample2.bin                                                  |\n"
+				  << "|s3 = sample3.bin -ci2                                           __|\n"
+				  << "|OUTPUT:                                                        |  /\n"
+				  << "|shared.bin = (s1 + s2) * min s3                                | / \n"
+				  << "|OUTPUT_PARAMS:                                                 |/  \n"
+				  << "|-obin                                                          |   \n"
+				  << "|_______________________________________________________________|   \n";
+	}
+};
+
 class CFilterUsageDisplayer : public CUsageDisplayer
 {
 public:
@@ -474,6 +522,9 @@ public:
 		case CConfig::Mode::COMPLEX:
 			desc = std::make_unique<CComplexUsageDisplayer>();
 			break;
+		case CConfig::Mode::SKETCH_COMPLEX:
+			desc = std::make_unique<CSketchComplexUsageDisplayer>();
+			break;
 		case CConfig::Mode::COMPARE:
 			desc = std::make_unique<CGeneralUsageDisplayer>();
 			break;
@@ -17,11 +17,12 @@
 #include <sstream>
 #include <memory>
 #include "db_reader_factory.h"
+#include "sketch_operations.h"
 
 //************************************************************************************************************
 // CExpressionNode - Base abstract class representing expression node. In first stage of algorithm from
 // user input there is created binary tree. Node type represents operation. This tree is only for generating
-// another tree (check out CInput and CBundle)
+// another tree (check out CInput and CBundle) or, in sketch-complex mode, it is evaluated directly on sketches
 //************************************************************************************************************
 template<unsigned SIZE> class CExpressionNode
 {
@@ -41,6 +42,8 @@ public:
 
 	virtual CBundle<SIZE>* GetExecutionRoot() = 0;
 
+	virtual CSketchSet GetSketch() = 0;
+
 	void AddLeftChild(CExpressionNode* child)
 	{
 #ifdef ENABLE_DEBUG
@@ -119,6 +122,10 @@ public:
 	{
 		return new CBundle<SIZE>(new CUnion<SIZE>(this->left->GetExecutionRoot(), this->right->GetExecutionRoot(), this->counter_op_type));
 	}
+	CSketchSet GetSketch() override
+	{
+		return CSketchOperations::Union(this->left->GetSketch(), this->right->GetSketch(), this->counter_op_type);
+	}
 #ifdef ENABLE_DEBUG
 	void Info() override
 	{
@@ -141,6 +148,10 @@ public:
 	{
 		return new CBundle<SIZE>(new CKmersSubtract<SIZE>(this->left->GetExecutionRoot(), this->right->GetExecutionRoot()));
 	}
+	CSketchSet GetSketch() override
+	{
+		return CSketchOperations::KmersSubtract(this->left->GetSketch(), this->right->GetSketch());
+	}
 #ifdef ENABLE_DEBUG
 	void Info() override
 	{
@@ -161,6 +172,10 @@ public:
 	{
 		return new CBundle<SIZE>(new CCountersSubtract<SIZE>(this->left->GetExecutionRoot(), this->right->GetExecutionRoot(), this->counter_op_type));
 	}
+	CSketchSet GetSketch() override
+	{
+		return CSketchOperations::CountersSubtract(this->left->GetSketch(), this->right->GetSketch(), this->counter_op_type);
+	}
 #ifdef ENABLE_DEBUG
 	void Info() override
 	{
@@ -182,6 +197,10 @@ public:
 	{		
 		return new CBundle<SIZE>(new CIntersection<SIZE>(this->left->GetExecutionRoot(), this->right->GetExecutionRoot(), this->counter_op_type));
 	}
+	CSketchSet GetSketch() override
+	{
+		return CSketchOperations::Intersection(this->left->GetSketch(), this->right->GetSketch(), this->counter_op_type);
+	}
 #ifdef ENABLE_DEBUG
 	void Info() override
 	{
@@ -191,7 +210,7 @@ public:
 };
 
 //************************************************************************************************************
-// CInputNode - represents node (leaf) - KMC1 or KMC2 database
+// CInputNode - represents node (leaf) - KMC1 or KMC2 database (or sketch file in sketch-complex mode)
 //************************************************************************************************************
 template<unsigned SIZE> class CInputNode : public CExpressionNode<SIZE>
 {	
@@ -206,6 +225,10 @@ public:
 		CInput<SIZE>* db = db_reader_factory<SIZE>(config.headers[desc_pos], config.input_desc[desc_pos], KmerDBOpenMode::sorted);		
 		return new CBundle<SIZE>(db);
 	}
+	CSketchSet GetSketch() override
+	{
+		return CSketchSet::Load(CConfig::GetInstance().input_desc[desc_pos]);
+	}
 
 #ifdef ENABLE_DEBUG
 	void Info() override
@@ -20,6 +20,7 @@
 #include "parameters_parser.h"
 #include "histogram_writer.h"
 #include "dump_writer.h"
+#include "sketch_writer.h"
 #include "fastq_reader.h"
 #include "fastq_filter.h"
 #include "fastq_writer.h"
@@ -46,6 +47,7 @@ template<unsigned SIZE> class CTools
 		vector<CBundle<SIZE>*> bundles;
 		vector<CDumpWriterForTransform<SIZE>> dump_writers;
 		vector<CHistogramWriterForTransform> histogram_writers;
+		vector<unique_ptr<CSketchWriterForTransform<SIZE>>> sketch_writers;
 
 		for (auto& desc : config.transform_output_desc)
 		{
@@ -67,6 +69,10 @@ template<unsigned SIZE> class CTools
 				histogram_writers.emplace_back(desc);
 				histogram_writers.back().Init();
 				break;
+			case CTransformOutputDesc::OpType::SKETCH:
+				sketch_writers.push_back(make_unique<CSketchWriterForTransform<SIZE>>(desc));
+				sketch_writers.back()->Init();
+				break;
 			}
 		}
 		CKmer<SIZE> kmer;
@@ -88,6 +94,8 @@ template<unsigned SIZE> class CTools
 					out.PutCounter(counter);
 				for (auto& out : dump_writers)
 					out.PutKmer(kmer, counter);
+				for (auto& out : sketch_writers)
+					out->PutKmer(kmer, counter);
 			}
 		}
 		else 
@@ -100,6 +108,8 @@ template<unsigned SIZE> class CTools
 					out.PutCounter(tmp_bundle.TopCounter());
 				for (auto& out : dump_writers)
 					out.PutKmer(tmp_bundle.TopKmer(), tmp_bundle.TopCounter());
+				for (auto& out : sketch_writers)
+					out->PutKmer(tmp_bundle.TopKmer(), tmp_bundle.TopCounter());
 
 				for (uint32 i = 0; i < bundles.size(); ++i)
 				{
@@ -124,6 +134,8 @@ template<unsigned SIZE> class CTools
 			out.Finish();
 		for (auto& out : dump_writers)		
 			out.Finish();			
+		for (auto& out : sketch_writers)
+			out->Finish();
 		
 		for (auto& out : kmc_db_writers)
 		{
@@ -445,6 +457,8 @@ template<unsigned SIZE> class CTools
 				sort_needed = true;
 				break;
 			}
+			if (desc.op_type == CTransformOutputDesc::OpType::SKETCH)
+				kmers_needed = true;
 			if (desc.op_type == CTransformOutputDesc::OpType::DUMP)
 			{
 				kmers_needed = true;
@@ -638,6 +652,46 @@ bool help_or_version(int argc, char** argv)
 	return false;
 }
 
+//----------------------------------------------------------------------------------
+// Sketch-complex operation does not depend on k-mer length, sketches are evaluated directly from expression tree
+bool sketch_complex(CParametersParser& parameters_parser)
+{
+	CConfig& config = CConfig::GetInstance();
+	CExpressionNode<1>* expression_root = parameters_parser.GetExpressionRoot<1>();
+	CSketchSet sketch = expression_root->GetSketch();
+	delete expression_root;
+
+	const COutputDesc& desc = config.output_desc;
+	uint64 n_out = 0;
+	for (uint64 i = 0; i < sketch.hashes.size(); ++i)
+	{
+		if (desc.cutoff_min && sketch.counters[i] < desc.cutoff_min)
+			continue;
+		if (desc.cutoff_max && sketch.counters[i] > desc.cutoff_max)
+			continue;
+		sketch.hashes[n_out] = sketch.hashes[i];
+		sketch.counters[n_out++] = sketch.counters[i];
+	}
+	sketch.hashes.resize(n_out);
+	sketch.counters.resize(n_out);
+	sketch.info.n_hashes = n_out;
+
+	const uint64* abundances = sketch.info.with_abundances ? sketch.counters.data() : nullptr;
+	bool res;
+	if (desc.output_type == OutputType::SKETCH_BIN)
+		res = CSketchFile::Save(desc.file_src, sketch.info, sketch.hashes.data(), abundances);
+	else
+		res = CSketchFile::SaveJson(desc.file_src, sketch.info, sketch.hashes.data(), abundances);
+	if (!res)
+	{
+		std::cerr << "Error: cannot save sketch: " << desc.file_src << "\n";
+		exit(1);
+	}
+	if (config.verbose)
+		std::cerr << "No. of hashes in output sketch: " << n_out << "\n";
+	return true;
+}
+
 int main(int argc, char**argv)
 {
 #ifdef ENABLE_LOGGER 
@@ -653,6 +707,9 @@ int main(int argc, char**argv)
 
 	CParametersParser params_parser(argc, argv);
 	params_parser.Parse();
+	if (CConfig::GetInstance().mode == CConfig::Mode::SKETCH_COMPLEX)
+		return sketch_complex(params_parser) ? 0 : 1;
+
 	if (params_parser.validate_input_dbs())
 	{
 		params_parser.SetThreads();
@@ -296,6 +296,10 @@ bool CParametersParser::read_output_for_transform()
 	{
 		op_type = CTransformOutputDesc::OpType::DUMP;
 	}
+	else if (strcmp(argv[pos], "sketch") == 0)
+	{
+		op_type = CTransformOutputDesc::OpType::SKETCH;
+	}
 	else if (strcmp(argv[pos], "set_counts") == 0)
 	{
 		op_type = CTransformOutputDesc::OpType::SET_COUNTS;
@@ -357,7 +361,19 @@ bool CParametersParser::read_output_for_transform()
 				Usage();
 				exit(1);
 			}
-		}		
+		}
+		else if (op_type == CTransformOutputDesc::OpType::SKETCH && strncmp(argv[pos], "-scaled", 7) == 0)
+		{
+			config.transform_output_desc.back().scaled = replace_zero(atoi(argv[pos] + 7), "-scaled", 1);
+		}
+		else if (op_type == CTransformOutputDesc::OpType::SKETCH && strncmp(argv[pos], "-S", 2) == 0)
+		{
+			config.transform_output_desc.back().seed = atoi(argv[pos] + 2);
+		}
+		else if (op_type == CTransformOutputDesc::OpType::SKETCH && strcmp(argv[pos], "-a") == 0)
+		{
+			config.transform_output_desc.back().sketch_abundances = true;
+		}
 		else
 		{
 			cerr << "Error: unknown operation parameter: " << argv[pos] <<"\n";
@@ -420,9 +436,23 @@ bool CParametersParser::read_output_for_transform()
 				}
 				++pos;
 			}
+			else if (op_type == CTransformOutputDesc::OpType::SKETCH)
+			{
+				if (strncmp(argv[pos] + 2, "json", 4) == 0)
+					config.transform_output_desc.back().output_type = OutputType::SKETCH_JSON;
+				else if (strncmp(argv[pos] + 2, "bin", 3) == 0)
+					config.transform_output_desc.back().output_type = OutputType::SKETCH_BIN;
+				else
+				{
+					cerr << "Error: Unknown output type\n";
+					Usage();
+					exit(1);
+				}
+				++pos;
+			}
 			else
 			{
-				cerr << "Error: -o parameter allowed only for compact, reduce, set_counts and sort operations\n";
+				cerr << "Error: -o parameter allowed only for compact, reduce, set_counts, sort and sketch operations\n";
 				Usage();
 				exit(1);
 			}
@@ -609,6 +639,10 @@ void CParametersParser::Parse()
 	{
 		config.mode = CConfig::Mode::COMPLEX;
 	}
+	else if (strcmp(argv[pos], "sketch-complex") == 0)
+	{
+		config.mode = CConfig::Mode::SKETCH_COMPLEX;
+	}
 	else if (strcmp(argv[pos], "transform") == 0)
 	{
 		config.mode = CConfig::Mode::TRANSFORM;
@@ -659,7 +693,7 @@ void CParametersParser::Parse()
 			exit(1);
 		}
 	}
-	else if (config.mode == CConfig::Mode::COMPLEX)
+	else if (config.mode == CConfig::Mode::COMPLEX || config.mode == CConfig::Mode::SKETCH_COMPLEX)
 	{
 		if (strncmp(argv[pos], "-", 1) == 0)
 		{
@@ -669,6 +703,16 @@ void CParametersParser::Parse()
 		complex_parser = make_unique<CParser>(argv[pos]);
 		complex_parser->ParseInputs();
 		complex_parser->ParseOutput();
+		if (config.mode == CConfig::Mode::SKETCH_COMPLEX)
+		{
+			if (!config.output_desc.output_type_set)
+				config.output_desc.output_type = OutputType::SKETCH_JSON;
+			else if (config.output_desc.output_type != OutputType::SKETCH_JSON && config.output_desc.output_type != OutputType::SKETCH_BIN)
+			{
+				cerr << "Error: sketch-complex output may be json or bin only\n";
+				exit(1);
+			}
+		}
 	}
 	else if (config.mode == CConfig::Mode::TRANSFORM)
 	{
@@ -820,9 +864,10 @@ bool CParametersParser::validate_input_dbs()
 		for (auto& c : config.transform_output_desc)
 		{
 			c.encoding = encoding;
-			//dump and histogram writes in text format
+			//dump, histogram and sketch are not k-mer databases
 			if (c.op_type == CTransformOutputDesc::OpType::DUMP ||
-				c.op_type == CTransformOutputDesc::OpType::HISTOGRAM)
+				c.op_type == CTransformOutputDesc::OpType::HISTOGRAM ||
+				c.op_type == CTransformOutputDesc::OpType::SKETCH)
 				continue;
 
 			if (c.output_type == OutputType::KMC1)
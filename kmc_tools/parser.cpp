@@ -28,7 +28,7 @@ CParser::CParser(const std::string& src):
 		exit(1);
 	}
 	//input_line_pattern = "\\s*(\\w*)\\s*=\\s*(.*)$";
-	input_line_pattern = "^\\s*([\\w-+]*)\\s*=\\s*(.*)$";
+	input_line_pattern = "^\\s*([\\w+-]*)\\s*=\\s*(.*)$";
 	output_line_pattern = "^\\s*(.*)\\s*=\\s*(.*)$"; //TODO: consider valid file name	
 	empty_line_pattern = "^\\s*$";
 }
@@ -225,11 +225,16 @@ void CParser::parseOtuputParamsLine()
 					config.output_desc.output_type = OutputType::KFF1;
 				else if (strncmp(tmp.c_str() + 2, "kmc", 3) == 0)
 					config.output_desc.output_type = OutputType::KMC1;
+				else if (strncmp(tmp.c_str() + 2, "json", 4) == 0 && config.mode == CConfig::Mode::SKETCH_COMPLEX)
+					config.output_desc.output_type = OutputType::SKETCH_JSON;
+				else if (strncmp(tmp.c_str() + 2, "bin", 3) == 0 && config.mode == CConfig::Mode::SKETCH_COMPLEX)
+					config.output_desc.output_type = OutputType::SKETCH_BIN;
 				else
 				{
 					std::cerr << "Error: Unknown output type: " << tmp.c_str() + 2 << "\n";
 					exit(1);
 				}
+				config.output_desc.output_type_set = true;
 				continue;
 			}
 			std::cerr << "Error: Unknow parameter " << tmp << " for variable " << tmp << ", line: " << line_no << "\n";
@@ -0,0 +1,223 @@
+/*
+  This file is a part of KMC software distributed under GNU GPL 3 licence.
+  The homepage of the KMC project is http://sun.aei.polsl.pl/kmc
+
+  Authors: Marek Kokot
+
+  Version: 3.2.2
+  Date   : 2023-03-10
+*/
+
+#ifndef _SKETCH_OPERATIONS_H
+#define _SKETCH_OPERATIONS_H
+
+#include "defs.h"
+#include "config.h"
+#include "../kmc_api/sketch_file.h"
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+//************************************************************************************************************
+// CSketchSet - FracMinHash sketch kept in memory during evaluation of sketch-complex expression.
+// Hashes are sorted, counters are parallel to hashes (1 for each hash if input sketch has no abundances).
+//************************************************************************************************************
+struct CSketchSet
+{
+	CSketchInfo info;
+	std::vector<uint64> hashes;
+	std::vector<uint64> counters;
+
+	// Load sketch (binary or JSON) and apply cutoffs of input description
+	static CSketchSet Load(const CInputDesc& desc)
+	{
+		CSketchFile file;
+		if (!file.Open(desc.file_src))
+		{
+			std::cerr << "Error: cannot open sketch: " << desc.file_src << "\n";
+			exit(1);
+		}
+		CSketchSet res;
+		res.info = file.Info();
+		const uint64* hashes = file.Hashes();
+		const uint64* abundances = file.Abundances();
+		res.hashes.reserve(file.Size());
+		res.counters.reserve(file.Size());
+		for (uint64 i = 0; i < file.Size(); ++i)
+		{
+			uint64 counter = abundances ? abundances[i] : 1;
+			if (desc.cutoff_min && counter < desc.cutoff_min)
+				continue;
+			if (desc.cutoff_max && counter > desc.cutoff_max)
+				continue;
+			res.hashes.push_back(hashes[i]);
+			res.counters.push_back(counter);
+		}
+		return res;
+	}
+
+	// Keep only hashes below max_hash (hashes are sorted, so it is a prefix)
+	void Downsample(uint64 max_hash)
+	{
+		if (max_hash >= info.max_hash)
+			return;
+		auto n = std::lower_bound(hashes.begin(), hashes.end(), max_hash) - hashes.begin();
+		hashes.resize(n);
+		counters.resize(n);
+		info.max_hash = max_hash;
+	}
+
+	void Insert(uint64 hash, uint64 counter)
+	{
+		hashes.push_back(hash);
+		counters.push_back(counter);
+	}
+};
+
+//************************************************************************************************************
+// CSketchOperations - set operations on sketches, semantics of counters are the same as in operations.h
+// (CUnion, CIntersection, CKmersSubtract, CCountersSubtract), but elements are hashes instead of k-mers.
+// Before each operation both arguments are downsampled to a common max_hash.
+//************************************************************************************************************
+class CSketchOperations
+{
+	static void insert_equal(CSketchSet& res, uint64 hash, uint64 counter1, uint64 counter2, CounterOpType counter_op_type)
+	{
+		switch (counter_op_type)
+		{
+		case CounterOpType::MIN:
+			res.Insert(hash, MIN(counter1, counter2));
+			break;
+		case CounterOpType::MAX:
+			res.Insert(hash, MAX(counter1, counter2));
+			break;
+		case CounterOpType::SUM:
+			res.Insert(hash, counter1 + counter2);
+			break;
+		case CounterOpType::DIFF:
+			if (counter1 > counter2)
+				res.Insert(hash, counter1 - counter2);
+			break;
+		case CounterOpType::FROM_DB1:
+			res.Insert(hash, counter1);
+			break;
+		case CounterOpType::FROM_DB2:
+			res.Insert(hash, counter2);
+			break;
+		case CounterOpType::NONE:
+			break;
+		default:
+			break;
+		}
+	}
+
+	static CSketchSet prepare(CSketchSet& input1, CSketchSet& input2)
+	{
+		if (input1.info.ksize != input2.info.ksize || input1.info.seed != input2.info.seed || input1.info.molecule != input2.info.molecule)
+		{
+			std::cerr << "Error: sketches with different k, seed or molecule cannot be combined\n";
+			exit(1);
+		}
+		uint64 max_hash = MIN(input1.info.max_hash, input2.info.max_hash);
+		input1.Downsample(max_hash);
+		input2.Downsample(max_hash);
+
+		CSketchSet res;
+		res.info = input1.info;
+		res.info.with_abundances = input1.info.with_abundances || input2.info.with_abundances;
+		if (input1.info.filename != input2.info.filename)
+			res.info.filename = "";
+		return res;
+	}
+
+public:
+	static CSketchSet Union(CSketchSet input1, CSketchSet input2, CounterOpType counter_op_type)
+	{
+		CSketchSet res = prepare(input1, input2);
+		res.hashes.reserve(input1.hashes.size() + input2.hashes.size());
+		res.counters.reserve(input1.hashes.size() + input2.hashes.size());
+		size_t i = 0, j = 0;
+		while (i < input1.hashes.size() && j < input2.hashes.size())
+		{
+			if (input1.hashes[i] == input2.hashes[j])
+			{
+				insert_equal(res, input1.hashes[i], input1.counters[i], input2.counters[j], counter_op_type);
+				++i;
+				++j;
+			}
+			else if (input1.hashes[i] < input2.hashes[j])
+			{
+				res.Insert(input1.hashes[i], input1.counters[i]);
+				++i;
+			}
+			else
+			{
+				res.Insert(input2.hashes[j], input2.counters[j]);
+				++j;
+			}
+		}
+		for (; i < input1.hashes.size(); ++i)
+			res.Insert(input1.hashes[i], input1.counters[i]);
+		for (; j < input2.hashes.size(); ++j)
+			res.Insert(input2.hashes[j], input2.counters[j]);
+		return res;
+	}
+
+	static CSketchSet Intersection(CSketchSet input1, CSketchSet input2, CounterOpType counter_op_type)
+	{
+		CSketchSet res = prepare(input1, input2);
+		size_t i = 0, j = 0;
+		while (i < input1.hashes.size() && j < input2.hashes.size())
+		{
+			if (input1.hashes[i] == input2.hashes[j])
+			{
+				insert_equal(res, input1.hashes[i], input1.counters[i], input2.counters[j], counter_op_type);
+				++i;
+				++j;
+			}
+			else if (input1.hashes[i] < input2.hashes[j])
+				++i;
+			else
+				++j;
+		}
+		return res;
+	}
+
+	// If hash exists in both inputs it is absent in result (counters does not matter)
+	static CSketchSet KmersSubtract(CSketchSet input1, CSketchSet input2)
+	{
+		CSketchSet res = prepare(input1, input2);
+		res.info.with_abundances = input1.info.with_abundances;
+		size_t j = 0;
+		for (size_t i = 0; i < input1.hashes.size(); ++i)
+		{
+			while (j < input2.hashes.size() && input2.hashes[j] < input1.hashes[i])
+				++j;
+			if (j < input2.hashes.size() && input2.hashes[j] == input1.hashes[i])
+				continue;
+			res.Insert(input1.hashes[i], input1.counters[i]);
+		}
+		return res;
+	}
+
+	// If hash exists in both inputs counters are combined (by default subtracted)
+	static CSketchSet CountersSubtract(CSketchSet input1, CSketchSet input2, CounterOpType counter_op_type)
+	{
+		CSketchSet res = prepare(input1, input2);
+		size_t j = 0;
+		for (size_t i = 0; i < input1.hashes.size(); ++i)
+		{
+			while (j < input2.hashes.size() && input2.hashes[j] < input1.hashes[i])
+				++j;
+			if (j < input2.hashes.size() && input2.hashes[j] == input1.hashes[i])
+				insert_equal(res, input1.hashes[i], input1.counters[i], input2.counters[j], counter_op_type);
+			else
+				res.Insert(input1.hashes[i], input1.counters[i]);
+		}
+		return res;
+	}
+};
+
+#endif
+
+// ***** EOF
@@ -0,0 +1,189 @@
+/*
+  This file is a part of KMC software distributed under GNU GPL 3 licence.
+  The homepage of the KMC project is http://sun.aei.polsl.pl/kmc
+
+  Authors: Marek Kokot
+
+  Version: 3.2.2
+  Date   : 2023-03-10
+*/
+
+#ifndef _SKETCH_WRITER_H
+#define _SKETCH_WRITER_H
+
+#include "defs.h"
+#include "kmer.h"
+#include "config.h"
+#include "../kmc_api/sketch_file.h"
+#include "../kmc_api/murmur_hash.h"
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <iostream>
+
+//************************************************************************************************************
+// CSketchWriterForTransform - FracMinHash sketch of k-mers of input database. K-mers are gathered in packs
+// by the thread that reads the database, conversion to strings and hashing is done by a pool of hashers.
+//************************************************************************************************************
+template<unsigned SIZE>
+class CSketchWriterForTransform
+{
+	static const uint32 PACK_SIZE = 1 << 16;
+
+	using pack_t = std::vector<std::pair<CKmer<SIZE>, uint32>>;
+	using hashes_t = std::vector<std::pair<uint64, uint64>>;
+
+	CTransformOutputDesc& output_desc;
+	CConfig& config;
+	uint32 kmer_len;
+	uint64 max_hash;
+	char codes[4];
+
+	pack_t pack;
+	std::queue<pack_t> packs;
+	uint32 max_packs_in_queue;
+	bool no_more_packs = false;
+	std::mutex mtx;
+	std::condition_variable cv_pop, cv_push;
+
+	std::vector<std::thread> hashers;
+	std::vector<hashes_t> hashes;
+
+	void push_pack()
+	{
+		std::unique_lock<std::mutex> lck(mtx);
+		cv_push.wait(lck, [this] {return packs.size() < max_packs_in_queue; });
+		packs.push(std::move(pack));
+		lck.unlock();
+		cv_pop.notify_one();
+		pack = pack_t();
+		pack.reserve(PACK_SIZE);
+	}
+
+	bool pop_pack(pack_t& res)
+	{
+		std::unique_lock<std::mutex> lck(mtx);
+		cv_pop.wait(lck, [this] {return !packs.empty() || no_more_packs; });
+		if (packs.empty())
+			return false;
+		res = std::move(packs.front());
+		packs.pop();
+		lck.unlock();
+		cv_push.notify_one();
+		return true;
+	}
+
+	void hasher(hashes_t& res)
+	{
+		std::vector<char> str(kmer_len);
+		uint64 hv[2];
+		pack_t local;
+		while (pop_pack(local))
+		{
+			for (auto& elem : local)
+			{
+				for (uint32 i = 0; i < kmer_len; ++i)
+					str[i] = codes[elem.first.get_2bits(2 * (kmer_len - 1 - i))];
+				murmur::MurmurHash3_x64_128(str.data(), kmer_len, output_desc.seed, hv);
+				if (hv[0] < max_hash)
+					res.emplace_back(hv[0], elem.second);
+			}
+		}
+	}
+
+public:
+	CSketchWriterForTransform(CTransformOutputDesc& output_desc) :
+		output_desc(output_desc),
+		config(CConfig::GetInstance())
+	{
+		kmer_len = config.headers.front().kmer_len;
+		max_hash = murmur::fmh_max_hash(output_desc.scaled);
+
+		uint8_t encoding = 0b00011011;
+		if (config.headers.front().GetType() == KmerFileType::KFF1)
+			encoding = config.headers.front().kff_file_struct.encoding;
+		codes[(encoding >> 6) & 3] = 'A';
+		codes[(encoding >> 4) & 3] = 'C';
+		codes[(encoding >> 2) & 3] = 'G';
+		codes[encoding & 3] = 'T';
+	}
+
+	CSketchWriterForTransform(const CSketchWriterForTransform&) = delete;
+	CSketchWriterForTransform& operator=(const CSketchWriterForTransform&) = delete;
+
+	void Init()
+	{
+		uint32 n_hashers = MAX(1u, config.avaiable_threads);
+		max_packs_in_queue = 2 * n_hashers;
+		pack.reserve(PACK_SIZE);
+		hashes.resize(n_hashers);
+		for (uint32 i = 0; i < n_hashers; ++i)
+			hashers.emplace_back(&CSketchWriterForTransform::hasher, this, std::ref(hashes[i]));
+	}
+
+	void PutKmer(CKmer<SIZE>& kmer, uint32 counter)
+	{
+		if (config.headers.front().counter_size != 0 && (counter < output_desc.cutoff_min || counter > output_desc.cutoff_max))
+			return;
+		if (counter > output_desc.counter_max)
+			counter = output_desc.counter_max;
+		pack.emplace_back(kmer, counter);
+		if (pack.size() == PACK_SIZE)
+			push_pack();
+	}
+
+	void Finish()
+	{
+		if (!pack.empty())
+			push_pack();
+		{
+			std::lock_guard<std::mutex> lck(mtx);
+			no_more_packs = true;
+		}
+		cv_pop.notify_all();
+		for (auto& t : hashers)
+			t.join();
+
+		hashes_t all;
+		for (auto& part : hashes)
+		{
+			all.insert(all.end(), part.begin(), part.end());
+			hashes_t().swap(part);
+		}
+		std::sort(all.begin(), all.end());
+
+		CSketchInfo info;
+		info.ksize = kmer_len;
+		info.seed = output_desc.seed;
+		info.max_hash = max_hash;
+		info.with_abundances = output_desc.sketch_abundances;
+		info.n_hashes = all.size();
+
+		std::vector<uint64> mins(all.size());
+		std::vector<uint64> abundances(info.with_abundances ? all.size() : 0);
+		for (uint64 i = 0; i < all.size(); ++i)
+		{
+			mins[i] = all[i].first;
+			if (info.with_abundances)
+				abundances[i] = all[i].second;
+		}
+
+		bool saved;
+		if (output_desc.output_type == OutputType::SKETCH_BIN)
+			saved = CSketchFile::Save(output_desc.file_src, info, mins.data(), info.with_abundances ? abundances.data() : nullptr);
+		else
+			saved = CSketchFile::SaveJson(output_desc.file_src, info, mins.data(), info.with_abundances ? abundances.data() : nullptr);
+		if (!saved)
+		{
+			std::cerr << "Error: cannot save sketch: " << output_desc.file_src << "\n";
+			exit(1);
+		}
+	}
+};
+
+#endif
+
+// ***** EOF
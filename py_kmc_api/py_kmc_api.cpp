@@ -2,10 +2,79 @@
 #include <pybind11/operators.h>
 #include <pybind11/stl.h>
 #include <pybind11/stl_bind.h>
+#include <pybind11/numpy.h>
 #include <kmc_file.h>
+#include <sketch_file.h>
 
 namespace py = pybind11;
 
+// Pointer to data of preallocated NumPy array, which must be C-contiguous, writeable and of exactly T type (no conversion is done, as it would copy)
+template<typename T>
+T* numpy_out_ptr(py::array& arr, uint64 min_size, const char* name)
+{
+	if (!py::isinstance<py::array_t<T>>(arr) || !(arr.flags() & py::array::c_style) || !arr.writeable())
+		throw std::invalid_argument(std::string(name) + ": writeable C-contiguous array of " + py::str(py::dtype::of<T>()).cast<std::string>() + " expected");
+	if ((uint64)arr.size() < min_size)
+		throw std::invalid_argument(std::string(name) + ": array is too small");
+	return static_cast<T*>(arr.mutable_data());
+}
+
+// Sketch seen from Python. Hashes and abundances are returned as read only NumPy views (no copy) whose base owns
+// the sketch, so Close() or Open() of another file only drops the reference and the views stay valid
+struct CPySketchFile
+{
+	std::shared_ptr<CSketchFile> sketch = std::make_shared<CSketchFile>();
+
+	bool Open(const std::string& file_name)
+	{
+		sketch = std::make_shared<CSketchFile>();
+		return sketch->Open(file_name);
+	}
+
+	void Close()
+	{
+		sketch = std::make_shared<CSketchFile>();
+	}
+
+	const CSketchInfo& Info() const { return sketch->Info(); }
+	uint64 Size() const { return sketch->Size(); }
+
+	py::array_t<uint64> View(const uint64* data) const
+	{
+		py::capsule owner(new std::shared_ptr<CSketchFile>(sketch), [](void* p) { delete static_cast<std::shared_ptr<CSketchFile>*>(p); });
+		py::array_t<uint64> res({ (ssize_t)sketch->Size() }, { (ssize_t)sizeof(uint64) }, data, owner);
+		res.attr("flags").attr("writeable") = false;
+		return res;
+	}
+};
+
+// Read next k-mers to preallocated arrays: kmers of shape (n,) for k <= 32 or (n, (k + 31) // 32) otherwise (dtype uint64), counts (uint32),
+// hashes (uint64, optional, only for databases with hashes). The GIL is released while reading. Return the number of k-mers read
+uint64 read_kmers(CKMCFile& ptr, py::array kmers, py::array counts, py::object hashes)
+{
+	CKMCFileInfo info;
+	if (!ptr.Info(info))
+		throw std::runtime_error("database is not opened");
+	uint32 n_words = (info.kmer_length + 31) / 32;
+	if (kmers.ndim() != (n_words == 1 ? 1 : 2) || (n_words > 1 && kmers.shape(1) != n_words))
+		throw std::invalid_argument("kmers: array of shape (n,) for k <= 32 or (n, (k + 31) // 32) expected");
+
+	uint64 n = kmers.shape(0);
+	uint64* kmers_ptr = numpy_out_ptr<uint64>(kmers, n * n_words, "kmers");
+	uint32* counts_ptr = numpy_out_ptr<uint32>(counts, n, "counts");
+	uint64* hashes_ptr = nullptr;
+	if (!hashes.is_none())
+	{
+		if (!info.with_hashes)
+			throw std::invalid_argument("hashes: database has no hashes (use kmc -hash)");
+		py::array hashes_arr = hashes.cast<py::array>();
+		hashes_ptr = numpy_out_ptr<uint64>(hashes_arr, n, "hashes");
+	}
+
+	py::gil_scoped_release release;
+	return ptr.ReadNextKmers(kmers_ptr, counts_ptr, hashes_ptr, n);
+}
+
 struct Count
 {
 	uint64 value;	
@@ -47,7 +116,30 @@ PYBIND11_MODULE(py_kmc_api, m) {
 		.def_readwrite("min_count", &CKMCFileInfo::min_count)
 		.def_readwrite("max_count", &CKMCFileInfo::max_count)
 		.def_readwrite("both_strands", &CKMCFileInfo::both_strands)
-		.def_readwrite("total_kmers", &CKMCFileInfo::total_kmers);
+		.def_readwrite("total_kmers", &CKMCFileInfo::total_kmers)
+		.def_readwrite("with_hashes", &CKMCFileInfo::with_hashes)
+		.def_readwrite("hash_seed", &CKMCFileInfo::hash_seed)
+		.def_readwrite("max_hash", &CKMCFileInfo::max_hash);
+
+	// Ranges can be pickled, so they can be passed to worker processes (multiprocessing), each worker opens its own range
+	py::class_<CKMCFileRange>(m, "KMCFileRange")
+		.def(py::init<>())
+		.def_readwrite("lut_start", &CKMCFileRange::lut_start)
+		.def_readwrite("lut_end", &CKMCFileRange::lut_end)
+		.def_readwrite("kmer_start", &CKMCFileRange::kmer_start)
+		.def_readwrite("kmer_end", &CKMCFileRange::kmer_end)
+		.def(py::pickle(
+			[](const CKMCFileRange& range) { return py::make_tuple(range.lut_start, range.lut_end, range.kmer_start, range.kmer_end); },
+			[](py::tuple t) {
+				if (t.size() != 4)
+					throw std::runtime_error("Invalid state of KMCFileRange");
+				CKMCFileRange range;
+				range.lut_start = t[0].cast<uint64>();
+				range.lut_end = t[1].cast<uint64>();
+				range.kmer_start = t[2].cast<uint64>();
+				range.kmer_end = t[3].cast<uint64>();
+				return range;
+			}));
 
 
 	py::class_<CKmerAPI>(m, "KmerAPI")
@@ -73,8 +165,15 @@ PYBIND11_MODULE(py_kmc_api, m) {
 	py::class_<CKMCFile>(m, "KMCFile")
 		.def(py::init<>())
 		.def("OpenForRA", &CKMCFile::OpenForRA)
-		.def("OpenForListing", &CKMCFile::OpenForListing)
+		.def("OpenForRAMapped", &CKMCFile::OpenForRAMapped, py::arg("file_name"), py::arg("populate") = false)
+		.def("OpenForListing", (bool (CKMCFile::*)(const std::string&)) &CKMCFile::OpenForListing)
+		.def("OpenForListing", (bool (CKMCFile::*)(const std::string&, const CKMCFileRange&)) &CKMCFile::OpenForListing)
+		.def("GetListingRanges", [](CKMCFile& ptr, uint32 n_ranges) { std::vector<CKMCFileRange> ranges; ptr.GetListingRanges(n_ranges, ranges); return ranges; })
 		.def("ReadNextKmer", [](CKMCFile& ptr, CKmerAPI& kmer, Count& count) {return ptr.ReadNextKmer(kmer, count.value); })
+		.def("ReadNextKmer", [](CKMCFile& ptr, CKmerAPI& kmer, Count& count, Count& hash) {return ptr.ReadNextKmer(kmer, count.value, hash.value); })
+		.def("HasHashes", &CKMCFile::HasHashes)
+		.def("GetHashSeed", &CKMCFile::GetHashSeed)
+		.def("GetMaxHash", &CKMCFile::GetMaxHash)
 		.def("Close", &CKMCFile::Close)
 		.def("SetMinCount", &CKMCFile::SetMinCount)
 		.def("GetMinCount", &CKMCFile::GetMinCount)
@@ -86,13 +185,41 @@ PYBIND11_MODULE(py_kmc_api, m) {
 		.def("RestartListing", &CKMCFile::RestartListing)
 		.def("Eof", &CKMCFile::Eof)
 		.def("CheckKmer", [](CKMCFile& ptr, CKmerAPI& kmer, Count& count) { return ptr.CheckKmer(kmer, count.value); })
+		.def("CheckKmers", [](CKMCFile& ptr, const std::vector<CKmerAPI>& kmers) { std::vector<uint64> counters; ptr.CheckKmers(kmers, counters); return counters; })
+		.def("CheckHash", [](CKMCFile& ptr, uint64 hash, Count& count) { return ptr.CheckHash(hash, count.value); })
 		.def("IsKmer", &CKMCFile::IsKmer)
 		.def("ResetMinMaxCounts", &CKMCFile::ResetMinMaxCounts)
 		.def("Info", [](CKMCFile& ptr, CKMCFileInfo& info) {return ptr.Info(info); })
 		.def("Info", [](CKMCFile& ptr) { CKMCFileInfo info; ptr.Info(info); return info; })
+		.def("ReadKmers", &read_kmers, py::arg("kmers"), py::arg("counts"), py::arg("hashes") = py::none())
 		.def("GetCountersForRead", [](CKMCFile& ptr, const std::string& read, CountVec& counters) {
 			return ptr.GetCountersForRead(read, counters.value);
 		})
 		;
+
+	py::class_<CSketchInfo>(m, "SketchInfo")
+		.def(py::init<>())
+		.def_readwrite("ksize", &CSketchInfo::ksize)
+		.def_readwrite("seed", &CSketchInfo::seed)
+		.def_readwrite("max_hash", &CSketchInfo::max_hash)
+		.def_readwrite("molecule", &CSketchInfo::molecule)
+		.def_readwrite("filename", &CSketchInfo::filename)
+		.def_readwrite("hash_function", &CSketchInfo::hash_function)
+		.def_readwrite("with_abundances", &CSketchInfo::with_abundances)
+		.def_readwrite("n_hashes", &CSketchInfo::n_hashes);
+
+	py::class_<CPySketchFile>(m, "SketchFile")
+		.def(py::init<>())
+		.def("Open", &CPySketchFile::Open)
+		.def("Close", &CPySketchFile::Close)
+		.def("Info", &CPySketchFile::Info)
+		.def("Size", &CPySketchFile::Size)
+		.def("Hashes", [](CPySketchFile& ptr) { return ptr.View(ptr.sketch->Hashes()); })
+		.def("Abundances", [](CPySketchFile& ptr) -> py::object {
+			if (!ptr.sketch->Abundances())
+				return py::none();
+			return ptr.View(ptr.sketch->Abundances());
+		})
+		;
 		
 }
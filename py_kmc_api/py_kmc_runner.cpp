@@ -0,0 +1,251 @@
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+#include <pybind11/numpy.h>
+#include <kmc_runner.h>
+#include <kmc_file.h>
+#include <murmur_hash.h>
+#include <algorithm>
+
+namespace py = pybind11;
+
+// Call a Python override. An exception raised in Python cannot propagate through KMC threads (it would terminate
+// the process), so it is reported as unraisable (printed with its traceback, as sys.unraisablehook does) and ignored
+template<typename CALL>
+void call_python_override(const char* name, CALL call)
+{
+	try
+	{
+		call();
+	}
+	catch (py::error_already_set& e)
+	{
+		py::gil_scoped_acquire gil;
+		e.restore();
+		PyErr_WriteUnraisable(py::str(name).ptr());
+	}
+}
+
+// Observers and loggers implemented in Python. KMC calls them from its own threads while the GIL is released,
+// PYBIND11_OVERLOAD_PURE acquires the GIL before calling into Python
+class PyPercentProgressObserver : public KMC::IPercentProgressObserver
+{
+public:
+	void SetLabel(const std::string& label) override { call_python_override("PercentProgressObserver.SetLabel", [&] { PYBIND11_OVERLOAD_PURE(void, KMC::IPercentProgressObserver, SetLabel, label); }); }
+	void ProgressChanged(int newValue) override { call_python_override("PercentProgressObserver.ProgressChanged", [&] { PYBIND11_OVERLOAD_PURE(void, KMC::IPercentProgressObserver, ProgressChanged, newValue); }); }
+};
+
+class PyProgressObserver : public KMC::IProgressObserver
+{
+public:
+	void Start(const std::string& name) override { call_python_override("ProgressObserver.Start", [&] { PYBIND11_OVERLOAD_PURE(void, KMC::IProgressObserver, Start, name); }); }
+	void Step() override { call_python_override("ProgressObserver.Step", [&] { PYBIND11_OVERLOAD_PURE(void, KMC::IProgressObserver, Step, ); }); }
+	void End() override { call_python_override("ProgressObserver.End", [&] { PYBIND11_OVERLOAD_PURE(void, KMC::IProgressObserver, End, ); }); }
+};
+
+class PyLogger : public KMC::ILogger
+{
+public:
+	void Log(const std::string& msg) override { call_python_override("Logger.Log", [&] { PYBIND11_OVERLOAD_PURE(void, KMC::ILogger, Log, msg); }); }
+};
+
+// Sorted hashes (and counters) of k-mers of the database. Hashes stored by kmc -hash are used if available,
+// otherwise k-mers are hashed here. Only hashes below max_hash of scaled are returned
+void read_sketch(const std::string& db_name, uint32 seed, uint32 scaled, std::vector<std::pair<uint64, uint32>>& sketch)
+{
+	CKMCFile db;
+	if (!db.OpenForListing(db_name))
+		throw std::runtime_error("cannot open database: " + db_name);
+	CKMCFileInfo info;
+	db.Info(info);
+	uint64 max_hash = murmur::fmh_max_hash(scaled);
+
+	CKmerAPI kmer(info.kmer_length);
+	uint64 count, hash;
+	if (info.with_hashes && info.hash_seed == seed)
+	{
+		while (db.ReadNextKmer(kmer, count, hash))
+			if (hash < max_hash)
+				sketch.emplace_back(hash, (uint32)std::min(count, (uint64)0xFFFFFFFF));
+	}
+	else
+	{
+		std::string str;
+		uint64 hv[2];
+		while (db.ReadNextKmer(kmer, count))
+		{
+			kmer.to_string(str);
+			murmur::MurmurHash3_x64_128(str.data(), (int)str.size(), seed, hv);
+			if (hv[0] < max_hash)
+				sketch.emplace_back(hv[0], (uint32)std::min(count, (uint64)0xFFFFFFFF));
+		}
+	}
+	db.Close();
+	std::sort(sketch.begin(), sketch.end());
+}
+
+PYBIND11_MODULE(py_kmc_runner, m) {
+	m.doc() = "Python wrapper for KMC counting engine (KMC::Runner)."; // optional module docstring
+
+	py::enum_<KMC::InputFileType>(m, "InputFileType")
+		.value("FASTQ", KMC::InputFileType::FASTQ)
+		.value("FASTA", KMC::InputFileType::FASTA)
+		.value("MULTILINE_FASTA", KMC::InputFileType::MULTILINE_FASTA)
+		.value("BAM", KMC::InputFileType::BAM)
+		.value("KMC", KMC::InputFileType::KMC);
+
+	py::enum_<KMC::OutputFileType>(m, "OutputFileType")
+		.value("KMC", KMC::OutputFileType::KMC)
+		.value("KFF", KMC::OutputFileType::KFF);
+
+	py::enum_<KMC::EstimateHistogramCfg>(m, "EstimateHistogramCfg")
+		.value("DONT_ESTIMATE", KMC::EstimateHistogramCfg::DONT_ESTIMATE)
+		.value("ESTIMATE_AND_COUNT_KMERS", KMC::EstimateHistogramCfg::ESTIMATE_AND_COUNT_KMERS)
+		.value("ONLY_ESTIMATE", KMC::EstimateHistogramCfg::ONLY_ESTIMATE);
+
+	py::class_<KMC::IPercentProgressObserver, PyPercentProgressObserver>(m, "PercentProgressObserver")
+		.def(py::init<>())
+		.def("SetLabel", &KMC::IPercentProgressObserver::SetLabel)
+		.def("ProgressChanged", &KMC::IPercentProgressObserver::ProgressChanged);
+
+	py::class_<KMC::IProgressObserver, PyProgressObserver>(m, "ProgressObserver")
+		.def(py::init<>())
+		.def("Start", &KMC::IProgressObserver::Start)
+		.def("Step", &KMC::IProgressObserver::Step)
+		.def("End", &KMC::IProgressObserver::End);
+
+	py::class_<KMC::ILogger, PyLogger>(m, "Logger")
+		.def(py::init<>())
+		.def("Log", &KMC::ILogger::Log);
+
+	// Setters return the params object, so they can be chained as in C++. Observers and loggers are kept alive by the params object
+	auto ref = py::return_value_policy::reference_internal;
+	py::class_<KMC::Stage1Params>(m, "Stage1Params")
+		.def(py::init<>())
+		.def("SetInputFiles", &KMC::Stage1Params::SetInputFiles, ref)
+		.def("SetTmpPath", &KMC::Stage1Params::SetTmpPath, ref)
+		.def("SetKmerLen", &KMC::Stage1Params::SetKmerLen, ref)
+		.def("SetNThreads", &KMC::Stage1Params::SetNThreads, ref)
+		.def("SetMaxRamGB", &KMC::Stage1Params::SetMaxRamGB, ref)
+		.def("SetSignatureLen", &KMC::Stage1Params::SetSignatureLen, ref)
+		.def("SetHomopolymerCompressed", &KMC::Stage1Params::SetHomopolymerCompressed, ref)
+		.def("SetInputFileType", &KMC::Stage1Params::SetInputFileType, ref)
+		.def("SetCanonicalKmers", &KMC::Stage1Params::SetCanonicalKmers, ref)
+		.def("SetRamOnlyMode", &KMC::Stage1Params::SetRamOnlyMode, ref)
+		.def("SetNBins", &KMC::Stage1Params::SetNBins, ref)
+		.def("SetNReaders", &KMC::Stage1Params::SetNReaders, ref)
+		.def("SetNSplitters", &KMC::Stage1Params::SetNSplitters, ref)
+		.def("SetVerboseLogger", &KMC::Stage1Params::SetVerboseLogger, ref, py::keep_alive<1, 2>())
+		.def("SetPercentProgressObserver", &KMC::Stage1Params::SetPercentProgressObserver, ref, py::keep_alive<1, 2>())
+		.def("SetWarningsLogger", &KMC::Stage1Params::SetWarningsLogger, ref, py::keep_alive<1, 2>())
+		.def("SetEstimateHistogramCfg", &KMC::Stage1Params::SetEstimateHistogramCfg, ref)
+		.def("SetProgressObserver", &KMC::Stage1Params::SetProgressObserver, ref, py::keep_alive<1, 2>())
+		.def("SetScaled", &KMC::Stage1Params::SetScaled, ref)
+		.def("SetSeed", &KMC::Stage1Params::SetSeed, ref)
+		.def("SetTraceFile", &KMC::Stage1Params::SetTraceFile, ref)
+		.def("GetInputFiles", &KMC::Stage1Params::GetInputFiles)
+		.def("GetTmpPath", &KMC::Stage1Params::GetTmpPath)
+		.def("GetKmerLen", &KMC::Stage1Params::GetKmerLen)
+		.def("GetNThreads", &KMC::Stage1Params::GetNThreads)
+		.def("GetMaxRamGB", &KMC::Stage1Params::GetMaxRamGB)
+		.def("GetSignatureLen", &KMC::Stage1Params::GetSignatureLen)
+		.def("GetHomopolymerCompressed", &KMC::Stage1Params::GetHomopolymerCompressed)
+		.def("GetInputFileType", &KMC::Stage1Params::GetInputFileType)
+		.def("GetCanonicalKmers", &KMC::Stage1Params::GetCanonicalKmers)
+		.def("GetRamOnlyMode", &KMC::Stage1Params::GetRamOnlyMode)
+		.def("GetNBins", &KMC::Stage1Params::GetNBins)
+		.def("GetNReaders", &KMC::Stage1Params::GetNReaders)
+		.def("GetNSplitters", &KMC::Stage1Params::GetNSplitters)
+		.def("GetEstimateHistogramCfg", &KMC::Stage1Params::GetEstimateHistogramCfg)
+		.def("GetScaled", &KMC::Stage1Params::GetScaled)
+		.def("GetSeed", &KMC::Stage1Params::GetSeed)
+		.def("GetTraceFile", &KMC::Stage1Params::GetTraceFile);
+
+	py::class_<KMC::Stage2Params>(m, "Stage2Params")
+		.def(py::init<>())
+		.def("SetMaxRamGB", &KMC::Stage2Params::SetMaxRamGB, ref)
+		.def("SetNThreads", &KMC::Stage2Params::SetNThreads, ref)
+		.def("SetStrictMemoryMode", &KMC::Stage2Params::SetStrictMemoryMode, ref)
+		.def("SetCutoffMin", &KMC::Stage2Params::SetCutoffMin, ref)
+		.def("SetCounterMax", &KMC::Stage2Params::SetCounterMax, ref)
+		.def("SetCutoffMax", &KMC::Stage2Params::SetCutoffMax, ref)
+		.def("SetOutputFileName", &KMC::Stage2Params::SetOutputFileName, ref)
+		.def("SetOutputFileType", &KMC::Stage2Params::SetOutputFileType, ref)
+		.def("SetWithoutOutput", &KMC::Stage2Params::SetWithoutOutput, ref)
+		.def("SetStoreHashes", &KMC::Stage2Params::SetStoreHashes, ref)
+		.def("SetStrictMemoryNSortingThreadsPerSorters", &KMC::Stage2Params::SetStrictMemoryNSortingThreadsPerSorters, ref)
+		.def("SetStrictMemoryNUncompactors", &KMC::Stage2Params::SetStrictMemoryNUncompactors, ref)
+		.def("SetStrictMemoryNMergers", &KMC::Stage2Params::SetStrictMemoryNMergers, ref)
+		.def("GetMaxRamGB", &KMC::Stage2Params::GetMaxRamGB)
+		.def("GetNThreads", &KMC::Stage2Params::GetNThreads)
+		.def("GetStrictMemoryMode", &KMC::Stage2Params::GetStrictMemoryMode)
+		.def("GetCutoffMin", &KMC::Stage2Params::GetCutoffMin)
+		.def("GetCounterMax", &KMC::Stage2Params::GetCounterMax)
+		.def("GetCutoffMax", &KMC::Stage2Params::GetCutoffMax)
+		.def("GetOutputFileName", &KMC::Stage2Params::GetOutputFileName)
+		.def("GetOutputFileType", &KMC::Stage2Params::GetOutputFileType)
+		.def("GetWithoutOutput", &KMC::Stage2Params::GetWithoutOutput)
+		.def("GetStoreHashes", &KMC::Stage2Params::GetStoreHashes);
+
+	py::class_<KMC::Stage1Results>(m, "Stage1Results")
+		.def_readonly("time", &KMC::Stage1Results::time)
+		.def_readonly("nSeqences", &KMC::Stage1Results::nSeqences)
+		.def_readonly("wasSmallKOptUsed", &KMC::Stage1Results::wasSmallKOptUsed)
+		.def_readonly("nTotalSuperKmers", &KMC::Stage1Results::nTotalSuperKmers)
+		.def_readonly("tmpSize", &KMC::Stage1Results::tmpSize)
+		.def_readonly("estimatedHistogram", &KMC::Stage1Results::estimatedHistogram);
+
+	py::class_<KMC::Stage2Results>(m, "Stage2Results")
+		.def_readonly("time", &KMC::Stage2Results::time)
+		.def_readonly("timeStrictMem", &KMC::Stage2Results::timeStrictMem)
+		.def_readonly("tmpSizeStrictMemory", &KMC::Stage2Results::tmpSizeStrictMemory)
+		.def_readonly("maxDiskUsage", &KMC::Stage2Results::maxDiskUsage)
+		.def_readonly("nBelowCutoffMin", &KMC::Stage2Results::nBelowCutoffMin)
+		.def_readonly("nAboveCutoffMax", &KMC::Stage2Results::nAboveCutoffMax)
+		.def_readonly("nTotalKmers", &KMC::Stage2Results::nTotalKmers)
+		.def_readonly("nUniqueKmers", &KMC::Stage2Results::nUniqueKmers);
+
+	// Both stages run with the GIL released, so Python threads (and callbacks of observers) may run meanwhile.
+	// Loggers and observers of stage 1 params (including their defaults, which are members of the params object)
+	// are used also in stage 2, so the runner keeps the params object of RunStage1 alive
+	py::class_<KMC::Runner>(m, "Runner")
+		.def(py::init<>())
+		.def("RunStage1", &KMC::Runner::RunStage1, py::call_guard<py::gil_scoped_release>(), py::keep_alive<1, 2>())
+		.def("RunStage2", &KMC::Runner::RunStage2, py::call_guard<py::gil_scoped_release>())
+		// Run both stages and return (hashes, counts, stage1_results, stage2_results), hashes are sorted FracMinHash sketch
+		// (uint64), counts are parallel abundances (uint32). The sketch is not collected in memory: the database is always
+		// written to the output file of stage2_params in KMC format with hashes (-hash), overriding SetWithoutOutput and
+		// SetOutputFileType, and the sketch is read back from it. The database is left on disk
+		.def("RunSketch", [](KMC::Runner& runner, const KMC::Stage1Params& stage1Params, const KMC::Stage2Params& stage2Params) {
+			if (stage2Params.GetOutputFileName().empty())
+				throw std::invalid_argument("RunSketch: output file name of stage2_params must be set, the database with hashes is written there");
+			KMC::Stage2Params stage2ParamsWithHashes = stage2Params;
+			stage2ParamsWithHashes.SetStoreHashes(true).SetWithoutOutput(false).SetOutputFileType(KMC::OutputFileType::KMC);
+
+			std::vector<std::pair<uint64, uint32>> sketch;
+			KMC::Stage1Results stage1Results;
+			KMC::Stage2Results stage2Results;
+			{
+				py::gil_scoped_release release;
+				stage1Results = runner.RunStage1(stage1Params);
+				stage2Results = runner.RunStage2(stage2ParamsWithHashes);
+				read_sketch(stage2Params.GetOutputFileName(), stage1Params.GetSeed(), stage1Params.GetScaled(), sketch);
+			}
+
+			// strides are explicit, as the bundled pybind11 computes them from the itemsize of the dtype, which it cannot read from NumPy 2
+			py::array_t<uint64> hashes({ (ssize_t)sketch.size() }, { (ssize_t)sizeof(uint64) });
+			py::array_t<uint32> counts({ (ssize_t)sketch.size() }, { (ssize_t)sizeof(uint32) });
+			uint64* hashes_ptr = hashes.mutable_data();
+			uint32* counts_ptr = counts.mutable_data();
+			for (size_t i = 0; i < sketch.size(); ++i)
+			{
+				hashes_ptr[i] = sketch[i].first;
+				counts_ptr[i] = sketch[i].second;
+			}
+			return py::make_tuple(hashes, counts, stage1Results, stage2Results);
+		});
+
+	m.attr("kmc_ver") = KMC::CfgConsts::kmc_ver;
+	m.attr("kmc_date") = KMC::CfgConsts::kmc_date;
+	m.attr("min_k") = KMC::CfgConsts::min_k;
+	m.attr("max_k") = KMC::CfgConsts::max_k;
+}
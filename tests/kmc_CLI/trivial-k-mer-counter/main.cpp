@@ -5,10 +5,78 @@
 #include <memory>
 #include <algorithm>
 #include <unordered_map>
+#include <cstring>
+#include <cmath>
 
 #include <zlib.h>
 using namespace std;
 
+// Reference FracMinHash, independent of kmc_api: MurmurHash3_x64_128 (the first 64 bits) of the canonical k-mer,
+// hash is kept if hash < max_hash = round((2^64 - 1) / scaled), the same rule as in kmc, kmc_dump and kmc_api (fmh_max_hash)
+namespace fmh
+{
+    inline uint64_t rotl64(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+    inline uint64_t fmix64(uint64_t k)
+    {
+        k ^= k >> 33;
+        k *= 0xff51afd7ed558ccdull;
+        k ^= k >> 33;
+        k *= 0xc4ceb9fe1a85ec53ull;
+        k ^= k >> 33;
+        return k;
+    }
+
+    uint64_t murmur64(const string& key, uint32_t seed)
+    {
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(key.data());
+        const size_t len = key.size();
+        const size_t nblocks = len / 16;
+        uint64_t h1 = seed, h2 = seed;
+        const uint64_t c1 = 0x87c37b91114253d5ull, c2 = 0x4cf5ad432745937full;
+
+        for (size_t i = 0; i < nblocks; ++i)
+        {
+            uint64_t k1, k2;
+            memcpy(&k1, data + 16 * i, 8);
+            memcpy(&k2, data + 16 * i + 8, 8);
+            k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+            h1 = rotl64(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+            k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+            h2 = rotl64(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+        }
+
+        const uint8_t* tail = data + nblocks * 16;
+        const size_t rem = len & 15;
+        uint64_t k1 = 0, k2 = 0;
+        if (rem > 8)
+        {
+            for (size_t i = rem; i > 8; --i)
+                k2 ^= uint64_t(tail[i - 1]) << (8 * (i - 9));
+            k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+        }
+        if (rem > 0)
+        {
+            for (size_t i = min<size_t>(rem, 8); i > 0; --i)
+                k1 ^= uint64_t(tail[i - 1]) << (8 * (i - 1));
+            k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+        }
+
+        h1 ^= len; h2 ^= len;
+        h1 += h2; h2 += h1;
+        h1 = fmix64(h1); h2 = fmix64(h2);
+        h1 += h2;
+        return h1;
+    }
+
+    uint64_t max_hash(uint64_t scaled)
+    {
+        if (scaled <= 1)
+            return UINT64_MAX;
+        return (uint64_t)round((double)UINT64_MAX / (double)scaled);
+    }
+}
+
 struct Params
 {
     vector<string> inputPaths;
@@ -18,6 +86,8 @@ struct Params
     uint64_t cutoffMax = 1000000000;
     uint64_t countMax = 255;
     bool canonical = true;
+    uint64_t scaled = 0; // 0 - count all k-mers, otherwise only k-mers of FracMinHash sketch
+    uint32_t seed = 42;
 };
 
 
@@ -168,6 +238,7 @@ class Counter
     }
 
     std::unordered_map<string, uint64_t> m;
+    uint64_t maxHash = fmh::max_hash(params.scaled);
 
     void processFile(const std::string& fname)
     {
@@ -205,6 +276,8 @@ class Counter
                 }
                 if (params.canonical)
                     canonicalize(kmer);                
+                if (params.scaled && fmh::murmur64(kmer, params.seed) >= maxHash)
+                    continue;
                 ++m[kmer];
             }
         }
@@ -258,8 +331,19 @@ class Counter
                 exit(1);
             }
 
-            for (const auto& [kmer, count] : kmers)
-                out << kmer << "\t" << count << "\n";
+            // in sketch mode output lines are: hash, counter sorted by hash (the same as mins and abundances of a sketch)
+            if (params.scaled)
+            {
+                vector<pair<uint64_t, uint64_t>> mins;
+                for (const auto& [kmer, count] : kmers)
+                    mins.emplace_back(fmh::murmur64(kmer, params.seed), count);
+                sort(mins.begin(), mins.end());
+                for (const auto& [hash, count] : mins)
+                    out << hash << "\t" << count << "\n";
+            }
+            else
+                for (const auto& [kmer, count] : kmers)
+                    out << kmer << "\t" << count << "\n";
 
             
         }
@@ -281,7 +365,8 @@ Params parse_params(int argc, char**argv)
 {
     if(argc < 3)
     {
-        cerr << "Usage: " << argv[0] << " [-k<k>] [-ci<ci>] [-cx<cx>] [-cs<cs>] [-b] [@]<inputFile(s)> <outputFile>\n";
+        cerr << "Usage: " << argv[0] << " [-k<k>] [-ci<ci>] [-cx<cx>] [-cs<cs>] [-b] [-scaled<scaled>] [-S<seed>] [@]<inputFile(s)> <outputFile>\n";
+        cerr << "With -scaled only k-mers of FracMinHash sketch are counted, output contains their hashes instead of k-mers\n";
         exit(1);
     }
     Params p;
@@ -298,6 +383,10 @@ Params parse_params(int argc, char**argv)
             ParseToType(argv[++i], p.countMax);            
         else if (param == "-b")
             p.canonical = false;
+        else if (param == "-scaled")
+            ParseToType(argv[++i], p.scaled);
+        else if (param == "-S")
+            ParseToType(argv[++i], p.seed);
         else
         {
             cerr << "Error: unknown parameter: " << param << "\n";
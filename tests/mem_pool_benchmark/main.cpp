@@ -0,0 +1,88 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+
+#include "../../kmc_core/queues.h"
+using namespace std;
+
+// Contention benchmark of CMemoryPool: each thread reserves a part, fills it and frees it, in a loop.
+// The pool has fewer parts than threads, so threads block in reserve() and are woken by free().
+// The pool of KMC (one thread woken per freed part) is compared with waking all waiting threads.
+// Usage: bin/mem_pool_benchmark [iterations per thread (default 20000)] [part size (default 65536)]
+
+// The same pool, but every free wakes all waiting threads
+class CMemoryPoolNotifyAll : public CMemoryPool
+{
+public:
+	CMemoryPoolNotifyAll(int64 _total_size, int64 _part_size) : CMemoryPool(_total_size, _part_size)
+	{
+		notify_all_on_free = true;
+	}
+};
+
+struct Result
+{
+	double seconds;
+	uint64 n_blocked_waits;
+	double blocked_seconds;		// sum over threads
+};
+
+Result run(CMemoryPool& pool, uint32 n_threads, uint32 n_iters, uint32 part_size)
+{
+	vector<thread> threads;
+	CPerfStatsCollector::Inst().Take();
+	auto start = chrono::steady_clock::now();
+	for (uint32 t = 0; t < n_threads; ++t)
+		threads.emplace_back([&pool, n_iters, part_size]
+		{
+			CPerfThreadStats perf_stats(PerfPhase::splitter);
+			for (uint32 i = 0; i < n_iters; ++i)
+			{
+				uchar* part;
+				pool.reserve(part);
+				memset(part, (int)i, part_size);
+				this_thread::yield();		// let other threads run while the part is held, as a reader waiting for I/O
+				pool.free(part);
+			}
+		});
+	for (auto& th : threads)
+		th.join();
+	Result res;
+	res.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	res.n_blocked_waits = 0;
+	res.blocked_seconds = 0;
+	for (auto& rec : CPerfStatsCollector::Inst().Take())
+	{
+		res.n_blocked_waits += rec.counters.n_blocked_waits;
+		res.blocked_seconds += rec.counters.blocked_ns / 1e9;
+	}
+	return res;
+}
+
+int main(int argc, char** argv)
+{
+	uint32 n_iters = 20000;
+	uint32 part_size = 1 << 16;
+	if (argc > 1)
+		n_iters = atoi(argv[1]);
+	if (argc > 2)
+		part_size = atoi(argv[2]);
+
+	cout << "threads;parts;notify_one_s;notify_all_s;notify_one_blocked_waits;notify_all_blocked_waits;notify_one_blocked_s;notify_all_blocked_s\n";
+	for (uint32 n_threads : { 4, 8, 16, 32, 64, 128 })
+	{
+		uint32 n_parts = n_threads / 2;
+		CMemoryPool pool_one((int64)n_parts * part_size, part_size);
+		CMemoryPoolNotifyAll pool_all((int64)n_parts * part_size, part_size);
+		Result one = run(pool_one, n_threads, n_iters, part_size);
+		Result all = run(pool_all, n_threads, n_iters, part_size);
+		cout << n_threads << ";" << n_parts << ";" << fixed << setprecision(3) << one.seconds << ";" << all.seconds << ";"
+			<< one.n_blocked_waits << ";" << all.n_blocked_waits << ";" << one.blocked_seconds << ";" << all.blocked_seconds << "\n";
+	}
+	return 0;
+}
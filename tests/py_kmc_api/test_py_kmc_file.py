@@ -6,10 +6,12 @@ A series of test for PyKMCFile class.
 import sys
 import os
 import subprocess
+import pickle
 import kmer_utils
 import init_sys_path
 import py_kmc_api as pka
 import pytest
+import numpy as np
 if not init_sys_path.is_windows():
     import resource
 
@@ -32,21 +34,28 @@ def create_kmc_db():
     )
     _save_reads_as_fastq(reads, reads_src)
 
+    long_kmer_len = 40
     kmers = _cout_kmers(reads, kmer_len)
     absent_kmers = _generate_not_existing_kmers(kmers, kmer_len)
     _run_kmc(cutoff_min, kmer_len, memory, sig_len, reads_src)
+    _run_kmc(cutoff_min, kmer_len, memory, sig_len, reads_src, 'kmc_db_hash', ['-hash'])
+    _run_kmc(cutoff_min, long_kmer_len, memory, sig_len, reads_src, 'kmc_db_long')
 
     result = {
         'kmers': kmers,
         'kmer_len': kmer_len,
         'sig_len': sig_len,
-        'absent_kmers': absent_kmers
+        'absent_kmers': absent_kmers,
+        'long_kmers': _cout_kmers(reads, long_kmer_len),
+        'long_kmer_len': long_kmer_len
     }
     yield result
 
     os.remove(reads_src)
-    os.remove('kmc_db.kmc_pre')
-    os.remove('kmc_db.kmc_suf')
+    for db_name in ('kmc_db', 'kmc_db_hash', 'kmc_db_long'):
+        os.remove(db_name + '.kmc_pre')
+        os.remove(db_name + '.kmc_suf')
+    os.remove('kmc_db_hash.kmc_hash')
 
 def _cout_kmers(reads, kmer_len):
     ''' Simple k-mer counting routine. '''
@@ -111,7 +120,7 @@ def _generate_not_existing_kmers(kmers, kmer_len):
                 absent_kmers.append(inc_kmer)
     return absent_kmers
 
-def _run_kmc(cutoff_min, kmer_len, memory, sig_len, reads_src):
+def _run_kmc(cutoff_min, kmer_len, memory, sig_len, reads_src, db_name='kmc_db', extra_params=()):
     ''' Runs kmc. '''
     if init_sys_path.is_linux() or init_sys_path.is_mac():
         kmc_path = os.path.join(os.path.dirname(__file__), '../../bin/kmc')
@@ -125,17 +134,18 @@ def _run_kmc(cutoff_min, kmer_len, memory, sig_len, reads_src):
                      '-ci{}'.format(cutoff_min),
                      '-k{}'.format(kmer_len),
                      '-m{}'.format(memory),
-                     '-p{}'.format(sig_len),
-                     reads_src,
-                     'kmc_db',
+                     '-p{}'.format(sig_len)] +
+                    list(extra_params) +
+                    [reads_src,
+                     db_name,
                      '.'
                     ])
     
 
-def _open_for_listing():
+def _open_for_listing(db_name='kmc_db'):
     ''' Open kmc database for listing and check if opened sucessfully. '''
     kmc_file = pka.KMCFile()
-    assert kmc_file.OpenForListing('kmc_db')
+    assert kmc_file.OpenForListing(db_name)
     return kmc_file
 
 def _open_for_ra():
@@ -216,3 +226,162 @@ def test_check_kmer(create_kmc_db):
     for kmer_str in absent_kmers:
         kmer.from_string(kmer_str)
         assert not kmc_file.CheckKmer(kmer, counter)
+
+def test_check_kmers(create_kmc_db):
+    '''
+    Test case for CheckKmers method.
+
+    Counters returned for a batch must be the same as returned by CheckKmer
+    for each k-mer, also for batches which are not a multiple of the number of lanes (16).
+    '''
+    kmers = create_kmc_db['kmers']
+    kmer_len = create_kmc_db['kmer_len']
+    absent_kmers = create_kmc_db['absent_kmers']
+    mixed = []
+    for present, absent in zip(kmers.keys(), absent_kmers):
+        mixed += [present, absent]
+    mixed += list(kmers.keys()) + absent_kmers
+    kmc_file = _open_for_ra()
+    counter = pka.Count()
+    for batch_len in (1, 15, 17, 33, len(mixed)):
+        batch = []
+        for kmer_str in mixed[:batch_len]:
+            kmer = pka.KmerAPI(kmer_len)
+            kmer.from_string(kmer_str)
+            batch.append(kmer)
+        counters = kmc_file.CheckKmers(batch)
+        assert len(counters) == batch_len
+        for kmer, count in zip(batch, counters):
+            expected = counter.value if kmc_file.CheckKmer(kmer, counter) else 0
+            assert count == expected
+        assert counters[0] == kmers[mixed[0]]
+        if batch_len > 1:
+            assert counters[1] == 0
+    assert kmc_file.CheckKmers([]) == []
+
+def _list_kmers(db_name, kmer_len, with_hashes=False):
+    ''' List (packed k-mer words, counter, hash) with ReadNextKmer. '''
+    kmc_file = _open_for_listing(db_name)
+    kmer = pka.KmerAPI(kmer_len)
+    counter = pka.Count()
+    hash_value = pka.Count()
+    packed = pka.LongKmerRepresentation()
+    res = []
+    while kmc_file.ReadNextKmer(kmer, counter, hash_value) if with_hashes else kmc_file.ReadNextKmer(kmer, counter):
+        kmer.to_long(packed)
+        res.append((list(packed.value), counter.value, hash_value.value if with_hashes else None))
+    return res
+
+def _read_all_kmers(kmc_file, n_words, batch_size, with_hashes=False):
+    ''' List the database with ReadKmers in batches of batch_size. '''
+    shape = (batch_size,) if n_words == 1 else (batch_size, n_words)
+    kmers = np.zeros(shape, dtype=np.uint64)
+    counts = np.zeros(batch_size, dtype=np.uint32)
+    hashes = np.zeros(batch_size, dtype=np.uint64) if with_hashes else None
+    res = []
+    batch_lens = []
+    while True:
+        n = kmc_file.ReadKmers(kmers, counts, hashes)
+        if n == 0:
+            break
+        batch_lens.append(n)
+        for i in range(n):
+            words = [int(kmers[i])] if n_words == 1 else [int(x) for x in kmers[i]]
+            res.append((words, int(counts[i]), int(hashes[i]) if with_hashes else None))
+    return res, batch_lens
+
+def test_read_kmers(create_kmc_db):
+    ''' ReadKmers must return the same k-mers and counters as ReadNextKmer, also in the partial last batch. '''
+    expected = _list_kmers('kmc_db', create_kmc_db['kmer_len'])
+    batch_size = next(b for b in range(5, len(expected)) if len(expected) % b != 0)
+    res, batch_lens = _read_all_kmers(_open_for_listing(), 1, batch_size)
+    assert res == expected
+    assert batch_lens[-1] == len(expected) % batch_size
+    assert all(n == batch_size for n in batch_lens[:-1])
+
+def test_read_kmers_long(create_kmc_db):
+    ''' For k > 32 kmers array must be of shape (n, (k + 31) // 32). '''
+    kmer_len = create_kmc_db['long_kmer_len']
+    n_words = (kmer_len + 31) // 32
+    expected = _list_kmers('kmc_db_long', kmer_len)
+    assert len(expected) == len(create_kmc_db['long_kmers'])
+    kmc_file = _open_for_listing('kmc_db_long')
+    counts = np.zeros(4, dtype=np.uint32)
+    for shape in ((4,), (4, n_words + 1), (4, n_words, 1)):
+        with pytest.raises(ValueError):
+            kmc_file.ReadKmers(np.zeros(shape, dtype=np.uint64), counts)
+    res, _ = _read_all_kmers(kmc_file, n_words, 7)
+    assert res == expected
+
+def test_read_kmers_rejects_arrays(create_kmc_db):
+    ''' Arrays of other dtype, not C-contiguous, read only or too small are rejected (no conversion is done). '''
+    kmc_file = _open_for_listing()
+    kmers = np.zeros(8, dtype=np.uint64)
+    counts = np.zeros(8, dtype=np.uint32)
+    read_only = np.zeros(8, dtype=np.uint64)
+    read_only.flags.writeable = False
+    for bad_kmers in (np.zeros(8, dtype=np.int64), np.zeros(8, dtype=np.uint32), np.zeros(16, dtype=np.uint64)[::2], read_only):
+        with pytest.raises(ValueError):
+            kmc_file.ReadKmers(bad_kmers, counts)
+    for bad_counts in (np.zeros(8, dtype=np.uint64), np.zeros(16, dtype=np.uint32)[::2], np.zeros(4, dtype=np.uint32)):
+        with pytest.raises(ValueError):
+            kmc_file.ReadKmers(kmers, bad_counts)
+    with pytest.raises(ValueError):
+        kmc_file.ReadKmers(kmers, counts, np.zeros(8, dtype=np.int64))
+    # nothing was read by rejected calls
+    res, _ = _read_all_kmers(kmc_file, 1, 8)
+    assert res == _list_kmers('kmc_db', create_kmc_db['kmer_len'])
+
+def test_read_kmers_hashes(create_kmc_db):
+    ''' Hashes are available only for databases created with -hash. '''
+    kmc_file = _open_for_listing()
+    assert not kmc_file.HasHashes()
+    with pytest.raises(ValueError):
+        kmc_file.ReadKmers(np.zeros(8, dtype=np.uint64), np.zeros(8, dtype=np.uint32), np.zeros(8, dtype=np.uint64))
+
+    kmc_file = _open_for_listing('kmc_db_hash')
+    assert kmc_file.HasHashes()
+    expected = _list_kmers('kmc_db_hash', create_kmc_db['kmer_len'], True)
+    res, _ = _read_all_kmers(kmc_file, 1, 9, True)
+    assert res == expected
+    assert len(set(h for _, _, h in res)) == len(res)
+
+def test_listing_ranges(create_kmc_db):
+    '''
+    Listings of ranges from GetListingRanges concatenated must be equal to the listing of the whole database,
+    also if there are more ranges than non-empty LUT entries (and k-mers).
+    '''
+    kmer_len = create_kmc_db['kmer_len']
+    expected = _list_kmers('kmc_db', kmer_len)
+    kmer = pka.KmerAPI(kmer_len)
+    counter = pka.Count()
+    packed = pka.LongKmerRepresentation()
+    for n_ranges in (1, 2, 3, 7, len(expected), 4 * len(expected) + 1):
+        ranges = _open_for_listing().GetListingRanges(n_ranges)
+        assert 1 <= len(ranges) <= n_ranges
+        res = []
+        for kmc_range in ranges:
+            kmc_file = pka.KMCFile()
+            assert kmc_file.OpenForListing('kmc_db', kmc_range)
+            while kmc_file.ReadNextKmer(kmer, counter):
+                kmer.to_long(packed)
+                res.append((list(packed.value), counter.value, None))
+            kmc_file.Close()
+        assert res == expected
+
+def test_listing_range_pickle(create_kmc_db):
+    ''' KMCFileRange can be pickled (e.g. to be passed to multiprocessing workers). '''
+    ranges = _open_for_listing().GetListingRanges(3)
+    for kmc_range in ranges:
+        copy = pickle.loads(pickle.dumps(kmc_range))
+        assert (copy.lut_start, copy.lut_end, copy.kmer_start, copy.kmer_end) == \
+            (kmc_range.lut_start, kmc_range.lut_end, kmc_range.kmer_start, kmc_range.kmer_end)
+    kmc_range = ranges[-1]
+    kmc_file = pka.KMCFile()
+    assert kmc_file.OpenForListing('kmc_db', pickle.loads(pickle.dumps(kmc_range)))
+    kmer = pka.KmerAPI(create_kmc_db['kmer_len'])
+    counter = pka.Count()
+    n_kmers = 0
+    while kmc_file.ReadNextKmer(kmer, counter):
+        n_kmers += 1
+    assert n_kmers == kmc_range.kmer_end - kmc_range.kmer_start > 0
@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+'''
+A series of test for py_kmc_runner module (KMC::Runner).
+'''
+
+import os
+import json
+import random
+import subprocess
+import init_sys_path
+import pytest
+np = pytest.importorskip('numpy')
+kmc_runner = pytest.importorskip('py_kmc_runner')
+
+
+KMER_LEN = 21
+SCALED = 10
+SEED = 42
+READS_SRC = 'runner_input.fastq'
+
+@pytest.fixture(scope="module", autouse=True)
+def reads():
+    '''
+    Random reads (with repeated fragments, so some k-mers have larger counts).
+    '''
+    rnd = random.Random(17)
+    genome = ''.join(rnd.choice('ACGT') for _ in range(3000))
+    with open(READS_SRC, 'w') as file:
+        for _ in range(300):
+            start = rnd.randrange(len(genome) - 100)
+            read = genome[start:start + 100]
+            file.write("@TEST\n" + read + "\n+TEST\n" + "I" * len(read) + "\n")
+    yield READS_SRC
+    os.remove(READS_SRC)
+    for name in ('runner_db', 'cli_db'):
+        for ext in ('.kmc_pre', '.kmc_suf', '.kmc_hash'):
+            if os.path.exists(name + ext):
+                os.remove(name + ext)
+    if os.path.exists('cli_sketch.json'):
+        os.remove('cli_sketch.json')
+
+def _bin_path(name):
+    ''' Path of a binary built by make. '''
+    return os.path.join(os.path.dirname(__file__), '../../bin', name)
+
+def _stage1_params():
+    return kmc_runner.Stage1Params() \
+        .SetInputFiles([READS_SRC]) \
+        .SetTmpPath('.') \
+        .SetKmerLen(KMER_LEN) \
+        .SetNThreads(1) \
+        .SetMaxRamGB(2) \
+        .SetInputFileType(kmc_runner.InputFileType.FASTQ) \
+        .SetScaled(SCALED) \
+        .SetSeed(SEED)
+
+def _stage2_params(output_file_name):
+    return kmc_runner.Stage2Params() \
+        .SetCutoffMin(1) \
+        .SetMaxRamGB(2) \
+        .SetNThreads(1) \
+        .SetOutputFileName(output_file_name)
+
+def test_run_sketch_matches_kmc_dump(reads):
+    '''
+    Sketch returned by RunSketch must be the same as the sketch written by kmc_dump
+    for a database counted by kmc (without -hash, so kmc_dump computes the hashes itself).
+    '''
+    hashes, counts, stage1_results, stage2_results = kmc_runner.Runner().RunSketch(_stage1_params(), _stage2_params('runner_db'))
+    assert hashes.dtype == np.uint64 and counts.dtype == np.uint32
+    assert len(hashes) == len(counts) > 0
+    assert list(hashes) == sorted(hashes)
+    assert stage2_results.nUniqueKmers > len(hashes)
+
+    subprocess.check_call([_bin_path('kmc'), '-k{}'.format(KMER_LEN), '-m2', '-ci1', '-t1', reads, 'cli_db', '.'],
+                          stdout=subprocess.DEVNULL)
+    subprocess.check_call([_bin_path('kmc_dump'), '-S{}'.format(SEED), '-scaled{}'.format(SCALED), '-ksize{}'.format(KMER_LEN),
+                           '-a', 'cli_db', 'cli_sketch.json'], stdout=subprocess.DEVNULL)
+    with open('cli_sketch.json') as file:
+        signature = json.load(file)[0]['signatures'][0]
+    assert [int(x) for x in hashes] == signature['mins']
+    assert [int(x) for x in counts] == signature['abundances']
+
+def test_run_sketch_requires_output(reads):
+    ''' RunSketch writes the database with hashes to the output file, so its name must be set. '''
+    stage2 = kmc_runner.Stage2Params().SetCutoffMin(1).SetMaxRamGB(2).SetNThreads(1)
+    with pytest.raises(ValueError):
+        kmc_runner.Runner().RunSketch(_stage1_params(), stage2)
+
+def test_exception_in_observer(reads):
+    ''' An exception raised in a Python observer is reported and ignored, counting is not interrupted. '''
+    class FailingObserver(kmc_runner.PercentProgressObserver):
+        def __init__(self):
+            kmc_runner.PercentProgressObserver.__init__(self)
+            self.n_calls = 0
+        def SetLabel(self, label):
+            pass
+        def ProgressChanged(self, new_value):
+            self.n_calls += 1
+            raise RuntimeError('observer failed')
+
+    observer = FailingObserver()
+    runner = kmc_runner.Runner()
+    runner.RunStage1(_stage1_params().SetPercentProgressObserver(observer))
+    stage2_results = runner.RunStage2(_stage2_params('runner_db'))
+    assert observer.n_calls > 0
+    assert stage2_results.nUniqueKmers > 0
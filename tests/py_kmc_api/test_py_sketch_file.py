@@ -0,0 +1,66 @@
+#!/usr/bin/env python3
+'''
+A series of test for SketchFile class.
+'''
+
+import os
+import json
+import init_sys_path
+import py_kmc_api as pka
+import pytest
+
+
+SOURMASH_SIG = 'sourmash_sig.json'
+
+@pytest.fixture(scope="module", autouse=True)
+def sourmash_signature():
+    '''
+    Signature in the layout written by sourmash (upper case molecule, abundances).
+    '''
+    sig = [{
+        'class': 'sourmash_signature',
+        'email': '',
+        'hash_function': '0.murmur64',
+        'filename': 'reads.fq',
+        'license': 'CC0',
+        'signatures': [{
+            'num': 0,
+            'ksize': 21,
+            'seed': 42,
+            'max_hash': 18446744073709552,
+            'mins': [11, 2024, 99999, 18446744073709000],
+            'abundances': [1, 3, 2, 7],
+            'molecule': 'DNA',
+            'md5sum': 'abcd'
+        }],
+        'version': 0.4
+    }]
+    with open(SOURMASH_SIG, 'w') as f:
+        json.dump(sig, f)
+    yield sig[0]['signatures'][0]
+    os.remove(SOURMASH_SIG)
+
+def test_sourmash_signature(sourmash_signature):
+    sketch = pka.SketchFile()
+    assert sketch.Open(SOURMASH_SIG)
+    info = sketch.Info()
+    assert info.ksize == 21
+    assert info.seed == 42
+    assert info.max_hash == sourmash_signature['max_hash']
+    assert info.molecule == 'dna'
+    assert info.with_abundances
+    assert sketch.Size() == len(sourmash_signature['mins'])
+    sketch.Close()
+
+def test_views_outlive_close(sourmash_signature):
+    sketch = pka.SketchFile()
+    assert sketch.Open(SOURMASH_SIG)
+    hashes = sketch.Hashes()
+    abundances = sketch.Abundances()
+    sketch.Close()
+    assert sketch.Size() == 0
+    assert sketch.Open(SOURMASH_SIG)
+    sketch.Close()
+    assert list(hashes) == sourmash_signature['mins']
+    assert list(abundances) == sourmash_signature['abundances']
+    assert not hashes.flags.writeable
@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+
+# Benchmark and correctness check of sketching: for each synthetic read set and number of threads
+# kmc (stage 1 and stage 2) and kmc_dump are timed separately, peak RSS of each process is recorded,
+# and the sketch (mins and abundances) is compared with the reference FracMinHash of trivial-k-mer-counter.
+# Results are stored in JSON.
+
+import argparse
+import json
+import os
+import platform
+import shutil
+import subprocess
+import sys
+import time
+
+from synthetic_data import KINDS, parse_size, get_reads
+
+# Run a command, return (wall time in seconds, peak RSS in KB)
+def run_timed(cmd, log_path):
+    with open(log_path, "w") as log:
+        start = time.time()
+        proc = subprocess.Popen(cmd, stdout=log, stderr=subprocess.STDOUT)
+        _, status, rusage = os.wait4(proc.pid, 0)
+        wall = time.time() - start
+    if os.waitstatus_to_exitcode(status) != 0:
+        print("Error: {} failed, see {}".format(" ".join(cmd), log_path))
+        sys.exit(1)
+    return wall, rusage.ru_maxrss
+
+def read_sketch(json_path):
+    with open(json_path) as f:
+        sig = json.load(f)[0]["signatures"][0]
+    return sig["mins"], sig.get("abundances", [])
+
+def read_oracle(path):
+    mins, abundances = [], []
+    with open(path) as f:
+        for line in f:
+            hash, count = line.split()
+            mins.append(int(hash))
+            abundances.append(int(count))
+    return mins, abundances
+
+def kmc_stage_times(json_path):
+    with open(json_path) as f:
+        stats = json.load(f)
+    return float(stats["1st_stage"].rstrip("s")), float(stats["2nd_stage"].rstrip("s"))
+
+def main():
+    parser = argparse.ArgumentParser(description="Sketch benchmark with FracMinHash oracle")
+    parser.add_argument("data_dir", help="directory for cached read sets and temporary files")
+    parser.add_argument("kmc")
+    parser.add_argument("kmc_dump")
+    parser.add_argument("counter", help="trivial-k-mer-counter binary (reference FracMinHash)")
+    parser.add_argument("--kinds", default=",".join(KINDS))
+    parser.add_argument("--sizes", default="10M", help="total bases of reads, e.g. 10M,1G,10G")
+    parser.add_argument("--threads", default="1,{}".format(os.cpu_count()))
+    parser.add_argument("-k", type=int, default=21)
+    parser.add_argument("--scaled", type=int, default=1000)
+    parser.add_argument("--seed", type=int, default=42)
+    parser.add_argument("--data-seed", type=int, default=0)
+    parser.add_argument("--ram", type=int, default=4, help="-m of kmc (GB)")
+    parser.add_argument("--no-oracle", action="store_true", help="do not check sketches (e.g. for the largest sets)")
+    parser.add_argument("-o", "--output", default="sketch_benchmark.json")
+    args = parser.parse_args()
+
+    counter_max = 65535
+    work_dir = os.path.join(args.data_dir, "sketch_benchmark")
+    tmp_dir = os.path.join(work_dir, "tmp")
+    os.makedirs(tmp_dir, exist_ok=True)
+
+    report = {
+        "host": {"machine": platform.machine(), "system": platform.system(), "cpus": os.cpu_count()},
+        "params": {"k": args.k, "scaled": args.scaled, "seed": args.seed, "data_seed": args.data_seed, "ram_gb": args.ram},
+        "runs": []
+    }
+    all_ok = True
+
+    for size in [parse_size(s) for s in args.sizes.split(",")]:
+        for kind in args.kinds.split(","):
+            reads = get_reads(args.data_dir, kind, size, args.data_seed)
+            input_mb = os.path.getsize(reads) / 1e6
+            name = "{}.{}".format(kind, size)
+
+            oracle = None
+            if not args.no_oracle:
+                oracle_path = os.path.join(work_dir, name + ".oracle")
+                oracle_time, oracle_rss = run_timed([args.counter, "-k", str(args.k), "-ci", "1", "-cs", str(counter_max),
+                    "-scaled", str(args.scaled), "-S", str(args.seed), reads, oracle_path], oracle_path + ".log")
+                oracle = read_oracle(oracle_path)
+
+            for n_threads in [int(t) for t in args.threads.split(",")]:
+                db = os.path.join(work_dir, "{}.t{}".format(name, n_threads))
+                shutil.rmtree(tmp_dir)
+                os.makedirs(tmp_dir)
+                kmc_wall, kmc_rss = run_timed([args.kmc, "-k{}".format(args.k), "-ci1", "-cs{}".format(counter_max),
+                    "-scaled{}".format(args.scaled), "-S{}".format(args.seed), "-t{}".format(n_threads), "-m{}".format(args.ram),
+                    "-fq", "-j{}.stats.json".format(db), reads, db, tmp_dir], db + ".kmc.log")
+                stage1, stage2 = kmc_stage_times(db + ".stats.json")
+
+                # kmc_dump is single threaded
+                dump_wall, dump_rss = run_timed([args.kmc_dump, "-ci1", "-a", "-scaled{}".format(args.scaled), "-S{}".format(args.seed),
+                    "-ksize{}".format(args.k), "-filename{}".format(os.path.basename(reads)), db, db + ".json"], db + ".dump.log")
+
+                mins, abundances = read_sketch(db + ".json")
+                run = {
+                    "kind": kind, "size": size, "input_MB": round(input_mb, 3), "threads": n_threads,
+                    "stage1_s": stage1, "stage2_s": stage2, "kmc_wall_s": round(kmc_wall, 3), "dump_s": round(dump_wall, 3),
+                    "stage1_MBps": round(input_mb / stage1, 3) if stage1 else None,
+                    "stage2_MBps": round(input_mb / stage2, 3) if stage2 else None,
+                    "kmc_peak_rss_KB": kmc_rss, "dump_peak_rss_KB": dump_rss,
+                    "sketch_size": len(mins)
+                }
+                if oracle is not None:
+                    ok = (mins, abundances) == oracle
+                    all_ok = all_ok and ok
+                    run["oracle"] = "ok" if ok else "mismatch"
+                    run["oracle_s"] = round(oracle_time, 3)
+                    run["oracle_peak_rss_KB"] = oracle_rss
+                    if not ok:
+                        print("Error: sketch of {} (-t{}) differs from reference: {} vs {} hashes".format(name, n_threads, len(mins), len(oracle[0])))
+                else:
+                    run["oracle"] = "skipped"
+                print(json.dumps(run))
+                report["runs"].append(run)
+
+                for ext in [".kmc_pre", ".kmc_suf"]:
+                    if os.path.exists(db + ext):
+                        os.remove(db + ext)
+
+    with open(args.output, "w") as f:
+        json.dump(report, f, indent=2)
+    print("results stored in {}".format(args.output))
+    sys.exit(0 if all_ok else 1)
+
+if __name__ == "__main__":
+    main()
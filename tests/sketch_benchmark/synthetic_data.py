@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+
+# Deterministic synthetic genomes and read sets for the sketch benchmark.
+# The same (kind, size, seed) always gives the same FASTQ file.
+
+import os
+import sys
+import random
+
+KINDS = ["uniform", "repeat", "lowcomplexity", "nheavy", "highcov"]
+
+READ_LEN = 150
+COVERAGE = 10
+HIGH_COVERAGE = 30  # "highcov": uniform genome, each k-mer occurs about 30 times
+ERROR_RATE = 0.002
+
+_to_acgt = bytes(b"ACGT"[i & 3] for i in range(256))
+_compl = bytes.maketrans(b"ACGTN", b"TGCAN")
+
+def parse_size(s):
+    units = {"K": 10**3, "M": 10**6, "G": 10**9}
+    s = s.strip().upper()
+    if s[-1] in units:
+        return int(float(s[:-1]) * units[s[-1]])
+    return int(s)
+
+def random_seq(rnd, n):
+    return rnd.randbytes(n).translate(_to_acgt)
+
+# Half of the genome are copies of a small pool of repeat elements (with a few substitutions)
+def repeat_genome(rnd, n):
+    pool = [random_seq(rnd, rnd.randint(300, 6000)) for _ in range(20)]
+    parts = []
+    total = 0
+    while total < n:
+        if rnd.random() < 0.5:
+            elem = bytearray(rnd.choice(pool))
+            for _ in range(len(elem) // 100):
+                elem[rnd.randrange(len(elem))] = b"ACGT"[rnd.randrange(4)]
+            part = bytes(elem)
+        else:
+            part = random_seq(rnd, rnd.randint(1000, 10000))
+        parts.append(part)
+        total += len(part)
+    return b"".join(parts)[:n]
+
+# Random segments interleaved with homopolymers and short tandem repeats
+def lowcomplexity_genome(rnd, n):
+    parts = []
+    total = 0
+    while total < n:
+        if rnd.random() < 0.5:
+            unit = random_seq(rnd, rnd.randint(1, 6))
+            part = (unit * (rnd.randint(50, 2000) // len(unit) + 1))
+        else:
+            part = random_seq(rnd, rnd.randint(200, 5000))
+        parts.append(part)
+        total += len(part)
+    return b"".join(parts)[:n]
+
+# Uniform genome with about 5% of positions in runs of N
+def nheavy_genome(rnd, n):
+    genome = bytearray(random_seq(rnd, n))
+    pos = 0
+    while True:
+        pos += rnd.randint(500, 3500)
+        run = rnd.randint(1, 200)
+        if pos >= n:
+            break
+        genome[pos:pos + run] = b"N" * len(genome[pos:pos + run])
+        pos += run
+    return bytes(genome)
+
+def make_genome(kind, rnd, n):
+    if kind == "uniform" or kind == "highcov":
+        return random_seq(rnd, n)
+    if kind == "repeat":
+        return repeat_genome(rnd, n)
+    if kind == "lowcomplexity":
+        return lowcomplexity_genome(rnd, n)
+    if kind == "nheavy":
+        return nheavy_genome(rnd, n)
+    raise ValueError("unknown kind of data: {}".format(kind))
+
+# Write reads of total length about `size` bases sampled from both strands of a genome of size / coverage bases.
+# Return the number of bases written
+def write_reads(kind, size, seed, path):
+    rnd = random.Random("{}.{}.{}".format(kind, size, seed))
+    coverage = HIGH_COVERAGE if kind == "highcov" else COVERAGE
+    genome = make_genome(kind, rnd, max(size // coverage, READ_LEN))
+    n_reads = max(size // READ_LEN, 1)
+    qual = b"I" * READ_LEN
+    reads_with_error_per_mille = int(READ_LEN * ERROR_RATE * 1000)
+    tmp_path = path + ".tmp"
+    with open(tmp_path, "wb") as out:
+        buf = []
+        for i in range(n_reads):
+            pos = rnd.randrange(len(genome) - READ_LEN + 1)
+            read = genome[pos:pos + READ_LEN]
+            if rnd.random() < 0.5:
+                read = read.translate(_compl)[::-1]
+            if rnd.randrange(1000) < reads_with_error_per_mille:
+                read = bytearray(read)
+                read[rnd.randrange(READ_LEN)] = b"ACGT"[rnd.randrange(4)]
+                read = bytes(read)
+            buf.append(b"@r%d\n%s\n+\n%s\n" % (i, read, qual))
+            if len(buf) == 10000:
+                out.write(b"".join(buf))
+                buf = []
+        out.write(b"".join(buf))
+    os.rename(tmp_path, path)
+    return n_reads * READ_LEN
+
+# Path of cached read set, generated if it does not exist yet
+def get_reads(data_dir, kind, size, seed):
+    path = os.path.join(data_dir, "cached", "synthetic", "{}.{}.s{}.fq".format(kind, size, seed))
+    if not os.path.exists(os.path.dirname(path)):
+        os.makedirs(os.path.dirname(path))
+    if not os.path.exists(path):
+        print("generating {}".format(path))
+        write_reads(kind, size, seed, path)
+    return path
+
+if __name__ == "__main__":
+    if len(sys.argv) < 4:
+        print("Usage: {} <data_dir> <{}> <size, e.g. 10M, 1G> [seed]".format(sys.argv[0], "/".join(KINDS)))
+        sys.exit(1)
+    seed = int(sys.argv[4]) if len(sys.argv) > 4 else 0
+    print(get_reads(sys.argv[1], sys.argv[2], parse_size(sys.argv[3]), seed))
@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+
+# Stage 2 with bins read from disk: stage 1 is run by py_kmc_runner, then the bin files (kmc_*.bin) are flushed
+# and dropped from the page cache (posix_fadvise DONTNEED), and stage 2 is timed. Without dropping them stage 2
+# reads the bins from the page cache, so prefetching of bins (CMemDiskFile::Prefetch) cannot be measured.
+# To compare builds, run the script with py_kmc_runner of each build (--module-dir). Linux only.
+
+import argparse
+import glob
+import os
+import sys
+import time
+
+def drop_from_page_cache(paths):
+    for path in paths:
+        fd = os.open(path, os.O_RDONLY)
+        try:
+            os.fsync(fd)
+            os.posix_fadvise(fd, 0, 0, os.POSIX_FADV_DONTNEED)
+        finally:
+            os.close(fd)
+
+def main():
+    parser = argparse.ArgumentParser(description="Time stage 2 of KMC with bins not in the page cache")
+    parser.add_argument("input", help="FASTQ file")
+    parser.add_argument("--module-dir", default=os.path.join(os.path.dirname(__file__), "../../bin"), help="directory of py_kmc_runner")
+    parser.add_argument("--tmp", default="cold_stage2_tmp", help="directory for bins")
+    parser.add_argument("-k", type=int, default=25)
+    parser.add_argument("-t", "--threads", type=int, default=2)
+    parser.add_argument("-m", "--ram", type=int, default=2, help="max RAM in GB")
+    parser.add_argument("--ci", type=int, default=2)
+    parser.add_argument("--reps", type=int, default=3)
+    args = parser.parse_args()
+
+    sys.path.insert(0, args.module_dir)
+    import py_kmc_runner as kmc_runner
+
+    os.makedirs(args.tmp, exist_ok=True)
+    out = os.path.join(args.tmp, "out")
+    times = []
+    for rep in range(args.reps):
+        stage1 = kmc_runner.Stage1Params() \
+            .SetInputFiles([args.input]) \
+            .SetTmpPath(args.tmp) \
+            .SetKmerLen(args.k) \
+            .SetNThreads(args.threads) \
+            .SetMaxRamGB(args.ram)
+        runner = kmc_runner.Runner()
+        runner.RunStage1(stage1)
+        drop_from_page_cache(glob.glob(os.path.join(args.tmp, "kmc_*.bin")))
+        start = time.time()
+        runner.RunStage2(kmc_runner.Stage2Params()
+            .SetCutoffMin(args.ci)
+            .SetMaxRamGB(args.ram)
+            .SetNThreads(args.threads)
+            .SetOutputFileName(out))
+        times.append(time.time() - start)
+        print("rep {}: stage 2 {:.3f}s".format(rep, times[-1]), flush=True)
+    print("mean stage 2: {:.3f}s".format(sum(times) / len(times)))
+    for ext in (".kmc_pre", ".kmc_suf"):
+        if os.path.exists(out + ext):
+            os.remove(out + ext)
+
+if __name__ == "__main__":
+    main()
@@ -40,6 +40,7 @@ int main(int argc, char* argv[]) {
         std::cerr << "  --fa               Input file is in fasta format" << std::endl;
         std::cerr << "  --fq               Input file is in fastq format" << std::endl;
         std::cerr << "  --a                Write abundances" << std::endl;
+        std::cerr << "  --bin              Write sketch in binary format instead of JSON" << std::endl;
         std::cerr << "  --n <int>          Number of threads (default: 1)" << std::endl;
         return 1;
     }
@@ -47,6 +48,7 @@ int main(int argc, char* argv[]) {
     infilename = argv[1];
     outfilename = argv[2];
     bool use_abundance = false;
+    bool binary_output = false;
     int num_threads = -1;
 
     for (int i = 3; i < argc; i++) {
@@ -62,6 +64,8 @@ int main(int argc, char* argv[]) {
             isFastq = true;
         } else if (std::string(argv[i]) == "--a") {
             use_abundance = true;
+        } else if (std::string(argv[i]) == "--bin") {
+            binary_output = true;
         } else if (std::string(argv[i]) == "--n" && i + 1 < argc) {
             num_threads = std::atoi(argv[i + 1]);
         }
@@ -127,6 +131,9 @@ int main(int argc, char* argv[]) {
     if (use_abundance) {
         cmd2 += " -a";
     }
+    if (binary_output) {
+        cmd2 += " -obin";
+    }
 
     cmd2 += " -ci1 -scaled" + std::to_string(scaled)
                             + " -S" + std::to_string(seed)